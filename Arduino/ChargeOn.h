@@ -12,12 +12,7 @@
 
   /* Module-specific defines */
 # define CO_DEBUGGING                                      // To debug the ChargeOn module (when PRJ_DEBUGGING is defined)
-                                    
-  /* Global variables */
-# if defined(CO_DEBUGGING) || defined(MYRCS_DEBUGGING)     // Is debugging enabled for at least one module?
-#  include <SendOnlySoftwareSerial.h>                      //  Yes, include SendOnlySoftwareSerial / SerialDebug
-   extern SendOnlySoftwareSerial SerialDebug;              //       stuff in the compilation
-# endif
+                                                           //  (events are logged by myLog; see LogCodes.h)
 
   /* Public function prototypes */
 
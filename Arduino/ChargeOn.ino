@@ -16,68 +16,279 @@
 #include "Project.h"
 #include "myRCSwitch.h"
 #include "ChargeOn.h"
-#include <EEPROM.h>
+#include "myUART.h"
+#include "myJournal.h"
+#include "myLog.h"
+#ifdef __AVR__
+# include <avr/interrupt.h>                                // For SleepUntilInterrupt()
+# include <avr/sleep.h>
+# include <avr/power.h>
+#endif
 
   /* Module-specific defines */
 #if defined(PRJ_DEBUGGING)                                 // Is debugging enabled for the project?
 # if defined(CO_DEBUGGING)                                 //  Yes, is debugging also enabled for this module?
 #  define DEBUGGING                                        //   Yes, include DEBUGGING sections of this module in the compilation
 # endif
-# if defined(CO_DEBUGGING) || defined(MYRCS_DEBUGGING)     //  Yes, is debugging enabled for at least one module?
-#  define DO_SERIAL_DEBUG                                  //   Yes, include SendOnlySoftwareSerial / SerialDebug stuff in the compilation
-# endif
 #endif
 
-#define PRJ_BAUD_RATE      115200                          // For use with both Serial.begin() and SerialDebug.begin() ... in the setup() function
+#ifdef DEBUGGING
+# define LOG( byCode, byArg, lArg )  Log_Write( byCode, byArg, lArg )
+#else                                                      // Log an event (see LogCodes.h), or not
+# define LOG( byCode, byArg, lArg )
+#endif
+
+#define PRJ_BAUD_RATE      115200                          // For use with UART_Begin() ... in the setup() function
 //#define PRJ_BAUD_RATE       57600
 //#define PRJ_BAUD_RATE       38400
 //#define PRJ_BAUD_RATE       19200
 //#define PRJ_BAUD_RATE       14400
 //#define PRJ_BAUD_RATE        9600
 
-//#define PRJ_DEBUG_RX_PIN        8                          // Pins for debugging via SoftwareSerial
-#define PRJ_DEBUG_TX_PIN        9                          // (SendOnlySoftwareSerial requires only a TX pin)
+#define EVT_BOOT                1                          // Event frames ("<CO_EVT>[E:n]...[]") we send without being asked:
+#define EVT_SENT                2                          //  Just (re)started; an ON/OFF code went out; a remote control's
+#define EVT_LEARNED             3                          //  code was learned; something went wrong; the dead-man timer
+#define EVT_ERROR               4                          //  turned the outlet ON
+#define EVT_DEADMAN             5
+
+#define ERR_LEARN_TIMEOUT       1                          // EVT_ERROR codes: No code heard within RCS_LEARN_MS
+#define ERR_UNKNOWN_SIGNAL      2                          //                  Signal we don't recognize (PC is newer than us?)
+#define ERR_SAVE_FAILED         3                          //                  Settings couldn't be written to EEPROM
+#define ERR_BAD_INDEX           4                          // SETTINGS_ERR_SIGNAL code: [Idx:n] isn't an outlet profile
+
+#define FIELD_TIMEOUT_MS       20UL                        // Longest wait for the next "[...]" after a signal (the PC sends
+                                                           //  them all together, so it's normally only a few byte-times)
 
-  /* Global variables */
-#ifdef DO_SERIAL_DEBUG
-SendOnlySoftwareSerial SerialDebug( PRJ_DEBUG_TX_PIN );
+#define TX_EVENT                1                          // What to do when a queued ON/OFF code has gone out (see
+#define TX_REPLY                2                          //  ServiceTransmitter()): send EVT_SENT; reply to ON/OFF with
+#define TX_BATCH                3                          //  [Seen:n]; reply to BATCH once they've all gone; send
+#define TX_DEADMAN              4                          //  EVT_DEADMAN
+
+#define SIGNAL_SLOTS           32                          // Entries in CommandSlots[] (a power of 2; see SignalHash())
+#define NO_COMMAND            255                          // Empty CommandSlots[] entry
+
+#ifdef __AVR__
+# define PGM_S               "%S"                          // sprintf_P() format for a string that's in flash
+#else
+# define PGM_S               "%s"                          //  (which is just ordinary memory on other chips)
 #endif
 
+  /* Signals we respond to: X( name, signal, handler ). Adding one here is all
+     it takes; the compiler checks that SignalHash() still gives each signal a
+     CommandSlots[] entry of its own. Add new ones at the end: STATS reports
+     each signal's handling time in this order. */
+#define COMMANDS( X )                                                  \
+  X( WAKE,        "<CO_WAKE>",        HandleWake       )               \
+  X( ON,          "<CO_ON>",          HandleOn         )               \
+  X( OFF,         "<CO_OFF>",         HandleOff        )               \
+  X( HEARTBEAT,   "<CO_BEAT>",        HandleHeartbeat  )               \
+  X( SETTINGS,    "<CO_SETTINGS>",    HandleSettings   )               \
+  X( OUTLET,      "<CO_OUTLET>",      HandleOutlet     )               \
+  X( LEARN,       "<CO_LEARN>",       HandleLearn      )               \
+  X( VERSION,     "<CO_VERSION>",     HandleVersion    )               \
+  X( EEPROM,      "<CO_EEPROM>",      HandleEEPROM     )               \
+  X( BATCH,       "<CO_BATCH>",       SendBatch        )               \
+  X( HASH,        "<CO_HASH>",        SendSettingsHash )               \
+  X( LIMITS,      "<CO_LIMITS>",      ReadLimits       )               \
+  X( SAMPLE,      "<CO_SAMPLE>",      TakeSample       )               \
+  X( LEARN_START, "<CO_LEARN_START>", HandleLearnStart )               \
+  X( LOG,         "<CO_LOG>",         HandleLog        )               \
+  X( STATS,       "<CO_STATS>",       HandleStats      )
+
+#define COMMAND_STRING( name, text, fn )  const char name##_SIGNAL[] PROGMEM = text;
+#define COMMAND_HASH(   name, text, fn )  SignalHash( text, sizeof(text) - 1 ),
+#define COMMAND_ENTRY(  name, text, fn )  { name##_SIGNAL, fn },
+
+#define DEADMAN_CHECK_MS      250UL                        // How often loop() runs CheckDeadMan()
+#define LOOP_RATE_MS         1000UL                        // loop() passes are counted over this long (see ulLoopRate)
+#ifdef __AVR__
+# define IDLE_SLEEP                                        // loop() sleeps when there's nothing to do (see SleepUntilInterrupt())
+#endif
+
+#define CTL_NONE              255                          // Control loop hasn't sent an ON/OFF code (yet)
+#define CTL_RESEND_MS      20000UL                         // Resend the ON/OFF code if the samples still show the AC line
+                                                           //  unchanged after this long
+
+  /* Typedefs */
+typedef struct {                                           // A "[Name:value]" that a signal may be followed by
+  const char *szTag;                                       //  "[Name:"
+  long       *plValue;                                     //  Where to put the value
+} NAMED_LONG;
+
+typedef struct {                                           // A signal we respond to (see COMMANDS)
+  const char *szSignalP;                                   //  "<CO_xxx>" (in flash)
+  void      (*pfnHandler)( void );                         //  Reads whatever follows it, and replies
+} COMMAND;
+
+typedef struct {                                           // Something loop() does (see the Tasks[] list)
+  void          (*pfnTask)( void );                        //  Does a little work and returns
+  unsigned long ulPeriodMs;                                //  How often to run it (0 = every time round)
+  unsigned long ulLastMs;                                  //  millis() when it last ran
+} TASK;
+
   /* Local variables */
 const byte   numChars            = 90;                    // numChars must be at least 2
       char   receivedChars[numChars];                     // Input string buffer
       bool   bNewData;                                    // Did we successfully read an input string via serial connection?
       OUTLET TempOutlet;
 
-const char WAKE_SIGNAL[]         = "<CO_WAKE>";           // Signal payload strings
-const char WAKE_OK_SIGNAL[]      = "<CO_WAKE_OK>";
-const char ON_SIGNAL[]           = "<CO_ON>";
-const char ON_OK_SIGNAL[]        = "<CO_ON_OK>";
-const char OFF_SIGNAL[]          = "<CO_OFF>";
-const char OFF_OK_SIGNAL[]       = "<CO_OFF_OK>";
-const char HEARTBEAT_SIGNAL[]    = "<CO_BEAT>";
-const char HEARTBEAT_OK_SIGNAL[] = "<CO_BEAT_OK>";
-const char SETTINGS_SIGNAL[]     = "<CO_SETTINGS>";
-const char SETTINGS_OK_SIGNAL[]  = "<CO_SETTINGS_OK>";
-const char OUTLET_SIGNAL[]       = "<CO_OUTLET>";
-const char OUTLET_OK_SIGNAL[]    = "<CO_OUTLET_OK>";
-const char LEARN_SIGNAL[]        = "<CO_LEARN>";
-const char LEARN_OK_SIGNAL[]     = "<CO_LEARN_OK>";
-const char VERSION_SIGNAL[]      = "<CO_VERSION>";
-const char VERSION_OK_SIGNAL[]   = "<CO_VERSION_OK>";
-const char EEPROM_SIGNAL[]       = "<CO_EEPROM>";
-const char EEPROM_OK_SIGNAL[]    = "<CO_EEPROM_OK>";
+COMMANDS( COMMAND_STRING )                                // Signal payload strings (all in flash, with the replies)
+
+const char WAKE_OK_SIGNAL[]         PROGMEM = "<CO_WAKE_OK>";
+const char ON_OK_SIGNAL[]           PROGMEM = "<CO_ON_OK>";
+const char OFF_OK_SIGNAL[]          PROGMEM = "<CO_OFF_OK>";
+const char HEARTBEAT_OK_SIGNAL[]    PROGMEM = "<CO_BEAT_OK>";
+const char SETTINGS_OK_SIGNAL[]     PROGMEM = "<CO_SETTINGS_OK>";
+const char SETTINGS_ERR_SIGNAL[]    PROGMEM = "<CO_SETTINGS_ERR>";
+const char OUTLET_OK_SIGNAL[]       PROGMEM = "<CO_OUTLET_OK>";
+const char LEARN_OK_SIGNAL[]        PROGMEM = "<CO_LEARN_OK>";
+const char VERSION_OK_SIGNAL[]      PROGMEM = "<CO_VERSION_OK>";
+const char EEPROM_OK_SIGNAL[]       PROGMEM = "<CO_EEPROM_OK>";
+const char BATCH_OK_SIGNAL[]        PROGMEM = "<CO_BATCH_OK>";
+const char HASH_OK_SIGNAL[]         PROGMEM = "<CO_HASH_OK>";
+const char LIMITS_OK_SIGNAL[]       PROGMEM = "<CO_LIMITS_OK>";
+const char SAMPLE_OK_SIGNAL[]       PROGMEM = "<CO_SAMPLE_OK>";
+const char LEARN_START_OK_SIGNAL[]  PROGMEM = "<CO_LEARN_START_OK>";
+const char LOG_OK_SIGNAL[]          PROGMEM = "<CO_LOG_OK>";
+const char STATS_OK_SIGNAL[]        PROGMEM = "<CO_STATS_OK>";
+const char EVENT_SIGNAL[]           PROGMEM = "<CO_EVT>";
+
+      long          lCtlMin;                              // Control loop (see TakeSample()): turn the outlet ON at this %
+      long          lCtlMax;                              //  and OFF at this %
+      unsigned long ulDeadManMs       = 0;                // Turn the outlet ON if no sample arrives for this long (0 = the PC
+                                                          //  is making the decisions)
+      unsigned long ulLastSampleMs;                       // millis() when the last sample arrived
+      byte          byCtlCommanded    = CTL_NONE;         // ON/OFF code last sent by the control loop (1 = ON)
+      unsigned long ulCtlCmdMs;                           //  and when
+      long          lDeadManTrips     = 0;                // Times the dead-man timer has turned the outlet ON
+      unsigned int  uSettingsGen      = 0;                // Bumped whenever the PC changes the outlet settings (0 = as loaded
+                                                          //  from EEPROM, so the PC can tell we've restarted)
+      bool          bLearning         = false;            // Listening for a remote control (after LEARN_START)?
+      unsigned long ulLearnStartMs;                       //  Yes, since this millis()
+      bool          bLearnReply       = false;            //   and the PC is waiting for "<CO_LEARN_OK>" (old-style LEARN)
+      byte          byBatchPending    = 0;                // BATCH codes still to go out (the reply waits for them)
+      int           nBatchSent;                           //  Profiles whose code has gone out (bit n = profile n)
+      int           nBatchSeen;                           //  and been heard
+      unsigned long ulWorstSliceUs    = 0;                // Longest any task has kept loop() busy (reported by VERSION)
+      unsigned long ulLoops           = 0;                // Passes through loop() since ulLoopRateMs
+      unsigned long ulLoopRateMs      = 0;                //  (millis() when counting started)
+      unsigned long ulLoopRate        = 0;                //  and how many there were in the LOOP_RATE_MS before that
+      unsigned long ulSleptUs         = 0;                // Time spent asleep since ulLoopRateMs
+      unsigned int  uIdlePermille     = 0;                //  and the share of the LOOP_RATE_MS before that (1000 = all)
+      unsigned int  uLearnTries       = 0;                // LEARN and LEARN_START signals received
 
   /*  Static function prototypes */
-static void EEPROMread(                OUTLET *pOutlet );
 static void ReadDelimitedString( const char   startMarker, const char endMarker );
-static void ReadSettings(              void );
+static bool ReadField(                 void );
+static bool ReadSettings(              byte   *pbyIdx,     bool *pbChanged );
+static void SendBatch(                 void );
+static void SendSettingsHash(          void );
+static void ReadNamedLongs(      const NAMED_LONG *pList,       byte byCount );
+static void ReadLimits(                void );
+static void TakeSample(                void );
+static void CheckDeadMan(              void );
+static void CheckLearning(             void );
+static void SendEvent(                 byte   byEvent,    const char *szFields );
+static void SendOKWithStatus(          const char *szOKsignalP );
+static unsigned int SettingsHash(      byte   byCount );
 static void ReadLong(                  char   *longStr,          long *longVariable );
-static bool LearnCode(                 OUTLET *pOutlet );
+static void SendCodeAndReply(          bool   bOn );
+static void ServiceSerial(             void );
+static void HandleWake(                void );
+static void HandleOn(                  void );
+static void HandleOff(                 void );
+static void HandleHeartbeat(           void );
+static void HandleSettings(            void );
+static void HandleOutlet(              void );
+static void HandleLearn(               void );
+static void HandleVersion(             void );
+static void HandleEEPROM(              void );
+static void HandleLearnStart(          void );
+static void HandleLog(                 void );
+static void HandleStats(               void );
+static void SendReply(           const char   *szReply );
+static void SendReplyP(          const char   *szReplyP );
+static void ServiceTransmitter(        void );
+static void SleepUntilInterrupt(       void );
 #ifdef DEBUGGING
-static void PrintOutletValues(         OUTLET *pOutlet, char *szHeading );
+static void LogOutletValues(           byte   byIdx );
 #endif
 
+  /* Tasks for loop() to run, in turn */
+static TASK Tasks[] = {
+  { ServiceSerial,      0,                0 },             // Signals from the PC
+  { ServiceTransmitter, 0,                0 },             // Next frame of a queued ON/OFF code
+  { CheckLearning,      0,                0 },             // Remote control we're listening for
+  { CheckDeadMan,       DEADMAN_CHECK_MS, 0 }              // Battery samples from the PC
+};
+
+
+/*****************************************************************************
+ * FUNC: SignalHash                                                          *
+ * DESC: Work out which CommandSlots[] entry a signal belongs in             *
+ * ARGS: szSignal = "<CO_xxx>" (at least 5 characters)                       *
+ *       byLen    = Its length                                               *
+ * RET:  0 .. SIGNAL_SLOTS-1                                                 *
+ * NOTE: Uses the first character after "<CO_" and the length, which is     *
+ *       enough to tell all of COMMANDS apart. Runs at compile time to fill  *
+ *       CommandSlots[], and in ServiceSerial() to look a signal up.         *
+ *****************************************************************************/
+constexpr byte SignalHash( const char *szSignal, byte byLen )
+{
+  return (byte)((2 * szSignal[4] + byLen) & (SIGNAL_SLOTS - 1));
+}
+
+constexpr byte CommandHash[] = { COMMANDS( COMMAND_HASH ) };   // (Compile time only; nothing here ends up in SRAM)
+#define NUM_COMMANDS  (sizeof(CommandHash) / sizeof(CommandHash[0]))
+
+
+/*****************************************************************************
+ * FUNC: FindCommand                                                         *
+ * DESC: Find the signal (if any) that belongs in a CommandSlots[] entry     *
+ * ARGS: bySlot = The entry                                                  *
+ *       byIdx  = Commands[] entry to start looking at                       *
+ * RET:  Index into Commands[], or NO_COMMAND                                *
+ *****************************************************************************/
+constexpr byte FindCommand( byte bySlot, byte byIdx = 0 )
+{
+  return (byIdx == NUM_COMMANDS)          ? NO_COMMAND
+       : (CommandHash[byIdx] == bySlot)   ? byIdx
+       :                                    FindCommand( bySlot, byIdx + 1 );
+}
+
+
+/*****************************************************************************
+ * FUNC: HashesUnique                                                        *
+ * DESC: Check that no two signals belong in the same CommandSlots[] entry   *
+ * ARGS: byIdx  = Commands[] entry being checked                             *
+ *       byNext = Entry it's being compared with                             *
+ * RET:  true = They're all different                                        *
+ *****************************************************************************/
+constexpr bool HashesUnique( byte byIdx = 0, byte byNext = 1 )
+{
+  return (byIdx >= NUM_COMMANDS - 1)      ? true
+       : (byNext == NUM_COMMANDS)         ? HashesUnique( byIdx + 1, byIdx + 2 )
+       :    (CommandHash[byIdx] != CommandHash[byNext])
+         && HashesUnique( byIdx, byNext + 1 );
+}
+
+static_assert( HashesUnique(), "Two signals share a CommandSlots[] entry; change SignalHash()" );
+static_assert( SIGNAL_SLOTS == 32, "CommandSlots[] below is written out for 32 entries" );
+
+  /* Signals from the PC: Commands[] lists them, and CommandSlots[] says which
+     one (if any) each SignalHash() value stands for. Both are in flash. */
+static const COMMAND Commands[] PROGMEM = {
+  COMMANDS( COMMAND_ENTRY )
+};
+
+#define SLOTS_4( n )  FindCommand( n ), FindCommand( n + 1 ), FindCommand( n + 2 ), FindCommand( n + 3 )
+static const byte CommandSlots[SIGNAL_SLOTS] PROGMEM = {
+  SLOTS_4(  0 ), SLOTS_4(  4 ), SLOTS_4(  8 ), SLOTS_4( 12 ),
+  SLOTS_4( 16 ), SLOTS_4( 20 ), SLOTS_4( 24 ), SLOTS_4( 28 )
+};
+
+static unsigned int CmdWorstUs[NUM_COMMANDS];             // Longest each signal's handler has taken (us, up to 65535)
+
 
 /*****************************************************************************
  * FUNC: setup                                                               *
@@ -86,173 +297,531 @@ static void PrintOutletValues(         OUTLET *pOutlet, char *szHeading );
  *       Sets up comm links for 433MHz transmitter and serial ports          *
  * ARGS: [None]                                                              *
  * RET:  [None]                                                              *
+ * NOTE: The outlet settings must be restored from EEPROM here because of    *
+ *       the "Hibernate" feature of Windows. If the PC is "Hibernated" while *
+ *       ChargeOn is running, when the PC is restored it will appear that    *
+ *       ChargeOn is running fine -- but the Arduino module will have lost   *
+ *       the outlet info when it was powered down at "Hibernate" time.       *
  *****************************************************************************/
 void setup( void )
 {
-  Serial.begin( PRJ_BAUD_RATE );                            // For communicating with Windows "ChargeOn" program
-#ifdef DO_SERIAL_DEBUG
-  SerialDebug.begin( PRJ_BAUD_RATE );                       // Start serial communications (for debugging)
-  SerialDebug.println( "************************************************************" );
+  UART_Begin( PRJ_BAUD_RATE );                              // For communicating with Windows "ChargeOn" program
+#ifdef IDLE_SLEEP
+  ADCSRA &= ~_BV(ADEN);                                     // Power down what we don't use (the ADC has to be turned
+  ACSR   |=  _BV(ACD);                                      //  off before its clock is, or it keeps drawing current)
+  power_adc_disable();
+# ifdef power_twi_disable
+  power_twi_disable();
+# endif
+# ifdef power_spi_disable
+  power_spi_disable();
+# endif
+# ifdef power_timer2_disable
+  power_timer2_disable();
+# endif
+  set_sleep_mode( SLEEP_MODE_IDLE );
 #endif
-  EEPROMread( &Outlet );                                    // Restore outlet settings from EEPROM
+  LOG( LOG_BOOT, 0, 0 );
+  JNL_Load( Outlets );                                      // Restore outlet settings from EEPROM (see note above)
   RCTransmitterSetup();                                     // Configure 433MHz RF Transmitter
   RCReceiverSetup();                                        // Configure 433MHz RF Receiver
+  SendEvent( EVT_BOOT, "" );                                // Tell the PC we've (re)started (e.g. after hibernation)
 }
 
 
 /*****************************************************************************
- * FUNC: EEPROMread                                                          *
- * DESC: (Re)populate Outlet settings from EEPROM                            *
- *         1) Call this function from setup()                                *
- *            This is necessary because of the "Hibernate" feature of        *
- *            Windows. If the PC is "Hibernated" while ChargeOn is running,  *
- *            when the PC is restored it will appear that ChargeOn is running*
- *            fine -- but the Arduino module will have lost the outlet info  *
- *            when it was powered down at "Hibernate" time. If this function *
- *            is NOT called first, when it's time to turn the outlet ON or   *
- *            OFF the wrong code (0) will be sent to the outlet.             *
- *         2) Call this function any time to capture current EEPROM values   *
- * ARGS: pOutlet = Address of Outlet structure to be populated from EEPROM   *
+ * FUNC: loop                                                                *
+ * DESC: Main program logic                                                  *
+ *       Executes after setup(); runs "forever" (until power is removed)     *
+ *       Runs each task in Tasks[] that's due, keeping track of the longest  *
+ *       any of them takes, then sleeps until the next interrupt             *
+ * ARGS: [None]                                                              *
  * RET:  [None]                                                              *
+ * NOTE: No task may wait for anything; each does a slice of its work and    *
+ *       returns. ON/OFF codes play in the background (Timer1), or, on a     *
+ *       board without it, one RF frame per slice (see RCS_TxPoll()), so a   *
+ *       signal from the PC is never kept waiting long.                      *
  *****************************************************************************/
-static void EEPROMread( OUTLET *pOutlet ) {
-  int  nStartOffset = 0;
+void loop( void )
+{
+  ulLoops++;
+  if( millis() - ulLoopRateMs >= LOOP_RATE_MS ) {          // Time to take the loop rate?
+    ulLoopRate    = ulLoops;                               //  Yes (reported by STATS)
+    uIdlePermille = (unsigned int)(ulSleptUs / (millis() - ulLoopRateMs));
+    ulLoops       = 0;
+    ulSleptUs     = 0;
+    ulLoopRateMs  = millis();
+  }
 
-  EEPROM.get( nStartOffset, *pOutlet );
-/*
-#ifdef DEBUGGING
-  PrintOutletValues( pOutlet, "Current EEPROM" );
+  for( byte i = 0; i < sizeof(Tasks)/sizeof(Tasks[0]); i++ ) {
+    TASK          *pTask = &Tasks[i];
+    unsigned long  ulStartUs;
+    unsigned long  ulSliceUs;
+
+    if( pTask->ulPeriodMs && (millis() - pTask->ulLastMs < pTask->ulPeriodMs) ) {
+      continue;                                            // Not due yet
+    }
+    pTask->ulLastMs = millis();
+    ulStartUs       = micros();
+    pTask->pfnTask();
+    ulSliceUs       = micros() - ulStartUs;
+    if( ulSliceUs > ulWorstSliceUs ) {
+      ulWorstSliceUs = ulSliceUs;
+    }
+  }
+  SleepUntilInterrupt();
+}
+
+
+/*****************************************************************************
+ * FUNC: SleepUntilInterrupt                                                 *
+ * DESC: Stop the CPU until something happens, unless there's already more   *
+ *       to do                                                               *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Idle mode only stops the CPU clock; the timers, the USART and the   *
+ *       pin-change/external interrupts all keep running, and any of them    *
+ *       wakes it within a few cycles. Everything the tasks wait for comes   *
+ *       in by interrupt (bytes from the PC, the receiver's edges, Timer1    *
+ *       finishing a code), and Timer0's millis() tick wakes it at least     *
+ *       every 1.024ms for the timed tasks, so nothing waits any longer than *
+ *       it did when loop() spun. A byte arriving between the check and the  *
+ *       sleep can't be missed: SEI takes effect after the instruction that  *
+ *       follows it, so the interrupt wakes the CPU from that sleep.         *
+ *****************************************************************************/
+static void SleepUntilInterrupt( void )
+{
+#ifdef IDLE_SLEEP
+  unsigned long ulStartUs = micros();
+
+  cli();
+  if( UART_RxWaiting() ) {                                 // More of a signal already here?
+    sei();                                                 //  Yes, get straight on with it
+    return;
+  }
+  sleep_enable();
+  sei();
+  sleep_cpu();                                             // Sleep (the interrupt that wakes us is handled first)
+  sleep_disable();
+  ulSleptUs += micros() - ulStartUs;
 #endif
-*/
-}  // EEPROMread()
+}
 
 
 /*****************************************************************************
- * FUNC: loop                                                                *
- * DESC: Main program logic                                                  *
- *       Executes after setup(); runs "forever" (until power is removed)     *
- *       Watches for angle-bracket-delimited signals from a PC running the   *
- *       Win32 "ChargeOn" program                                            *
+ * FUNC: ServiceSerial                                                       *
+ * DESC: Watches for angle-bracket-delimited signals from a PC running the   *
+ *       Win32 "ChargeOn" program, and responds to them                      *
  * ARGS: [None]                                                              *
  * RET:  [None]                                                              *
+ * NOTE: The signal is looked up in CommandSlots[] (one flash read), then    *
+ *       checked against the only signal that can be in that slot, so it     *
+ *       takes the same time however many signals there are.                 *
+ *       ON/OFF codes are only queued here; ServiceTransmitter() sends them. *
+ *       Each handler is timed for STATS (which includes waiting for the     *
+ *       "[...]" that follows the signal).                                   *
  *****************************************************************************/
-void loop( void )
+static void ServiceSerial( void )
 {
+  COMMAND Command;
+  byte    byLen;
+  byte    byIdx = NO_COMMAND;
+
   ReadDelimitedString( '<', '>' );                         // Watch for next signal string
   if( bNewData ) {                                         // Did we read the signal successfully?
-#ifdef DEBUGGING
-    SerialDebug.print( "Received signal: " );  SerialDebug.println( receivedChars );
-                                                           //  Yes, report back
-#endif
-
       // See what kind of signal it is...
-    if( !strcmp(receivedChars, WAKE_SIGNAL) ) {            //   WAKE signal
-      Serial.print( WAKE_OK_SIGNAL );                      //    Send response to PC
-#ifdef DEBUGGING
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( WAKE_OK_SIGNAL );
-#endif
+    byLen = strlen( receivedChars );
+    LOG( LOG_RECEIVED, byLen, Log_Text4(receivedChars + 4) );
+    if( byLen > 5 ) {                                      //   Long enough to be "<CO_x>"? Find its slot
+      byIdx = pgm_read_byte( &CommandSlots[SignalHash(receivedChars, byLen)] );
     }
-
-    else if( !strcmp(receivedChars, ON_SIGNAL) ) {         //   ON signal
-      Serial.print( ON_OK_SIGNAL );                        //    Send response to PC
-#ifdef DEBUGGING
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( ON_OK_SIGNAL );
-#endif
-      RCS_SendOnCode();                                    //    Send "Turn ON" signal to remote outlet
+    if( byIdx != NO_COMMAND ) {                            //   Is it the signal that belongs there?
+      memcpy_P( &Command, &Commands[byIdx], sizeof(Command) );
+      if( strcmp_P(receivedChars, Command.szSignalP) ) {
+        byIdx = NO_COMMAND;
+      }
     }
 
-    else if( !strcmp(receivedChars, OFF_SIGNAL) ) {        //   OFF signal
-      Serial.print( OFF_OK_SIGNAL );                       //    Send response to PC
-#ifdef DEBUGGING
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( OFF_OK_SIGNAL );
-#endif
-      RCS_SendOffCode();                                   //    Send "Turn OFF" signal to remote outlet
-    }
-    
-    else if( !strcmp(receivedChars, HEARTBEAT_SIGNAL) ) {  //   BEAT signal
-      Serial.print( HEARTBEAT_OK_SIGNAL );                 //    Send response to PC
-#ifdef DEBUGGING
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( HEARTBEAT_OK_SIGNAL );
-#endif
-    }
+    if( byIdx != NO_COMMAND ) {
+      unsigned long ulStartUs = micros();
+      unsigned long ulTookUs;
 
-    else if( !strcmp(receivedChars, SETTINGS_SIGNAL) ) {   //   SETTINGS signal
-      ReadSettings();                                      //    Read series of square-bracket-delimited Outlet Setting names & values
-      Serial.print( SETTINGS_OK_SIGNAL );                  //    Send response to PC
-#ifdef DEBUGGING
-      PrintOutletValues( &Outlet, "Post-SETTINGS" );
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( SETTINGS_OK_SIGNAL );
-#endif
-      RCTransmitterSetup();                                //    Initialize RF Transmitter
+      Command.pfnHandler();                                //   Yes, deal with it (and respond to PC)
+      ulTookUs = micros() - ulStartUs;
+      if( ulTookUs > CmdWorstUs[byIdx] ) {
+        CmdWorstUs[byIdx] = (ulTookUs > 0xFFFF) ? 0xFFFF : (unsigned int)ulTookUs;
+      }
     }
+    else {                                                 //   No, something else
+      char szError[12];
 
-    else if( !strcmp(receivedChars, OUTLET_SIGNAL) ) {     //   OUTLET signal
-      Serial.print( OUTLET_OK_SIGNAL );                    //    Send response to PC
-#ifdef DEBUGGING
-      PrintOutletValues( &Outlet, "Current Outlet" );
-      SerialDebug.print( "  Sending reply: " );   SerialDebug.println( OUTLET_OK_SIGNAL );
-#endif
+      sprintf_P( szError, PSTR("[Err:%d]"), ERR_UNKNOWN_SIGNAL );
+      SendEvent( EVT_ERROR, szError );
     }
 
-    else if( !strcmp(receivedChars, LEARN_SIGNAL) ) {      //   LEARN signal
-      char szLearnCodeBuffer[75];
-      if( LearnCode( &TempOutlet) ) {                      //    Learn code (and related info) from button press on outlet's remote control
-        sprintf( szLearnCodeBuffer, "%s[Code:%ld][Pro:%ld][PLen:%ld][VLen:%ld][]",
-                                    LEARN_OK_SIGNAL,
-                                    TempOutlet.OnCode,
-                                    TempOutlet.Protocol,
-                                    TempOutlet.PulseLength,
-                                    TempOutlet.ValueLength );
-/*
-#ifdef DEBUGGING
-        SerialDebug.print( " Detected code = " );  SerialDebug.println( TempOutlet.OnCode );
-        SerialDebug.print( "      Protocol = " );  SerialDebug.println( TempOutlet.Protocol );
-        SerialDebug.print( "  Pulse Length = " );  SerialDebug.println( TempOutlet.PulseLength );
-        SerialDebug.print( "    Bit Length = " );  SerialDebug.println( TempOutlet.ValueLength );
-#endif
-*/
-      }
-      else {
-        sprintf( szLearnCodeBuffer, "%s[]", LEARN_OK_SIGNAL );
-      }
-      Serial.print( szLearnCodeBuffer );                   //    Send response to PC
-#ifdef DEBUGGING
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( szLearnCodeBuffer );
-#endif
-    }
+    receivedChars[0] = '\0';                               //   Truncate the latest input string
+    bNewData         = false;                              //   We no longer have an "active" input string
+  }
+}
 
-    else if( !strcmp(receivedChars, VERSION_SIGNAL) ) {    //   VERSION signal
-      char szVersionInfoBuffer[50];
 
-      sprintf( szVersionInfoBuffer, "%s[Build:%s][]", VERSION_OK_SIGNAL, PRJ_VERSION );
-      Serial.print( szVersionInfoBuffer );                 //    Send response to PC
+/*****************************************************************************
+ * FUNC: HandleWake                                                          *
+ * DESC: WAKE signal: say we're here (see SendOKWithStatus())                *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void HandleWake( void )
+{
+  SendOKWithStatus( WAKE_OK_SIGNAL );                      // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleOn                                                            *
+ * DESC: ON signal: turn the laptop's outlet ON                              *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void HandleOn( void )
+{
+  SendCodeAndReply( true );                                // Send "Turn ON" signal to remote outlet (and respond to PC)
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleOff                                                           *
+ * DESC: OFF signal: turn the laptop's outlet OFF                            *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void HandleOff( void )
+{
+  SendCodeAndReply( false );                               // Send "Turn OFF" signal to remote outlet (and respond to PC)
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleHeartbeat                                                     *
+ * DESC: BEAT signal: say we're still here (see SendOKWithStatus())          *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void HandleHeartbeat( void )
+{
+  SendOKWithStatus( HEARTBEAT_OK_SIGNAL );                 // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleSettings                                                      *
+ * DESC: SETTINGS signal: read an outlet profile, and start using it         *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: If the profile changed but couldn't be saved, an EVT_ERROR follows  *
+ *       the reply; the new settings are used anyway (until the next boot).  *
+ *       If "[Idx:n]" isn't a profile, nothing is changed and the reply is   *
+ *         "<CO_SETTINGS_ERR>[Err:4][]"                                      *
+ *****************************************************************************/
+static void HandleSettings( void )
+{
+  bool bChanged;
+  bool bSaved = true;
+  byte byIdx;
+
+  if( !ReadSettings(&byIdx, &bChanged) ) {                 // Read series of square-bracket-delimited Outlet Setting names & values
+    char szReplyBuffer[28];                                //  (Not for a profile we have? Say so, and leave them all alone)
+
+    sprintf_P( szReplyBuffer, PSTR(PGM_S "[Err:%d][]"), SETTINGS_ERR_SIGNAL, ERR_BAD_INDEX );
+    SendReply( szReplyBuffer );
+    return;
+  }
+  if( bChanged ) {
+    uSettingsGen++;
+    bSaved = JNL_Save( byIdx, &Outlets[byIdx] );           // Update outlet settings in EEPROM (in case user "Hibernates"
+  }                                                        //  laptop while ChargeOn is running)
+  SendOKWithStatus( SETTINGS_OK_SIGNAL );                  // Send response to PC
+  LOG( LOG_SAVED, byIdx, bSaved ? 1 : 0 );
+  if( !bSaved ) {
+    char szError[12];
+
+    sprintf_P( szError, PSTR("[Err:%d]"), ERR_SAVE_FAILED );
+    SendEvent( EVT_ERROR, szError );
+  }
 #ifdef DEBUGGING
-      SerialDebug.print( "  Sending reply: " );  SerialDebug.println( szVersionInfoBuffer );
+  LogOutletValues( byIdx );
 #endif
-    }
+  if( bChanged ) {                                         // Anything new?
+    RCTransmitterSetup();                                  //  Yes, initialize RF Transmitter
+  }
+}
+
 
-    else if( !strcmp(receivedChars, EEPROM_SIGNAL) ) {     //   EEPROM signal
-      char szEEPROMbuffer[75];
-
-      EEPROMread( &TempOutlet );                           //    Read outlet settings from EEPROM
-      sprintf( szEEPROMbuffer, "%s[On:%ld][Off:%ld][Pro:%ld][PLen:%ld][PReps:%ld][TOBQ:%ld][VLen:%ld][]",
-                                  EEPROM_OK_SIGNAL,
-                                  TempOutlet.OnCode,
-                                  TempOutlet.OffCode,
-                                  TempOutlet.Protocol,
-                                  TempOutlet.PulseLength,
-                                  TempOutlet.PulseRepeats,
-                                  TempOutlet.TurnOnBeforeQuit,
-                                  TempOutlet.ValueLength );
-      Serial.print( szEEPROMbuffer );                      //    Send response to PC
+/*****************************************************************************
+ * FUNC: HandleOutlet                                                        *
+ * DESC: OUTLET signal: just acknowledge it                                  *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void HandleOutlet( void )
+{
+  SendReplyP( OUTLET_OK_SIGNAL );                          // Send response to PC
 #ifdef DEBUGGING
-      PrintOutletValues( &TempOutlet, "Current EEPROM" );
-      SerialDebug.print( "  Sending reply: " );   SerialDebug.println( szEEPROMbuffer );
+  LogOutletValues( 0 );
 #endif
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleLearn                                                         *
+ * DESC: LEARN signal (old-style): listen for a button press on the outlet's *
+ *       remote control                                                      *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: CheckLearning() replies when it's heard (or not).                   *
+ *****************************************************************************/
+static void HandleLearn( void )
+{
+  if( !bLearning ) {
+    RCS_LearnStart();
+  }
+  bLearning      = true;
+  bLearnReply    = true;
+  ulLearnStartMs = millis();
+  uLearnTries++;
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleVersion                                                       *
+ * DESC: VERSION signal: "<CO_VERSION_OK>[Build:x.y.z][Slice:us][]"          *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void HandleVersion( void )
+{
+  char szVersionInfoBuffer[60];
+
+  sprintf_P( szVersionInfoBuffer, PSTR(PGM_S "[Build:" PRJ_VERSION "][Slice:%lu][]"), VERSION_OK_SIGNAL, ulWorstSliceUs );
+  SendReply( szVersionInfoBuffer );                        // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleEEPROM                                                        *
+ * DESC: EEPROM signal: reply with the (laptop's) outlet settings as saved   *
+ *       in EEPROM                                                           *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Outlets[0] is the RAM copy (HandleSettings() has saved any change,  *
+ *       and reports it if that failed), so EEPROM isn't read again.         *
+ *****************************************************************************/
+static void HandleEEPROM( void )
+{
+  const OUTLET *pOutlet = &Outlets[0];
+  char          szEEPROMbuffer[148];                       // Worst case: the 14-character signal, seven
+                                                           //  "[Tag:-2147483648]" (123), "[Loop:1][]" and the NUL
+
+  sprintf_P( szEEPROMbuffer, PSTR(PGM_S "[On:%ld][Off:%ld][Pro:%ld][PLen:%ld][PReps:%ld][TOBQ:%ld][VLen:%ld][Loop:%ld][]"),
+                               EEPROM_OK_SIGNAL,
+                               pOutlet->OnCode,
+                               pOutlet->OffCode,
+                               pOutlet->Protocol,
+                               pOutlet->PulseLength,
+                               pOutlet->PulseRepeats,
+                               pOutlet->TurnOnBeforeQuit,
+                               pOutlet->ValueLength,
+                               (pOutlet->Loopback == 1) ? 1L : 0L );
+  SendReply( szEEPROMbuffer );                             // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleLearnStart                                                    *
+ * DESC: LEARN_START signal: reply "<CO_LEARN_START_OK>[Ms:n][]" straight    *
+ *       away, then listen for a button press on the outlet's remote control *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: The code (or a timeout error) follows as an event (see              *
+ *       CheckLearning()).                                                   *
+ *****************************************************************************/
+static void HandleLearnStart( void )
+{
+  char szReply[40];
+
+  sprintf_P( szReply, PSTR(PGM_S "[Ms:%lu][]"), LEARN_START_OK_SIGNAL, RCS_LEARN_MS );
+  SendReply( szReply );                                    // Send response to PC
+  if( !bLearning ) {
+    RCS_LearnStart();
+  }
+  bLearning      = true;
+  bLearnReply    = false;
+  ulLearnStartMs = millis();
+  uLearnTries++;
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleLog                                                           *
+ * DESC: LOG signal: send the oldest few log entries:                        *
+ *         "<CO_LOG_OK>[Lost:n][D:hex...][More:n][]"                         *
+ *       where Lost = entries overwritten before they could be sent, D holds *
+ *       up to LOG_PER_REPLY entries (LOG_HEX_LEN hex digits each; see       *
+ *       Log_Take()) and More = entries still waiting                        *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: The PC asks again until More is 0. (Not logged itself, or the log   *
+ *       would never empty.)                                                 *
+ *****************************************************************************/
+static void HandleLog( void )
+{
+  char szLogBuffer[40 + LOG_PER_REPLY * LOG_HEX_LEN];
+
+  sprintf_P( szLogBuffer, PSTR(PGM_S "[Lost:%u][D:"), LOG_OK_SIGNAL, Log_Lost() );
+  Log_Take( szLogBuffer + strlen(szLogBuffer), LOG_PER_REPLY );
+  sprintf_P( szLogBuffer + strlen(szLogBuffer), PSTR("][More:%u][]"), Log_Waiting() );
+  UART_Print( szLogBuffer );                               // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleStats                                                         *
+ * DESC: STATS signal: read "[P:n][]", and send that page of counters:       *
+ *         0: "<CO_STATS_OK>[Up:secs][Hz:n][Idle:n][Slice:us][Lrn:n]         *
+ *                            [EE:n][]"                                      *
+ *         1: "<CO_STATS_OK>[Ovr:n][In:n][Out:n][RF:n][]"                    *
+ *         2: "<CO_STATS_OK>[Cmd:us,us,...][]"                               *
+ *       where Hz = passes through loop() a second, Idle = thousandths of    *
+ *       that second spent asleep, Slice = longest any task has kept loop()  *
+ *       busy, Lrn = LEARN/LEARN_START signals, EE = EEPROM records written, *
+ *       Ovr = bytes lost because the receive ring was full, In/Out = bytes  *
+ *       received/sent, RF = ON/OFF code frames sent, and Cmd = the longest  *
+ *       each signal has taken to handle, in COMMANDS order (65535 = that or *
+ *       longer)                                                             *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: All since the sketch started. Split into pages so that each reply   *
+ *       fits in the PC's 128-byte response buffer; an unknown page is just  *
+ *       "<CO_STATS_OK>[]". The counters are always kept (a few instructions *
+ *       each), not just when PRJ_DEBUGGING is defined.                      *
+ *****************************************************************************/
+static void HandleStats( void )
+{
+  long             lPage   = 0;
+  char             szStatsBuffer[24 + NUM_COMMANDS * 6];
+  char            *pNext;
+  const NAMED_LONG List[]  = { {"[P:", &lPage} };
+
+  ReadNamedLongs( List, sizeof(List)/sizeof(List[0]) );
+
+  pNext = szStatsBuffer + sprintf_P( szStatsBuffer, PSTR(PGM_S), STATS_OK_SIGNAL );
+  if( lPage == 0 ) {
+    sprintf_P( pNext, PSTR("[Up:%lu][Hz:%lu][Idle:%u][Slice:%lu][Lrn:%u][EE:%lu][]"),
+                      millis() / 1000,
+                      ulLoopRate,
+                      uIdlePermille,
+                      ulWorstSliceUs,
+                      uLearnTries,
+                      JNL_Writes() );
+  }
+  else if( lPage == 1 ) {
+    sprintf_P( pNext, PSTR("[Ovr:%u][In:%lu][Out:%lu][RF:%lu][]"),
+                      UART_Overruns(),
+                      UART_BytesIn(),
+                      UART_BytesOut(),
+                      RCS_FramesSent() );
+  }
+  else if( lPage == 2 ) {
+    pNext += sprintf_P( pNext, PSTR("[Cmd:") );
+    for( byte i = 0; i < NUM_COMMANDS; i++ ) {
+      pNext += sprintf_P( pNext, i ? PSTR(",%u") : PSTR("%u"), CmdWorstUs[i] );
     }
+    strcpy_P( pNext, PSTR("][]") );
+  }
+  else {
+    strcpy_P( pNext, PSTR("[]") );
+  }
+  SendReply( szStatsBuffer );                              // Send response to PC
+}
 
-    receivedChars[0] = '\0';                               //   Truncate the latest input string
-    bNewData         = false;                              //   We no longer have an "active" input string
+
+/*****************************************************************************
+ * FUNC: SendCodeAndReply                                                    *
+ * DESC: Send the ON or OFF code to the remote outlet, and respond to the PC *
+ * ARGS: bOn = true for the ON code, false for the OFF code                  *
+ * RET:  [None]                                                              *
+ * NOTE: Normally the PC gets its reply straight away. With Loopback on for  *
+ *       the laptop's outlet (profile 0), the reply waits until the code has *
+ *       been sent (see ServiceTransmitter()), and says whether our own      *
+ *       receiver heard it:                                                  *
+ *         "<CO_ON_OK>[Seen:1][]"                                            *
+ *       Without Timer1 our receiver can't hear what we send, so the reply   *
+ *       comes straight away with no "Seen" (i.e. not known) either way.     *
+ *****************************************************************************/
+static void SendCodeAndReply( bool bOn )
+{
+  const char *szOKsignalP = bOn ? ON_OK_SIGNAL : OFF_OK_SIGNAL;
+  char        szReplyBuffer[25];
+
+  if( (Outlets[0].Loopback != 1) || !RCS_CanLoopback() ) { // Just sending the code?
+    SendReplyP( szOKsignalP );                             //  Yes, respond first (the PC watches the AC line for the result)
+    RCS_TxQueue( 0, bOn, TX_EVENT );                       //   then say when it's gone
+    return;
+  }
+
+  if( !RCS_TxQueue(0, bOn, TX_REPLY) ) {                   //  No, send it and listen for it (queue full? Say it wasn't
+    sprintf_P( szReplyBuffer, PSTR(PGM_S "[Seen:0][]"), szOKsignalP );
+                                                           //   heard, so the PC tries again)
+    SendReply( szReplyBuffer );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: ServiceTransmitter                                                  *
+ * DESC: Send the next frame of a queued ON/OFF code, and once it has all    *
+ *       gone out, do whatever was waiting for it (see TX_xxx)               *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void ServiceTransmitter( void )
+{
+  RCS_TXDONE Done;
+  char       szReplyBuffer[45];
+
+  if( !RCS_TxPoll(&Done) ) {                               // Anything finished?
+    return;                                                //  No
+  }
+
+  switch( Done.byTag ) {
+    case TX_EVENT:                                         // Just say it's gone
+      if( Done.bSent ) {
+        SendEvent( EVT_SENT, Done.bOn ? "[On:1]" : "[On:0]" );
+      }
+      break;
+
+    case TX_REPLY:                                         // PC is waiting to hear whether it went out
+      sprintf_P( szReplyBuffer, PSTR(PGM_S "[Seen:%d][]"), Done.bOn ? ON_OK_SIGNAL : OFF_OK_SIGNAL, Done.bSeen ? 1 : 0 );
+      SendReply( szReplyBuffer );
+      break;
+
+    case TX_BATCH:                                         // One of a BATCH
+      if( !Done.bSent ) {
+        nBatchSent &= ~(1 << Done.byIdx);
+      }
+      if( Done.bSeen ) {
+        nBatchSeen |= (1 << Done.byIdx);
+      }
+      if( byBatchPending && !--byBatchPending ) {          //  Last one? Tell the PC how it went
+        sprintf_P( szReplyBuffer, PSTR(PGM_S "[Sent:%d][Seen:%d][]"), BATCH_OK_SIGNAL, nBatchSent, nBatchSeen );
+        SendReply( szReplyBuffer );
+      }
+      break;
+
+    case TX_DEADMAN:                                       // Failsafe ON code
+      sprintf_P( szReplyBuffer, PSTR("[Trip:%ld]"), lDeadManTrips );
+      SendEvent( EVT_DEADMAN, szReplyBuffer );
+      break;
   }
 }
 
@@ -263,84 +832,467 @@ void loop( void )
  * ARGS: startMarker = Delimiter preceding the value                         *
  *       endMarker   = Delimiter following the value                         *
  * RET:  [None]                                                              *
+ * NOTE: Takes whatever has arrived and returns; a string that's only partly *
+ *       here is picked up where it left off on the next call. (It used to   *
+ *       start again from scratch each time, which is why a 200us delay per  *
+ *       byte was needed: it kept the loop from catching up with the bytes   *
+ *       still on the wire and throwing away the first half of the string.)  *
  *****************************************************************************/
 void ReadDelimitedString( const char startMarker, const char endMarker )
 {
-  boolean recvInProgress = false;
-  byte    ndx            = 0;
-  char    rc;
-
-  while( Serial.available() ) {                            // While data is waiting...
-    rc = Serial.read();                                    //  Read the next byte
-                                 /* KJB: Not sure why the following delay seems to be necessary? */
-                                 /* KJB: Without it, the received characters do not seem to "register" ... */
-    delayMicroseconds(200);
-    if( !recvInProgress && (rc != startMarker) ) {         //  Have we seen the start marker yet?
-      continue;                                            //   No, throw away the new byte
-    }
-    else {                                                 //   Yes...
-      receivedChars[ndx++] = rc;                           //    Append new byte to the input buffer
-      if( (rc == startMarker) && (ndx == 1) ) {            //    New byte IS the (first) start marker?
-        recvInProgress = true;                             //     Yes, we're now between the start marker and end marker
-      }
-      else if( (ndx == numChars) || (rc == endMarker) ) {  //     No, is buffer full, or is new byte the end marker?
-        receivedChars[ndx] = '\0';                         //      Yes, null-terminate the buffer
-        bNewData = true;                                   //       We now have a complete input string
-        break;                                             //       Exit the loop - we're done!
+  static bool recvInProgress = false;
+  static byte ndx            = 0;
+  static char cInProgress;                                 // Start marker of the string in progress
+  int         rc;
+
+  if( recvInProgress && (cInProgress != startMarker) ) {   // Was a different kind of string in progress?
+    recvInProgress = false;                                //  Yes, abandon it
+  }
+
+  while( (rc = UART_Read()) >= 0 ) {                       // While data is waiting, read the next byte
+    if( !recvInProgress ) {                                //  Have we seen the start marker yet?
+      if( rc == startMarker ) {                            //   No, is this it?
+        recvInProgress = true;                             //    Yes, we're now between the start marker and end marker
+        cInProgress    = startMarker;
+        ndx            = 0;
+        receivedChars[ndx++] = rc;
       }
+      continue;                                            //    (No, throw away the new byte)
+    }
+
+    receivedChars[ndx++] = rc;                             //   Yes, append new byte to the input buffer
+    if( (ndx == numChars-1) || (rc == endMarker) ) {       //   Is buffer full (leaving room for the null), or is new
+      receivedChars[ndx] = '\0';                           //    byte the end marker? Yes, null-terminate the buffer
+      recvInProgress     = false;
+      bNewData           = true;                           //    We now have a complete input string
+      break;                                               //    Exit the loop - we're done!
     }
   }  // while loop
 }
 
 
 /*****************************************************************************
- * FUNC: ReadSettings                                                        *
- * DESC: Read series of square-bracket-delimited Outlet Setting names/values *
- *       into a set of variables ... for use with the 433MHz transmitter     *
+ * FUNC: ReadField                                                           *
+ * DESC: Wait (briefly) for the next "[...]" following a signal              *
  * ARGS: [None]                                                              *
- * RET:  [None]                                                              *
+ * RET:  true  = Got one (in receivedChars)                                  *
+ *       false = Nothing arrived within FIELD_TIMEOUT_MS                     *
+ * NOTE: The PC sends a signal and its "[...]" all at once, so the rest is   *
+ *       normally just a few byte-times behind.                              *
  *****************************************************************************/
-void ReadSettings( void )
+static bool ReadField( void )
 {
+  unsigned long ulStartMs = millis();
+
+  bNewData = false;                                        // We don't have an "active" input string yet
   do {
-    bNewData = false;                                      // We don't have an "active" input string yet
-    ReadDelimitedString( '[', ']' );                       // Watch for next setting string
-    if( bNewData ) {                                       // Did we read the signal string successfully?
-/*
+    ReadDelimitedString( '[', ']' );
+  } while( !bNewData && (millis() - ulStartMs < FIELD_TIMEOUT_MS) );
+  return bNewData;
+}
+
+
+/*****************************************************************************
+ * FUNC: SendBatch                                                           *
+ * DESC: Read "[On:mask][Off:mask][]" and send the ON/OFF code to each outlet*
+ *       profile whose bit is set, then tell the PC which ones went out:     *
+ *         "<CO_BATCH_OK>[Sent:mask][Seen:mask][]"                           *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Bit n = profile n. ON wins if a bit is set in both masks. Profiles  *
+ *       that haven't been set up are skipped (and left out of "Sent").      *
+ *       "Seen" only includes profiles with Loopback on, and is always 0     *
+ *       without Timer1 (see RCS_CanLoopback()).                             *
+ *       The codes are queued; ServiceTransmitter() replies once they've all *
+ *       gone out.                                                           *
+ *****************************************************************************/
+static void SendBatch( void )
+{
+  long             lOnMask  = 0;
+  long             lOffMask = 0;
+  char             szBatchBuffer[45];
+  const NAMED_LONG List[]   = { {"[On:", &lOnMask}, {"[Off:", &lOffMask} };
+
+  ReadNamedLongs( List, sizeof(List)/sizeof(List[0]) );
+
+  if( byBatchPending == 0 ) {                              // (A BATCH that arrives before the last one has gone out is
+    nBatchSent = 0;                                        //  answered along with it)
+    nBatchSeen = 0;
+  }
+  for( byte byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {    // Queue the codes...
+    bool bOn  = (lOnMask  & (1L << byIdx)) != 0;
+    bool bOff = (lOffMask & (1L << byIdx)) != 0;
+
+    if( (bOn || bOff) && RCS_ProfileUsable(&Outlets[byIdx]) && RCS_TxQueue(byIdx, bOn, TX_BATCH) ) {
+      nBatchSent |= (1 << byIdx);
+      byBatchPending++;
+    }
+  }
+
+  if( byBatchPending == 0 ) {                              // ...or, if there aren't any, tell the PC so now
+    sprintf_P( szBatchBuffer, PSTR(PGM_S "[Sent:%d][Seen:%d][]"), BATCH_OK_SIGNAL, nBatchSent, nBatchSeen );
+    SendReply( szBatchBuffer );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: SendSettingsHash                                                    *
+ * DESC: Read "[N:n][]" and reply with a hash of outlet profiles 0..n-1:     *
+ *         "<CO_HASH_OK>[Hash:h][]"                                          *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Lets the PC check (after it wakes up, say) that we still have its   *
+ *       settings, without sending them all again.                           *
+ *****************************************************************************/
+static void SendSettingsHash( void )
+{
+  long             lCount = 1;
+  char             szHashBuffer[30];
+  const NAMED_LONG List[] = { {"[N:", &lCount} };
+
+  ReadNamedLongs( List, 1 );
+  if( (lCount < 1) || (lCount > MAX_OUTLETS) ) {
+    lCount = 1;
+  }
+  sprintf_P( szHashBuffer, PSTR(PGM_S "[Hash:%u][]"), HASH_OK_SIGNAL, SettingsHash((byte)lCount) );
+  SendReply( szHashBuffer );                               // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: ReadLimits                                                          *
+ * DESC: Read "[Min:n][Max:n][Dead:s][]" and let the control loop make the   *
+ *       MIN/MAX decisions from now on (or, with Dead = 0, stop it)          *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Once this is armed, the PC only sends battery samples. If they stop *
+ *       arriving for Dead seconds (ChargeOn.exe has hung, or been killed),  *
+ *       CheckDeadMan() turns the outlet ON so the laptop can't run flat.    *
+ *****************************************************************************/
+static void ReadLimits( void )
+{
+  long             lDeadSecs = 0;
+  const NAMED_LONG List[]    = { {"[Min:", &lCtlMin}, {"[Max:", &lCtlMax}, {"[Dead:", &lDeadSecs} };
+
+  ReadNamedLongs( List, sizeof(List)/sizeof(List[0]) );
+  ulDeadManMs    = (unsigned long)lDeadSecs * 1000UL;
+  ulLastSampleMs = millis();                               // Give the PC a full dead-man period to send the first sample
+  byCtlCommanded = CTL_NONE;
+
+  SendReplyP( LIMITS_OK_SIGNAL );                          // Send response to PC
+}
+
+
+/*****************************************************************************
+ * FUNC: TakeSample                                                          *
+ * DESC: Read "[P:pct][L:line][]" from the PC, and turn the outlet OFF at    *
+ *       MAX (while charging) or ON at MIN (while discharging); reply with   *
+ *         "<CO_SAMPLE_OK>[Act:a][Arm:n][Trip:n][]"                          *
+ *       where Act = 0 (nothing sent), 1 (ON code sent), 2 (OFF code sent),  *
+ *       Arm = 0 if ReadLimits() hasn't armed the control loop (the PC must  *
+ *       decide), and Trip = times the dead-man timer has gone off           *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: An unknown percentage (255) counts as "turn the outlet ON", as the  *
+ *       PC does. The reply is sent before the code, to keep the PC waiting  *
+ *       as short a time as possible.                                        *
+ *****************************************************************************/
+static void TakeSample( void )
+{
+  long             lPct    = 255;
+  long             lLine   = 255;
+  byte             byWant  = CTL_NONE;
+  char             szSampleBuffer[50];
+  const NAMED_LONG List[]  = { {"[P:", &lPct}, {"[L:", &lLine} };
+
+  ReadNamedLongs( List, sizeof(List)/sizeof(List[0]) );
+  ulLastSampleMs = millis();                               // The PC is still alive
+
+  if( ulDeadManMs ) {                                      // Are we making the decisions?
+    if( (lPct > 100) && (lLine != 1) ) {                   //  Yes, don't know the charge?
+      byWant = 1;                                          //   Yes, play safe
+    }
+    else if( (lLine == 1) && (lPct >= lCtlMax) ) {         //   Charged up to MAX?
+      byWant = 0;
+    }
+    else if( (lLine == 0) && (lPct <= lCtlMin) ) {         //   Discharged down to MIN?
+      byWant = 1;
+    }
+    if(    (byWant != CTL_NONE)                            //  Outlet needs switching, and we haven't just told it to?
+        && ((byWant != byCtlCommanded) || (millis() - ulCtlCmdMs >= CTL_RESEND_MS)) ) {
+      byCtlCommanded = byWant;
+      ulCtlCmdMs     = millis();
+    }
+    else {
+      byWant = CTL_NONE;
+    }
+  }
+
+  sprintf_P( szSampleBuffer, PSTR(PGM_S "[Act:%d][Arm:%d][Trip:%ld][]"),
+                             SAMPLE_OK_SIGNAL,
+                             (byWant == CTL_NONE) ? 0 : (byWant ? 1 : 2),
+                             ulDeadManMs ? 1 : 0,
+                             lDeadManTrips );
+  SendReply( szSampleBuffer );                             // Send response to PC
+  if( byWant != CTL_NONE ) {
+    RCS_TxQueue( 0, byWant == 1, TX_EVENT );               // Switch the laptop's outlet
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: CheckDeadMan                                                        *
+ * DESC: Turn the outlet ON if the PC has stopped sending battery samples    *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Keeps sending the ON code (once every dead-man period) until the    *
+ *       samples start again, in case the first one wasn't heard.            *
+ *****************************************************************************/
+static void CheckDeadMan( void )
+{
+  if( ulDeadManMs && (millis() - ulLastSampleMs >= ulDeadManMs) ) {
+    ulLastSampleMs = millis();
+    byCtlCommanded = 1;
+    ulCtlCmdMs     = ulLastSampleMs;
+    lDeadManTrips++;
+    LOG( LOG_DEADMAN, 0, lDeadManTrips );
+    RCS_TxQueue( 0, true, TX_DEADMAN );                    // (EVT_DEADMAN follows once it's gone out)
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: CheckLearning                                                       *
+ * DESC: While listening for a remote control (after LEARN_START), report    *
+ *       the code as soon as it's heard:                                     *
+ *         "<CO_EVT>[E:3][Code:n][Pro:n][PLen:n][VLen:n][]"                  *
+ *       or give up after RCS_LEARN_MS: "<CO_EVT>[E:4][Err:1][]"             *
+ *       After an old-style LEARN, reply instead:                            *
+ *         "<CO_LEARN_OK>[Code:n][Pro:n][PLen:n][VLen:n][]" (or "...OK>[]")  *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void CheckLearning( void )
+{
+  char szFields[60];
+  char szLearnCodeBuffer[75];
+
+  if( !bLearning ) {
+    return;
+  }
+  if( RCS_LearnPoll(&TempOutlet) ) {                       // Heard it?
+    sprintf_P( szFields, PSTR("[Code:%ld][Pro:%ld][PLen:%ld][VLen:%ld]"),
+                         TempOutlet.OnCode,
+                         TempOutlet.Protocol,
+                         TempOutlet.PulseLength,
+                         TempOutlet.ValueLength );
+  }
+  else if( millis() - ulLearnStartMs >= RCS_LEARN_MS ) {   // Given up?
+    szFields[0] = '\0';
+  }
+  else {
+    return;                                                // Keep listening
+  }
+
+  if( bLearnReply ) {
+    sprintf_P( szLearnCodeBuffer, PSTR(PGM_S "%s[]"), LEARN_OK_SIGNAL, szFields );
+    SendReply( szLearnCodeBuffer );
+  }
+  else if( szFields[0] ) {
+    SendEvent( EVT_LEARNED, szFields );
+  }
+  else {
+    sprintf_P( szFields, PSTR("[Err:%d]"), ERR_LEARN_TIMEOUT );
+    SendEvent( EVT_ERROR, szFields );
+  }
+  RCS_LearnStop();
+  bLearning = false;
+}
+
+
+/*****************************************************************************
+ * FUNC: SendEvent                                                           *
+ * DESC: Tell the PC something without being asked: "<CO_EVT>[E:n]...[]"    *
+ * ARGS: byEvent  = EVT_xxx                                                  *
+ *       szFields = Any "[Name:value]" fields that go with it                *
+ * RET:  [None]                                                              *
+ * NOTE: Only call between signals (never in the middle of a response).      *
+ *****************************************************************************/
+static void SendEvent( byte byEvent, const char *szFields )
+{
+  char szEventBuffer[80];
+
+  sprintf_P( szEventBuffer, PSTR(PGM_S "[E:%d]%s[]"), EVENT_SIGNAL, byEvent, szFields );
+  UART_Print( szEventBuffer );
+  LOG( LOG_EVENT_SENT, byEvent, 0 );
+}
+
+
+/*****************************************************************************
+ * FUNC: SendOKWithStatus                                                    *
+ * DESC: Send a response that also says how we're doing:                    *
+ *         "<CO_xxx_OK>[Up:secs][Gen:n][]"                                   *
+ * ARGS: szOKsignalP = The response (in flash)                               *
+ * RET:  [None]                                                              *
+ * NOTE: Uptime going backwards (or Gen going back to 0) tells the PC we've  *
+ *       restarted, without a separate exchange to ask.                      *
+ *****************************************************************************/
+static void SendOKWithStatus( const char *szOKsignalP )
+{
+  char szReplyBuffer[50];
+
+  sprintf_P( szReplyBuffer, PSTR(PGM_S "[Up:%lu][Gen:%u][]"), szOKsignalP, millis() / 1000UL, uSettingsGen );
+  SendReply( szReplyBuffer );
+}
+
+
+/*****************************************************************************
+ * FUNC: SendReply                                                           *
+ * DESC: Send a response to the PC (and log it)                              *
+ * ARGS: szReply = The response                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void SendReply( const char *szReply )
+{
+  UART_Print( szReply );
+  LOG( LOG_REPLIED, strlen(szReply), Log_Text4(szReply + 4) );
+}
+
+
+/*****************************************************************************
+ * FUNC: SendReplyP                                                          *
+ * DESC: Send a response that's in flash to the PC (and log it)              *
+ * ARGS: szReplyP = The response                                             *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void SendReplyP( const char *szReplyP )
+{
+  UART_PrintP( szReplyP );
 #ifdef DEBUGGING
-      SerialDebug.print( "  ReadSettings() - Received: " );
-      SerialDebug.println( receivedChars );
+  char szText[5];
+
+  strncpy_P( szText, szReplyP + 4, 4 );
+  szText[4] = '\0';
+  LOG( LOG_REPLIED, strlen_P(szReplyP), Log_Text4(szText) );
 #endif
-*/
-                                                           //  Yes, read the value into the appropriate variable
-      if( !strncmp(receivedChars, "[On:", 4) ) {
-        ReadLong( receivedChars+4, &Outlet.OnCode );
-      }
-      else if( !strncmp(receivedChars, "[Off:", 5) ) {
-        ReadLong( receivedChars+5, &Outlet.OffCode );
-      }
-      else if( !strncmp(receivedChars, "[Pro:", 5) ) {
-        ReadLong( receivedChars+5, &Outlet.Protocol );
-      }
-      else if( !strncmp(receivedChars, "[PLen:", 6) ) {
-        ReadLong( receivedChars+6, &Outlet.PulseLength );
-      }
-      else if( !strncmp(receivedChars, "[PReps:", 7) ) {
-        ReadLong( receivedChars+7, &Outlet.PulseRepeats );
+}
+
+
+/*****************************************************************************
+ * FUNC: ReadNamedLongs                                                      *
+ * DESC: Read the "[Name:value]...[]" that follows a signal                  *
+ * ARGS: pList   = Names to look for, and where to put their values          *
+ *       byCount = Number of entries in pList                                *
+ * RET:  [None]                                                              *
+ * NOTE: Unknown names are skipped, and missing ones left as they were.      *
+ *****************************************************************************/
+static void ReadNamedLongs( const NAMED_LONG *pList, byte byCount )
+{
+  while( ReadField() && strncmp(receivedChars, "[]", 2) ) {  // Loop until we encounter the "empty setting"
+    for( byte i = 0; i < byCount; i++ ) {
+      byte byLen = strlen( pList[i].szTag );
+
+      if( !strncmp(receivedChars, pList[i].szTag, byLen) ) {
+        ReadLong( receivedChars+byLen, pList[i].plValue );
+        break;
       }
-      else if( !strncmp(receivedChars, "[TOBQ:", 6) ) {
-        ReadLong( receivedChars+6, &Outlet.TurnOnBeforeQuit );
+    }
+  }
+  receivedChars[0] = '\0';                                 // Truncate the latest input string
+}
+
+
+/*****************************************************************************
+ * FUNC: SettingsHash                                                        *
+ * DESC: CRC-16 (CCITT, starting from 0xFFFF) of outlet profiles 0..n-1, as  *
+ *       they're laid out in memory (8 little-endian 4-byte values each)     *
+ * ARGS: byCount = Number of outlet profiles to include                      *
+ * RET:  The hash                                                            *
+ * NOTE: The PC works it out the same way from its own copy of the settings. *
+ *****************************************************************************/
+static unsigned int SettingsHash( byte byCount )
+{
+  const byte   *pByte = (const byte *)Outlets;
+  unsigned int  uCRC  = 0xFFFF;
+
+  for( unsigned int i = 0; i < byCount * sizeof(OUTLET); i++ ) {
+    uCRC ^= (unsigned int)pByte[i] << 8;
+    for( byte byBit = 0; byBit < 8; byBit++ ) {
+      uCRC = (uCRC & 0x8000) ? ((uCRC << 1) ^ 0x1021) : (uCRC << 1);
+    }
+  }
+  return uCRC & 0xFFFF;
+}
+
+
+/*****************************************************************************
+ * FUNC: ReadSettings                                                        *
+ * DESC: Read series of square-bracket-delimited Outlet Setting names/values *
+ *       into a set of variables ... for use with the 433MHz transmitter     *
+ * ARGS: pbyIdx    = Set to the outlet profile that was updated              *
+ *       pbChanged = Set to true if the profile is now different             *
+ * RET:  true  if the settings were read                                     *
+ *       false if "[Idx:n]" isn't an outlet profile (the rest of the fields  *
+ *             are read and thrown away, and no profile is changed)          *
+ * NOTE: "[Idx:n]" (if present) must come first; without it, the settings   *
+ *       are for profile 0 (the laptop's outlet). Settings that aren't       *
+ *       listed are left as they were, so the PC can send just the ones that *
+ *       changed. The caller saves the profile if anything did.              *
+ *****************************************************************************/
+bool ReadSettings( byte *pbyIdx, bool *pbChanged )
+{
+  byte    byIdx   = 0;
+  OUTLET *pOutlet = &Outlets[0];
+  OUTLET  Before  = Outlets[0];
+  OUTLET  Discard;
+  bool    bIdxOK  = true;
+  long    lIdx;
+
+  while( ReadField() && strncmp(receivedChars, "[]", 2) ) {  // Loop until we encounter the "empty setting"
+                                                           // Read the value into the appropriate variable
+    if( !strncmp(receivedChars, "[Idx:", 5) ) {
+      ReadLong( receivedChars+5, &lIdx );
+      if( (lIdx >= 0) && (lIdx < MAX_OUTLETS) ) {
+        byIdx   = (byte)lIdx;
+        pOutlet = &Outlets[byIdx];
+        Before  = *pOutlet;
       }
-      else if( !strncmp(receivedChars, "[VLen:", 6) ) {
-        ReadLong( receivedChars+6, &Outlet.ValueLength );
+      else {                                               //  (Not a profile we have: read the rest into Discard)
+        bIdxOK  = false;
+        pOutlet = &Discard;
       }
-
-      receivedChars[0] = '\0';                             //   Truncate the latest input string
     }
-  } while( bNewData && strncmp(receivedChars, "[]", 2) );  // Loop until we encounter the "empty setting"
+    else if( !strncmp(receivedChars, "[On:", 4) ) {
+      ReadLong( receivedChars+4, &pOutlet->OnCode );
+    }
+    else if( !strncmp(receivedChars, "[Off:", 5) ) {
+      ReadLong( receivedChars+5, &pOutlet->OffCode );
+    }
+    else if( !strncmp(receivedChars, "[Pro:", 5) ) {
+      ReadLong( receivedChars+5, &pOutlet->Protocol );
+    }
+    else if( !strncmp(receivedChars, "[PLen:", 6) ) {
+      ReadLong( receivedChars+6, &pOutlet->PulseLength );
+    }
+    else if( !strncmp(receivedChars, "[PReps:", 7) ) {
+      ReadLong( receivedChars+7, &pOutlet->PulseRepeats );
+    }
+    else if( !strncmp(receivedChars, "[TOBQ:", 6) ) {
+      ReadLong( receivedChars+6, &pOutlet->TurnOnBeforeQuit );
+    }
+    else if( !strncmp(receivedChars, "[VLen:", 6) ) {
+      ReadLong( receivedChars+6, &pOutlet->ValueLength );
+    }
+    else if( !strncmp(receivedChars, "[Loop:", 6) ) {
+      ReadLong( receivedChars+6, &pOutlet->Loopback );
+    }
+  }
+  receivedChars[0] = '\0';                                 // Truncate the latest input string
 
-  EEPROM.put( 0, Outlet );                                 // Update outlet settings in EEPROM (in case user "Hibernates"
-                                                           //  laptop while ChargeOn is running)
+  *pbyIdx    = byIdx;
+  *pbChanged = bIdxOK && (memcmp( &Before, pOutlet, sizeof(OUTLET) ) != 0);
+  return bIdxOK;
 }  // ReadSettings()
 
 
@@ -369,44 +1321,24 @@ void ReadLong( char *longStr, long *longVariable )
 }
 
 
+#ifdef DEBUGGING
 /*****************************************************************************
- * FUNC: LearnCode                                                           *
- * DESC: Learn code (and related info) from button press on outlet's remote  *
- *       control. Store info in variables ... to be sent to Win32 program    *
- *       "over the wire" later.                                              * 
- * ARGS: pOutlet = Address of OUTLET structure to populate                   *
- * RET:  true  if signal from outlet remote was detected                     *
- *       false otherwise                                                     *
+ * FUNC: LogOutletValues                                                     *
+ * DESC: Log the settings in an outlet profile                               *
+ * ARGS: byIdx = Outlet profile (0 = the laptop's outlet)                    *
+ * RET:  [None]                                                              *
  *****************************************************************************/
-bool LearnCode( OUTLET *pOutlet )
+static void LogOutletValues( byte byIdx )
 {
-  bool bRetVal = false;
-  
-  bRetVal = RCS_CheckForCode( pOutlet );
-  return bRetVal;
-}
+  const OUTLET *pOutlet = &Outlets[byIdx];
 
-
-#ifdef DEBUGGING
-/*****************************************************************************
- * FUNC: PrintOutletValues                                                   *
- * DESC: Print outlet-related values from a specified Outlet structure       *
- * ARGS: pOutlet   = Address of OUTLET structure to print values from        *
- *       szHeading = Describes source of printed values                      *
- * RET:  [None]                                                              *
- *****************************************************************************/
-static void PrintOutletValues( OUTLET *pOutlet, char *szHeading )
-{
-  SerialDebug.println( "  =====================" );
-  SerialDebug.print(   "  " );  SerialDebug.print( szHeading );  SerialDebug.println( " Values" );
-  SerialDebug.println( "  =====================" );
-  SerialDebug.print(   "                ON code = " );  SerialDebug.println( pOutlet->OnCode );
-  SerialDebug.print(   "               OFF code = " );  SerialDebug.println( pOutlet->OffCode );
-  SerialDebug.print(   "               Protocol = " );  SerialDebug.println( pOutlet->Protocol );
-  SerialDebug.print(   "           Pulse Length = " );  SerialDebug.println( pOutlet->PulseLength );
-  SerialDebug.print(   "          Pulse Repeats = " );  SerialDebug.println( pOutlet->PulseRepeats );
-  SerialDebug.print(   "    Turn On Before Quit = " );  SerialDebug.println( pOutlet->TurnOnBeforeQuit );
-  SerialDebug.print(   "           Value Length = " );  SerialDebug.println( pOutlet->ValueLength );
-  SerialDebug.println( "  =====================" );
+  LOG( LOG_OUTLET_ON,   byIdx, pOutlet->OnCode );
+  LOG( LOG_OUTLET_OFF,  byIdx, pOutlet->OffCode );
+  LOG( LOG_OUTLET_PLEN, byIdx, pOutlet->PulseLength );
+  LOG( LOG_OUTLET_RF,   byIdx,   ((long)(byte)pOutlet->Protocol     << 24)
+                               | ((long)(byte)pOutlet->PulseRepeats << 16)
+                               | ((long)(byte)pOutlet->ValueLength  <<  8)
+                               | ((pOutlet->Loopback == 1) ? 1 : 0)
+                               | (pOutlet->TurnOnBeforeQuit ? 2 : 0) );
 }
 #endif
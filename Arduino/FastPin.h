@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * FILE: FastPin.h                                                           *
+ * DESC: Direct port I/O for the sketch's fixed pins                         *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: FastPin<n> works out, when the sketch is compiled, which port and   *
+ *       bit Arduino pin n is on for the board chosen in Project.h, so that  *
+ *       e.g. FastPin<5>::High() becomes a single "sbi" instruction (2       *
+ *       cycles) instead of a digitalWrite() call (about 50 cycles).         *
+ *                                                                           *
+ *       Only the pins the sketch uses are mapped; using any other one is a  *
+ *       compile error. On other boards, FastPin<n> just calls pinMode() and *
+ *       digitalWrite().                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+ 
+#ifndef FASTPIN_H
+# define FASTPIN_H
+
+# include "Project.h"
+
+# if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega32U4__)
+#  define FASTPIN_DIRECT                                      // Known chip; drive the ports directly
+
+#  if defined(PRJ_BOARD_NANO) && !defined(__AVR_ATmega328P__)
+#   error "Project.h says Nano, but this isn't an ATmega328P"
+#  elif defined(PRJ_BOARD_PRO_MICRO) && !defined(__AVR_ATmega32U4__)
+#   error "Project.h says Pro Micro, but this isn't an ATmega32U4"
+#  elif !defined(PRJ_BOARD_NANO) && !defined(PRJ_BOARD_PRO_MICRO)
+#   error "Choose a board (PRJ_BOARD_xxx) in Project.h"
+#  endif
+# endif
+
+# ifdef FASTPIN_DIRECT
+
+  /* Defines */
+#  define FP_PORT_B  0x23                                     // Data-space address of each port's PINx register (DDRx
+#  define FP_PORT_C  0x26                                     //  follows at +1 and PORTx at +2); the same on both chips
+#  define FP_PORT_D  0x29
+#  define FP_PORT_E  0x2C
+
+  /* Pin maps (Arduino pin number -> port and bit) */
+ template<uint8_t PIN> struct FastPinMap;                     // (No general version: unmapped pins don't compile)
+
+#  define FP_MAP( pin, port, bit )  template<> struct FastPinMap<pin> { enum { PORT = port, BIT = bit }; }
+
+#  if defined(PRJ_BOARD_NANO)
+ FP_MAP( 2, FP_PORT_D, 2 );                                   // D2 = PD2 (receiver VCC)
+ FP_MAP( 3, FP_PORT_D, 3 );                                   // D3 = PD3 (receiver data, INT1)
+ FP_MAP( 4, FP_PORT_D, 4 );                                   // D4 = PD4 (transmitter GND)
+ FP_MAP( 5, FP_PORT_D, 5 );                                   // D5 = PD5 (transmitter VCC)
+ FP_MAP( 6, FP_PORT_D, 6 );                                   // D6 = PD6 (transmitter data)
+#  else
+ FP_MAP( 2, FP_PORT_D, 1 );                                   // D2 = PD1 (receiver VCC)
+ FP_MAP( 3, FP_PORT_D, 0 );                                   // D3 = PD0 (receiver data, INT0)
+ FP_MAP( 4, FP_PORT_D, 4 );                                   // D4 = PD4 (transmitter GND)
+ FP_MAP( 5, FP_PORT_C, 6 );                                   // D5 = PC6 (transmitter VCC)
+ FP_MAP( 6, FP_PORT_D, 7 );                                   // D6 = PD7 (transmitter data)
+#  endif
+
+#  undef FP_MAP
+
+  /* The pin itself */
+ template<uint8_t PIN>
+ struct FastPin {
+   static const uint8_t PINX = FastPinMap<PIN>::PORT;
+   static const uint8_t MASK = 1 << FastPinMap<PIN>::BIT;
+
+   static inline void Output( void ) { *(volatile uint8_t *)(PINX + 1) |=  MASK; }
+   static inline void Input(  void ) { *(volatile uint8_t *)(PINX + 1) &= ~MASK; }
+   static inline void High(   void ) { *(volatile uint8_t *)(PINX + 2) |=  MASK; }
+   static inline void Low(    void ) { *(volatile uint8_t *)(PINX + 2) &= ~MASK; }
+   static inline void Toggle( void ) { *(volatile uint8_t *)(PINX)      =  MASK; }  // (Writing 1 to PINx toggles PORTx)
+   static inline bool Read(   void ) { return (*(volatile uint8_t *)(PINX) & MASK) != 0; }
+ };
+
+# else   // #ifdef FASTPIN_DIRECT
+
+ template<uint8_t PIN>
+ struct FastPin {
+   static inline void Output( void ) { pinMode( PIN, OUTPUT ); }
+   static inline void Input(  void ) { pinMode( PIN, INPUT );  }
+   static inline void High(   void ) { digitalWrite( PIN, HIGH ); }
+   static inline void Low(    void ) { digitalWrite( PIN, LOW );  }
+   static inline void Toggle( void ) { digitalWrite( PIN, !digitalRead(PIN) ); }
+   static inline bool Read(   void ) { return digitalRead( PIN ) == HIGH; }
+ };
+
+# endif  // #ifdef FASTPIN_DIRECT
+
+#endif   // #ifndef FASTPIN_H
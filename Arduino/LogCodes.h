@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * FILE: LogCodes.h                                                          *
+ * DESC: Event codes for the myLog module                                    *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Shared with the Win32 ChargeOn program. The sketch only stores an   *
+ *       event's code and its two numbers; the text lives here, and the PC   *
+ *       puts them together when it fetches the log (<CO_LOG>).              *
+ *       Only add new events at the end, so an older sketch's log still      *
+ *       decodes.                                                            *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef LOGCODES_H
+# define LOGCODES_H
+
+  /* Module-specific defines */
+# define LA_NUM      0                                        // How to show an event's lArg: as a number,
+# define LA_TEXT4    1                                        //  as up to 4 characters (first one in the top byte),
+# define LA_BYTES4   2                                        //  or as 4 small numbers ("a/b/c/d", top byte first)
+
+  /* Events: X( code, how to show lArg, text ), where the text's "{b}" stands
+     for byArg and "{l}" for lArg */
+# define LOG_EVENTS( X )                                                                           \
+  X( LOG_BOOT,        LA_NUM,    "Started" )                                                       \
+  X( LOG_RECEIVED,    LA_TEXT4,  "Received signal <CO_{l}... ({b} characters)" )                   \
+  X( LOG_REPLIED,     LA_TEXT4,  "Sent reply <CO_{l}... ({b} characters)" )                        \
+  X( LOG_EVENT_SENT,  LA_NUM,    "Sent event {b}" )                                                \
+  X( LOG_OUTLET_ON,   LA_NUM,    "Profile {b}: ON code {l}" )                                      \
+  X( LOG_OUTLET_OFF,  LA_NUM,    "Profile {b}: OFF code {l}" )                                     \
+  X( LOG_OUTLET_PLEN, LA_NUM,    "Profile {b}: pulse length {l}us" )                               \
+  X( LOG_OUTLET_RF,   LA_BYTES4, "Profile {b}: protocol/repeats/bits/flags {l}" )                  \
+  X( LOG_SAVED,       LA_NUM,    "Profile {b} saved to EEPROM (1 = OK, 0 = failed): {l}" )         \
+  X( LOG_RX_READY,    LA_NUM,    "433MHz receiver on pin {b} (interrupt {l})" )                    \
+  X( LOG_RX_ON,       LA_NUM,    "Receiver on" )                                                   \
+  X( LOG_RX_OFF,      LA_NUM,    "Receiver off" )                                                  \
+  X( LOG_TX_DONE,     LA_NUM,    "Finished code {l} (1 = ON, 2 = heard, 4 = superseded): {b}" )    \
+  X( LOG_HEARD,       LA_NUM,    "Remote control heard: code {l} ({b} bits)" )                     \
+  X( LOG_DEADMAN,     LA_NUM,    "No samples from PC; turning outlet ON (trip {l})" )
+
+  /* Typedefs */
+# define LOG_CODE_ENUM( code, how, text )  code,
+ typedef enum { LOG_NONE,                                     // 0 = (Never logged)
+                LOG_EVENTS( LOG_CODE_ENUM )
+                LOG_CODE_COUNT
+              } LOG_CODE;
+
+#endif   // #ifndef LOGCODES_H
@@ -13,6 +13,9 @@
   /* Project-wide defines */
 # define PRJ_DEBUGGING          // When this is defined, each module can be configured for debugging separately
 
-# define PRJ_VERSION "0.8.07"
+# define PRJ_BOARD_NANO         // Board the sketch is built for (pin maps are in FastPin.h):
+//# define PRJ_BOARD_PRO_MICRO  //  Nano, or Pro Micro
+
+# define PRJ_VERSION "0.8.22"
 
 #endif  // #ifndef PROJECT_H
@@ -0,0 +1,223 @@
+/*****************************************************************************
+ * FILE: myJournal.cpp                                                       *
+ * DESC: Module to keep the outlet profiles in EEPROM                        *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Profiles aren't kept at fixed addresses any more. Each time one     *
+ *       changes, a record (profile number, sequence number, settings and a  *
+ *       CRC) is written to the next free slot, round and round the EEPROM,  *
+ *       so no cell is worn out by one profile being rewritten over and over *
+ *       again. At boot, the newest record with a good CRC wins for each     *
+ *       profile; a record that was only half written (power lost, say) is  *
+ *       simply ignored, and the one before it is used instead.              *
+ *                                                                           *
+ *       A slot holding a profile's newest record is never reused, so a      *
+ *       profile that hasn't changed for a long time isn't lost.             *
+ *                                                                           *
+ *       Outlets[] is the RAM copy; nothing is read from EEPROM after boot.  *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+  /*  Includes */
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <stddef.h>                                         // For offsetof()
+#include "Project.h"
+#include "myJournal.h"
+
+  /* Module-specific defines */
+#define NO_SLOT       255
+#define LEGACY_SLOTS  ((MAX_OUTLETS * sizeof(OUTLET) + sizeof(JNL_RECORD) - 1) / sizeof(JNL_RECORD))
+                                                            // Slots overlapping the old layout (profile n at
+                                                            //  n * sizeof(OUTLET)), which is copied on first boot
+
+  /* Typedefs */
+typedef struct {
+  byte          byMagic;                                    // JNL_MAGIC
+  byte          byIdx;                                      // Outlet profile
+  unsigned long ulSeq;                                      // One more than the record written before it
+  OUTLET        Outlet;                                     // The settings
+  uint16_t      uCRC;                                       // CRC-16 (CCITT) of everything above
+} JNL_RECORD;
+
+  /* Static variables */
+static byte          bySlots;                               // Records the EEPROM holds
+static byte          LiveSlot[MAX_OUTLETS];                 // Slot holding each profile's newest record (or NO_SLOT)
+static byte          byLastSlot;                            // Slot written most recently
+static unsigned long ulLastSeq   = 0;                       //  and the sequence number written there
+static unsigned long ulWrites    = 0;                       // Records written since boot
+
+  /* Static function prototypes */
+static uint16_t RecordCRC(  const JNL_RECORD *pRec );
+static bool     ReadRecord( byte bySlot, JNL_RECORD *pRec );
+static bool     SlotIsLive( byte bySlot );
+
+
+  /* Local functions */
+
+/*****************************************************************************
+ * FUNC: RecordCRC                                                           *
+ * DESC: Work out a record's CRC                                             *
+ * ARGS: pRec = The record                                                   *
+ * RET:  CRC-16 (CCITT) of everything but the CRC itself                     *
+ *****************************************************************************/
+static uint16_t RecordCRC( const JNL_RECORD *pRec )
+{
+  const byte *pbyData = (const byte *)pRec;
+  uint16_t    uCRC    = 0xFFFF;
+
+  for( byte i = 0; i < offsetof(JNL_RECORD, uCRC); i++ ) {
+    uCRC ^= (uint16_t)pbyData[i] << 8;
+    for( byte byBit = 0; byBit < 8; byBit++ ) {
+      uCRC = (uCRC & 0x8000) ? (uint16_t)((uCRC << 1) ^ 0x1021) : (uint16_t)(uCRC << 1);
+    }
+  }
+  return uCRC;
+}
+
+
+/*****************************************************************************
+ * FUNC: ReadRecord                                                          *
+ * DESC: Read the record in a slot, and check it                             *
+ * ARGS: bySlot = The slot                                                   *
+ *       pRec   = Where to put the record                                    *
+ * RET:  true = It's good, false = Blank, half-written or corrupted          *
+ *****************************************************************************/
+static bool ReadRecord( byte bySlot, JNL_RECORD *pRec )
+{
+  EEPROM.get( bySlot * sizeof(JNL_RECORD), *pRec );
+  return    (pRec->byMagic == JNL_MAGIC)
+         && (pRec->byIdx < MAX_OUTLETS)
+         && (pRec->uCRC == RecordCRC(pRec));
+}
+
+
+/*****************************************************************************
+ * FUNC: SlotIsLive                                                          *
+ * DESC: Is a slot holding some profile's newest record?                     *
+ * ARGS: bySlot = The slot                                                   *
+ * RET:  true = Yes (it mustn't be overwritten)                              *
+ *****************************************************************************/
+static bool SlotIsLive( byte bySlot )
+{
+  for( byte byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {
+    if( LiveSlot[byIdx] == bySlot ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+  /* Global functions */
+
+/*****************************************************************************
+ * FUNC: JNL_Load                                                            *
+ * DESC: Find the newest record for each profile, and load it                *
+ * ARGS: pOutlets = Where to put the profiles (MAX_OUTLETS of them)          *
+ * RET:  [None]                                                              *
+ * NOTE: Call once, from setup(), before JNL_Save().                         *
+ *       An EEPROM without any records is from before the journal (or has    *
+ *       never been written): the profiles are read from the old layout, and *
+ *       written to the journal straight away, starting beyond the old       *
+ *       layout so a power cut part-way through can't lose any of it.        *
+ *       A profile with no record left (only possible after such a power     *
+ *       cut) reads as erased EEPROM would, so RCS_ProfileUsable() refuses   *
+ *       it until the PC sends it again.                                     *
+ *****************************************************************************/
+void JNL_Load( OUTLET *pOutlets )
+{
+  JNL_RECORD    Rec;
+  unsigned long ulLiveSeq[MAX_OUTLETS];
+  byte          byIdx;
+
+  bySlots    = EEPROM.length() / sizeof(JNL_RECORD);       // (No AVR has more than 4K of EEPROM, so this is < NO_SLOT)
+  byLastSlot = NO_SLOT;
+  for( byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {
+    LiveSlot[byIdx] = NO_SLOT;
+  }
+
+  for( byte bySlot = 0; bySlot < bySlots; bySlot++ ) {
+    if( !ReadRecord(bySlot, &Rec) ) {
+      continue;
+    }
+    if( (LiveSlot[Rec.byIdx] == NO_SLOT) || (Rec.ulSeq > ulLiveSeq[Rec.byIdx]) ) {
+      LiveSlot[Rec.byIdx]  = bySlot;                        // Newest for this profile (so far)
+      ulLiveSeq[Rec.byIdx] = Rec.ulSeq;
+      pOutlets[Rec.byIdx]  = Rec.Outlet;
+    }
+    if( (byLastSlot == NO_SLOT) || (Rec.ulSeq > ulLastSeq) ) {
+      byLastSlot = bySlot;                                  // Newest of all (the next record goes after it)
+      ulLastSeq  = Rec.ulSeq;
+    }
+  }
+
+  if( byLastSlot == NO_SLOT ) {                             // No journal yet?
+    byLastSlot = LEGACY_SLOTS - 1;                          //  Yes, copy the old layout into it
+    for( byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {
+      EEPROM.get( byIdx * sizeof(OUTLET), pOutlets[byIdx] );
+    }
+    for( byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {
+      JNL_Save( byIdx, &pOutlets[byIdx] );
+    }
+    return;
+  }
+
+  for( byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {
+    if( LiveSlot[byIdx] == NO_SLOT ) {
+      memset( &pOutlets[byIdx], 0xFF, sizeof(OUTLET) );
+    }
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: JNL_Save                                                            *
+ * DESC: Write a new record for a profile                                    *
+ * ARGS: byIdx   = Outlet profile (0 = the laptop's outlet)                  *
+ *       pOutlet = Its settings                                              *
+ * RET:  true = Written (and read back correctly), false = Not               *
+ * NOTE: A slot that doesn't read back correctly is skipped, and the next    *
+ *       one tried (up to JNL_RETRIES of them); the previous record stays    *
+ *       in use until a new one has made it.                                 *
+ *****************************************************************************/
+bool JNL_Save( byte byIdx, const OUTLET *pOutlet )
+{
+  JNL_RECORD Rec;
+  JNL_RECORD Check;
+  byte       bySlot = byLastSlot;
+
+  memset( &Rec, 0, sizeof(Rec) );                           // (So any padding is the same every time)
+  Rec.byMagic = JNL_MAGIC;
+  Rec.byIdx   = byIdx;
+  Rec.ulSeq   = ulLastSeq + 1;
+  Rec.Outlet  = *pOutlet;
+  Rec.uCRC    = RecordCRC( &Rec );
+
+  for( byte byTry = 0; byTry < JNL_RETRIES; byTry++ ) {
+    do {                                                    // Next slot that isn't some profile's newest record
+      bySlot = (bySlot + 1) % bySlots;
+    } while( SlotIsLive(bySlot) );
+
+    EEPROM.put( bySlot * sizeof(JNL_RECORD), Rec );         // (The CRC goes in last, so a power cut part-way through
+    ulWrites++;                                             //  leaves a record that fails its check)
+    byLastSlot = bySlot;
+    if( ReadRecord(bySlot, &Check) && !memcmp(&Check, &Rec, sizeof(Rec)) ) {
+      LiveSlot[byIdx] = bySlot;
+      ulLastSeq       = Rec.ulSeq;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/*****************************************************************************
+ * FUNC: JNL_Writes                                                          *
+ * DESC: Count the records written since boot                                *
+ * ARGS: [None]                                                              *
+ * RET:  The count                                                           *
+ *****************************************************************************/
+unsigned long JNL_Writes( void )
+{
+  return ulWrites;
+}
@@ -0,0 +1,24 @@
+/*****************************************************************************
+ * FILE: myJournal.h                                                         *
+ * DESC: Header file for myJournal module                                    *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Provides prototypes for "global" functions                          *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef MYJOURNAL_H
+# define MYJOURNAL_H
+
+# include "myRCSwitch.h"                                      // For OUTLET and MAX_OUTLETS
+
+  /* Module-specific defines */
+# define JNL_MAGIC      0xC5                                  // First byte of every record (change it if JNL_RECORD changes)
+# define JNL_RETRIES    3                                     // Slots JNL_Save() tries before giving up on a write
+
+  /* Public function prototypes */
+ void          JNL_Load(   OUTLET *pOutlets );
+ bool          JNL_Save(   byte byIdx, const OUTLET *pOutlet );
+ unsigned long JNL_Writes( void );
+
+#endif   // #ifndef MYJOURNAL_H
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * FILE: myLog.cpp                                                           *
+ * DESC: Module to keep a log of what the sketch has been doing              *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Replaces the debugging messages that used to be bit-banged out of   *
+ *       a spare pin (SendOnlySoftwareSerial), which held everything up for  *
+ *       about 90us a character, right in the middle of answering the PC.   *
+ *       Logging an event now just stores its code (see LogCodes.h), two     *
+ *       numbers and the time in a ring buffer. The PC fetches the entries   *
+ *       with <CO_LOG> whenever it likes, and turns them into text itself.   *
+ *                                                                           *
+ *       The ring only exists when PRJ_DEBUGGING is defined; otherwise the   *
+ *       log is always empty.                                                *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+  /*  Includes */
+#include <Arduino.h>
+#include "Project.h"
+#include "myLog.h"
+
+  /* Typedefs */
+typedef struct {
+  unsigned long ulMs;                                       // millis() when it happened
+  byte          byCode;                                     // LOG_xxx
+  byte          byArg;                                      // What happened to what (see LogCodes.h)
+  long          lArg;
+} LOG_ENTRY;
+
+  /* Static variables */
+#ifdef PRJ_DEBUGGING
+static LOG_ENTRY    Ring[LOG_SIZE];
+static byte         byHead      = 0;                        // Next entry Log_Write() fills
+static byte         byCount     = 0;                        // Entries waiting for Log_Take()
+static unsigned int uLost       = 0;                        // Entries overwritten before the PC fetched them
+#endif
+
+
+  /* Global functions */
+
+/*****************************************************************************
+ * FUNC: Log_Write                                                           *
+ * DESC: Log an event                                                        *
+ * ARGS: byCode = LOG_xxx                                                    *
+ *       byArg  = Whatever LogCodes.h says goes with it                      *
+ *       lArg   = Ditto                                                      *
+ * RET:  [None]                                                              *
+ * NOTE: Don't call from an interrupt handler.                               *
+ *****************************************************************************/
+void Log_Write( byte byCode, byte byArg, long lArg )
+{
+#ifdef PRJ_DEBUGGING
+  LOG_ENTRY *pEntry = &Ring[byHead];
+
+  pEntry->ulMs   = millis();
+  pEntry->byCode = byCode;
+  pEntry->byArg  = byArg;
+  pEntry->lArg   = lArg;
+  byHead         = (byHead + 1) % LOG_SIZE;
+  if( byCount < LOG_SIZE ) {
+    byCount++;
+  }
+  else {
+    uLost++;                                                // (Overwrote the oldest)
+  }
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: Log_Text4                                                           *
+ * DESC: Pack the start of a string into an lArg (for LA_TEXT4 events)       *
+ * ARGS: szText = The string                                                 *
+ * RET:  Up to 4 characters, the first one in the top byte                   *
+ *****************************************************************************/
+long Log_Text4( const char *szText )
+{
+  unsigned long ulText = 0;
+
+  for( byte i = 0; i < 4; i++ ) {
+    ulText <<= 8;
+    if( *szText ) {
+      ulText |= (byte)*szText++;
+    }
+  }
+  return (long)ulText;
+}
+
+
+/*****************************************************************************
+ * FUNC: Log_Take                                                            *
+ * DESC: Take the oldest entries out of the log, as hex                      *
+ * ARGS: szHex = Buffer (at least byMax * LOG_HEX_LEN + 1 bytes)             *
+ *       byMax = Most entries to take                                        *
+ * RET:  Number of entries taken                                             *
+ * NOTE: Each entry is LOG_HEX_LEN hex digits: the time (8), the code (2),   *
+ *       byArg (2) and lArg (8).                                             *
+ *****************************************************************************/
+byte Log_Take( char *szHex, byte byMax )
+{
+  byte byTaken = 0;
+
+  szHex[0] = '\0';
+#ifdef PRJ_DEBUGGING
+  while( (byTaken < byMax) && byCount ) {
+    LOG_ENTRY *pEntry = &Ring[(byHead + LOG_SIZE - byCount) % LOG_SIZE];
+
+    sprintf_P( szHex, PSTR("%08lX%02X%02X%08lX"),
+                      pEntry->ulMs,
+                      pEntry->byCode,
+                      pEntry->byArg,
+                      (unsigned long)pEntry->lArg );
+    szHex += LOG_HEX_LEN;
+    byCount--;
+    byTaken++;
+  }
+#endif
+  return byTaken;
+}
+
+
+/*****************************************************************************
+ * FUNC: Log_Waiting                                                         *
+ * DESC: Count the entries still in the log                                  *
+ * ARGS: [None]                                                              *
+ * RET:  The count                                                           *
+ *****************************************************************************/
+byte Log_Waiting( void )
+{
+#ifdef PRJ_DEBUGGING
+  return byCount;
+#else
+  return 0;
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: Log_Lost                                                            *
+ * DESC: Count the entries overwritten before the PC could fetch them        *
+ * ARGS: [None]                                                              *
+ * RET:  The count (since the sketch started)                                *
+ *****************************************************************************/
+unsigned int Log_Lost( void )
+{
+#ifdef PRJ_DEBUGGING
+  return uLost;
+#else
+  return 0;
+#endif
+}
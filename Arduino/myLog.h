@@ -0,0 +1,28 @@
+/*****************************************************************************
+ * FILE: myLog.h                                                             *
+ * DESC: Header file for myLog module                                        *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Provides prototypes for "global" functions                          *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef MYLOG_H
+# define MYLOG_H
+
+# include "LogCodes.h"
+
+  /* Module-specific defines */
+# define LOG_SIZE        24                                   // Entries kept (the oldest is overwritten first)
+# define LOG_PER_REPLY    3                                   // Entries per "<CO_LOG_OK>" reply (so it fits in the PC's
+                                                              //  128-byte response buffer)
+# define LOG_HEX_LEN     20                                   // Characters per entry in a reply (see Log_Take())
+
+  /* Public function prototypes */
+ void         Log_Write(   byte byCode, byte byArg, long lArg );
+ long         Log_Text4(   const char *szText );
+ byte         Log_Take(    char *szHex, byte byMax );
+ byte         Log_Waiting( void );
+ unsigned int Log_Lost(    void );
+
+#endif   // #ifndef MYLOG_H
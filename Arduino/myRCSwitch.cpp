@@ -3,6 +3,13 @@
  * DESC: Module to control 433MHz remote outlet                              *
  * AUTH: Kerry Burton                                                        *
  * INFO: Sends RF signals to a remote outlet to turn it ON and OFF           *
+ *                                                                           *
+ *       Codes are queued, and played in the background by Timer1's compare- *
+ *       match interrupt from a list of high/low durations worked out before *
+ *       the first frame, so loop() carries on while they go out. (Boards    *
+ *       without Timer1 fall back to RCSwitch's send(), one frame per call   *
+ *       to RCS_TxPoll().) A newer code for the same outlet supersedes an    *
+ *       older one (e.g. OFF arriving while ON is still being sent).         *
  *****************************************************************************
  * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
  *****************************************************************************/
@@ -11,10 +18,18 @@
 #include "ChargeOn.h"
 #include "RCSwitch.h"
 #include "myRCSwitch.h"
+#include "FastPin.h"
+#include "myLog.h"
 
   /* Module-specific defines */
 #if defined(PRJ_DEBUGGING) && defined(MYRCS_DEBUGGING)      // Is debugging enabled for the whole project and for this module?
 # define DEBUGGING                                          //  Yes, include DEBUGGING sections of this module in the compilation
+#endif
+
+#ifdef DEBUGGING
+# define LOG( byCode, byArg, lArg )  Log_Write( byCode, byArg, lArg )
+#else                                                       // Log an event (see LogCodes.h), or not
+# define LOG( byCode, byArg, lArg )
 #endif
     /* Arduino pin numbers for 433MHz receiver */
 //#define RCS_RX_GND_PIN --                                   // [We're using the actual GND pin, so no #define needed]
@@ -26,11 +41,151 @@
 #define RCS_TX_VCC_PIN 5                                    // "Virtual VCC" pin
 #define RCS_TX_DAT_PIN 6                                    // Output data pin
 
+    /* The same, for direct port I/O (see FastPin.h) */
+typedef FastPin<RCS_RX_VCC_PIN> RxVccPin;
+typedef FastPin<RCS_TX_GND_PIN> TxGndPin;
+typedef FastPin<RCS_TX_VCC_PIN> TxVccPin;
+typedef FastPin<RCS_TX_DAT_PIN> TxDatPin;
+
+#if defined(__AVR__) && defined(TIMER1_COMPA_vect)          // Have Timer1 (Nano, Pro Micro)?
+# define RCS_TIMER_TX                                       //  Yes, play the waveform from its compare-match interrupt
+# include <avr/interrupt.h>                                 //   (so nothing else, e.g. the Servo library, may use Timer1)
+#endif
+#define RCS_TICKS_PER_US  (F_CPU / 8000000UL)               // Timer1 ticks per microsecond (prescaler = 8)
+#define RCS_SYM_ZERO      0                                 // Symbols in a frame (index into RCS_WAVE.Ticks[], times 2)
+#define RCS_SYM_ONE       1
+#define RCS_SYM_SYNC      2
+
+  /* Typedefs */
+typedef struct {                                            // A queued transmission
+  byte byIdx;                                               //  Outlet profile
+  byte byTag;                                               //  Caller's tag (handed back by RCS_TxPoll())
+  bool bOn;                                                 //  ON code (or OFF)
+  bool bStarted;                                            //  Transmitter is on, and frames are going out
+  bool bCancelled;                                          //  Superseded by a newer code for the same outlet
+  bool bSeen;                                               //  Receiver has heard the code (Loopback only)
+  long lCode;                                               //  Code being sent (taken from the profile when it starts)
+  long lValueLength;
+  long lFramesLeft;                                         //  Frames (PulseRepeats) still to send
+} TXJOB;
+
+typedef struct {                                            // One of RCSwitch's protocols (same numbering: 1 = first)
+  unsigned int uPulseLength;                                //  Default pulse length (us)
+  byte         Sync[2];                                     //  High/low durations, in pulse lengths
+  byte         Zero[2];
+  byte         One[2];
+  bool         bInverted;                                   //  Low/high instead
+} RCS_PROTOCOL;
+
+typedef struct {                                            // A code, ready for Timer1 to play (see EncodeWave())
+  unsigned int  Ticks[6];                                   //  OCR1A for the high and low halves of a 0, a 1 and the sync
+  unsigned long ulBits;                                     //  The code
+  unsigned long ulFirstBit;                                 //  Its most significant bit (0 = no bits, just the sync)
+  bool          bInverted;                                  //  Halves are low/high instead
+} RCS_WAVE;
+
+typedef void (*WAVE_ENCODER)( const OUTLET *pOutlet, long lCode, RCS_WAVE *pWave );
+
   /* Global variables */
-OUTLET Outlet = {0, 0, 0, 0, 0, 0, 0};                      // Global settings for the remote outlet
+OUTLET Outlets[MAX_OUTLETS];                                // Settings for each remote outlet (profile 0 = the laptop's)
 
   /* Static variables */
 static RCSwitch mySwitch = RCSwitch();
+static TXJOB    TxQueue[RCS_TX_QUEUE];                      // Transmissions waiting (TxQueue[0] is the one going out)
+static byte     byTxCount       = 0;
+static bool     bTxListening    = false;                    // Receiver is on for TxQueue[0]'s Loopback
+static bool     bLearnListening = false;                    // Receiver is on for RCS_LearnStart()
+static volatile unsigned long ulFramesSent = 0;             // ON/OFF code frames sent since boot (see RCS_FramesSent())
+
+#ifdef RCS_TIMER_TX
+static constexpr RCS_PROTOCOL Protocols[] = {               // As in RCSwitch.cpp
+  { 350, {   1, 31 }, {  1,  3 }, {  3,  1 }, false },      //  1
+  { 650, {   1, 10 }, {  1,  2 }, {  2,  1 }, false },      //  2
+  { 100, {  30, 71 }, {  4, 11 }, {  9,  6 }, false },      //  3
+  { 380, {   1,  6 }, {  1,  3 }, {  3,  1 }, false },      //  4
+  { 500, {   6, 14 }, {  1,  2 }, {  2,  1 }, false },      //  5
+  { 450, {  23,  1 }, {  1,  2 }, {  2,  1 }, true  },      //  6 (HT6P20B)
+  { 150, {   2, 62 }, {  1,  6 }, {  6,  1 }, false },      //  7 (HS2303-PT)
+  { 200, {   3,130 }, {  7, 16 }, {  3, 16 }, false },      //  8 (Conrad RS-200 RX)
+  { 200, { 130,  7 }, { 16,  7 }, { 16,  3 }, true  },      //  9 (Conrad RS-200 TX)
+  { 365, {  18,  1 }, {  3,  1 }, {  1,  3 }, true  },      // 10 (1ByOne doorbell)
+  { 270, {  36,  1 }, {  1,  2 }, {  2,  1 }, true  },      // 11 (HT12E)
+  { 320, {  36,  1 }, {  1,  2 }, {  2,  1 }, true  }       // 12 (SM5212)
+};
+
+static RCS_WAVE              Waves[MAX_OUTLETS][2];         // Each profile's OFF [0] and ON [1] code, ready to play
+static RCS_WAVE              TxWave;                        // The one playing (a copy, as SETTINGS may rebuild Waves[])
+static unsigned long         ulTxBit;                       //  Bit being played (0 = the sync)
+static byte                  byTxSymbol;                    //  RCS_SYM_xxx
+static bool                  bTxSecondHalf;                 //  Playing the second half of it
+static volatile unsigned int uTxFramesLeft;                 //  Frames still to play (this one included)
+static volatile bool         bTxPlaying      = false;       //  Timer1 is running
+#endif
+
+  /* Static function prototypes */
+static void RCReceiverEnable(  void );
+static void RCReceiverDisable( void );
+static void StartJob(          TXJOB *pJob );
+static void FinishJob(         TXJOB *pJob, RCS_TXDONE *pDone );
+#ifdef RCS_TIMER_TX
+static void StartWaveform(     const RCS_WAVE *pWave, long lFrames );
+static inline unsigned int StepTicks( byte byPulses, unsigned long ulPulseTicks );
+template<byte PROTO>
+static void EncodeWave(        const OUTLET *pOutlet, long lCode, RCS_WAVE *pWave );
+
+static const WAVE_ENCODER Encoders[] = {                    // EncodeWave<n>() for protocol n
+  EncodeWave<1>, EncodeWave<2>, EncodeWave<3>,  EncodeWave<4>,  EncodeWave<5>,  EncodeWave<6>,
+  EncodeWave<7>, EncodeWave<8>, EncodeWave<9>, EncodeWave<10>, EncodeWave<11>, EncodeWave<12>
+};
+static_assert( sizeof(Encoders)/sizeof(Encoders[0]) == sizeof(Protocols)/sizeof(Protocols[0]),
+               "Need an EncodeWave<n> for every protocol" );
+#endif
+
+  /* Interrupt handlers */
+#ifdef RCS_TIMER_TX
+
+/*****************************************************************************
+ * FUNC: TIMER1_COMPA_vect                                                   *
+ * DESC: The half-symbol being played has run its time: start the next one  *
+ * NOTE: Each half is timed by the hardware from the compare match, so the   *
+ *       widths don't depend on how long this takes (only the edge, by the   *
+ *       few cycles it takes to get here).                                   *
+ *****************************************************************************/
+ISR( TIMER1_COMPA_vect )
+{
+  if( !bTxSecondHalf ) {                                    // Played the first half of the symbol?
+    bTxSecondHalf = true;                                   //  Yes, now the second
+  }
+  else {                                                    //  No, on to the next symbol
+    bTxSecondHalf = false;
+    if( ulTxBit ) {                                         //   Next bit (or, after bit 0, the sync)
+      ulTxBit >>= 1;
+    }
+    else {                                                  //   End of the frame
+      ulFramesSent++;
+      if( --uTxFramesLeft == 0 ) {                          //    Was it the last one?
+        TxDatPin::Low();                                    //     Yes, leave the data pin LOW, and stop
+        TIMSK1   &= ~_BV(OCIE1A);
+        TCCR1B    = 0;
+        bTxPlaying = false;
+        return;
+      }
+      ulTxBit = TxWave.ulFirstBit;                          //     No, start the next one
+    }
+    byTxSymbol = !ulTxBit ? RCS_SYM_SYNC : ((TxWave.ulBits & ulTxBit) ? RCS_SYM_ONE : RCS_SYM_ZERO);
+  }
+
+  if( bTxSecondHalf == TxWave.bInverted ) {                 // First half is high (second, if inverted)
+    TxDatPin::High();
+  }
+  else {
+    TxDatPin::Low();
+  }
+  OCR1A = TxWave.Ticks[byTxSymbol * 2 + bTxSecondHalf];
+}
+
+#endif   // #ifdef RCS_TIMER_TX
+
 
   /* Local functions */
 
@@ -41,13 +196,21 @@ static RCSwitch mySwitch = RCSwitch();
  * RET:  [None]                                                              *
  *****************************************************************************/
 void RCTransmitterSetup( void ) {
-  pinMode( RCS_TX_GND_PIN, OUTPUT );                        // Establish "virtual GND" for 433MHz transmitter
-  digitalWrite( RCS_TX_GND_PIN, LOW );
-  pinMode( RCS_TX_VCC_PIN, OUTPUT );                        // Establish "virtual VCC" for 433MHz transmitter
+  TxGndPin::Output();                                       // Establish "virtual GND" for 433MHz transmitter
+  TxGndPin::Low();
+  TxVccPin::Output();                                       // Establish "virtual VCC" for 433MHz transmitter
+#ifdef RCS_TIMER_TX
+  for( byte byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {     // Work out each outlet's ON and OFF waveforms now, so
+    const OUTLET *pOutlet = &Outlets[byIdx];                //  sending one only has to play it
+    WAVE_ENCODER  pfnEncode = Encoders[0];                  //  (Unknown protocol means protocol 1, as in RCSwitch)
 
-  mySwitch.setProtocol(       Outlet.Protocol );            // Set protocol; default is 1, will work for most outlets
-  mySwitch.setPulseLength(    Outlet.PulseLength );         // Set pulse length
-  mySwitch.setRepeatTransmit( Outlet.PulseRepeats );        // Set number of transmission repetitions
+    if( (pOutlet->Protocol >= 1) && (pOutlet->Protocol <= (long)(sizeof(Encoders)/sizeof(Encoders[0]))) ) {
+      pfnEncode = Encoders[pOutlet->Protocol - 1];
+    }
+    pfnEncode( pOutlet, pOutlet->OffCode, &Waves[byIdx][0] );
+    pfnEncode( pOutlet, pOutlet->OnCode,  &Waves[byIdx][1] );
+  }
+#endif
 }
 
 
@@ -58,15 +221,9 @@ void RCTransmitterSetup( void ) {
  * RET:  [None]                                                              *
  *****************************************************************************/
 static void RCTransmitterEnable( void ) {
-  digitalWrite( RCS_TX_VCC_PIN, HIGH );
+  TxVccPin::High();
   mySwitch.enableTransmit( RCS_TX_DAT_PIN );                // Assign output pin for transmitter data connection
 //  delay( 30 );
-#ifdef DEBUGGING
-/*
-SerialDebug.print( "433MHz transmission enabled on pin ");
-SerialDebug.println( RCS_TX_DAT_PIN );
-*/
-#endif
 }
 
 
@@ -78,40 +235,284 @@ SerialDebug.println( RCS_TX_DAT_PIN );
  *****************************************************************************/
 static void RCTransmitterDisable( void ) {
   mySwitch.disableTransmit();
-  digitalWrite( RCS_TX_VCC_PIN, LOW );
+  TxVccPin::Low();
 }
 
 
 /*****************************************************************************
- * FUNC: RCS_SendOnCode                                                      *
- * DESC: Tell remote 120VAC outlet to turn ON                                *
- * ARGS: [None]                                                              *
+ * FUNC: StartJob                                                            *
+ * DESC: Get ready to send a queued code (the first frame goes out next)     *
+ * ARGS: pJob = Address of the transmission (TxQueue[0])                     *
  * RET:  [None]                                                              *
  *****************************************************************************/
-void RCS_SendOnCode( void ) {
+static void StartJob( TXJOB *pJob ) {
+  const OUTLET *pOutlet = &Outlets[pJob->byIdx];
+
+  pJob->bStarted     = true;
+  pJob->lCode        = pJob->bOn ? pOutlet->OnCode : pOutlet->OffCode;
+  pJob->lValueLength = pOutlet->ValueLength;
+  pJob->lFramesLeft  = pOutlet->PulseRepeats;
+
+#ifndef RCS_TIMER_TX
+  mySwitch.setProtocol(       pOutlet->Protocol );          // Set protocol; default is 1, will work for most outlets
+  mySwitch.setPulseLength(    pOutlet->PulseLength );       // Set pulse length
+  mySwitch.setRepeatTransmit( 1 );                          // One frame per RCS_TxPoll()
+#endif
+
+  if( (pOutlet->Loopback == 1) && RCS_CanLoopback() ) {    // Checking that the code goes out on the air?
+    if( !bLearnListening ) {                                //  Yes, start listening first
+      RCReceiverEnable();
+    }
+    mySwitch.resetAvailable();
+    bTxListening = true;
+  }
   RCTransmitterEnable();
-  mySwitch.send( Outlet.OnCode, Outlet.ValueLength );
-  RCTransmitterDisable();
-#ifdef DEBUGGING
-  SerialDebug.print( "  Sent ON code to outlet: " );
-  SerialDebug.println( Outlet.OnCode );
+#ifdef RCS_TIMER_TX
+  if( pJob->lFramesLeft > 0 ) {
+    StartWaveform( &Waves[pJob->byIdx][pJob->bOn ? 1 : 0], pJob->lFramesLeft );
+  }
 #endif
 }
 
 
+#ifdef RCS_TIMER_TX
 /*****************************************************************************
- * FUNC: RCS_SendOffCode                                                     *
- * DESC: Tell remote 120VAC outlet to turn OFF                               *
- * ARGS: [None]                                                              *
+ * FUNC: EncodeWave                                                          *
+ * DESC: Turn an outlet's code into a waveform for Timer1 to play            *
+ * ARGS: PROTO   = Protocol (1..12; one copy of this function for each)      *
+ *       pOutlet = Address of the outlet's settings (pulse and code length)  *
+ *       lCode   = The code (OnCode or OffCode)                              *
+ *       pWave   = Where to put the waveform                                 *
  * RET:  [None]                                                              *
+ * NOTE: Same waveform as RCSwitch::send(): the bits, most significant       *
+ *       first, then the sync pulse. The protocol's pulse counts are         *
+ *       constants here, so only the pulse length is worked out at runtime.  *
  *****************************************************************************/
-void RCS_SendOffCode( void ) {
-  RCTransmitterEnable();
-  mySwitch.send( Outlet.OffCode, Outlet.ValueLength );
-  RCTransmitterDisable();
-#ifdef DEBUGGING
-  SerialDebug.print( "  Sent OFF code to outlet: " );
-  SerialDebug.println( Outlet.OffCode );
+template<byte PROTO>
+static void EncodeWave( const OUTLET *pOutlet, long lCode, RCS_WAVE *pWave ) {
+  constexpr const RCS_PROTOCOL &Proto = Protocols[PROTO - 1];
+  unsigned long ulPulseTicks = ((pOutlet->PulseLength > 0) ? (unsigned long)pOutlet->PulseLength : Proto.uPulseLength)
+                               * RCS_TICKS_PER_US;
+  long          lBits        = pOutlet->ValueLength;
+
+  pWave->Ticks[RCS_SYM_ZERO*2]   = StepTicks( Proto.Zero[0], ulPulseTicks );
+  pWave->Ticks[RCS_SYM_ZERO*2+1] = StepTicks( Proto.Zero[1], ulPulseTicks );
+  pWave->Ticks[RCS_SYM_ONE*2]    = StepTicks( Proto.One[0],  ulPulseTicks );
+  pWave->Ticks[RCS_SYM_ONE*2+1]  = StepTicks( Proto.One[1],  ulPulseTicks );
+  pWave->Ticks[RCS_SYM_SYNC*2]   = StepTicks( Proto.Sync[0], ulPulseTicks );
+  pWave->Ticks[RCS_SYM_SYNC*2+1] = StepTicks( Proto.Sync[1], ulPulseTicks );
+  pWave->bInverted               = Proto.bInverted;
+  pWave->ulBits                  = (unsigned long)lCode;
+  if( lBits > 32 ) {
+    lBits = 32;
+  }
+  pWave->ulFirstBit = (lBits > 0) ? (1UL << (lBits - 1)) : 0;
+}
+
+
+/*****************************************************************************
+ * FUNC: StepTicks                                                           *
+ * DESC: Work out the OCR1A value for half a symbol                          *
+ * ARGS: byPulses     = Length of the half, in pulse lengths                 *
+ *       ulPulseTicks = Pulse length, in Timer1 ticks                        *
+ * RET:  Ticks - 1 (Timer1 counts 0..OCR1A), at most 0xFFFF (32.7ms)         *
+ *****************************************************************************/
+static inline unsigned int StepTicks( byte byPulses, unsigned long ulPulseTicks ) {
+  unsigned long ulTicks = byPulses * ulPulseTicks;
+
+  if( ulTicks == 0 ) {
+    return 0;
+  }
+  return (ulTicks > 0x10000UL) ? 0xFFFF : (unsigned int)(ulTicks - 1);
+}
+
+
+/*****************************************************************************
+ * FUNC: StartWaveform                                                       *
+ * DESC: Start Timer1 playing a waveform                                     *
+ * ARGS: pWave   = Address of the waveform (from EncodeWave())               *
+ *       lFrames = How many times to play it                                 *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void StartWaveform( const RCS_WAVE *pWave, long lFrames ) {
+  TxWave        = *pWave;                                   // (Timer1 is stopped, so the interrupt isn't looking)
+  ulTxBit       = TxWave.ulFirstBit;
+  byTxSymbol    = !ulTxBit ? RCS_SYM_SYNC : ((TxWave.ulBits & ulTxBit) ? RCS_SYM_ONE : RCS_SYM_ZERO);
+  bTxSecondHalf = false;
+  uTxFramesLeft = (lFrames > 0xFFFF) ? 0xFFFF : (unsigned int)lFrames;
+  bTxPlaying    = true;
+
+  noInterrupts();
+  if( TxWave.bInverted ) {                                  // First half of the first symbol (the interrupt plays the rest)
+    TxDatPin::Low();
+  }
+  else {
+    TxDatPin::High();
+  }
+  TCCR1A  = 0;                                              // Timer1: CTC mode (count up to OCR1A), clock / 8
+  TCNT1   = 0;
+  OCR1A   = TxWave.Ticks[byTxSymbol * 2];
+  TIFR1   = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+  TCCR1B  = _BV(WGM12) | _BV(CS11);
+  interrupts();
+}
+#endif   // #ifdef RCS_TIMER_TX
+
+
+/*****************************************************************************
+ * FUNC: FinishJob                                                           *
+ * DESC: Turn the transmitter (and receiver) off, and take a transmission    *
+ *       off the queue                                                       *
+ * ARGS: pJob  = Address of the transmission (TxQueue[0])                    *
+ *       pDone = Where to say how it went                                    *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void FinishJob( TXJOB *pJob, RCS_TXDONE *pDone ) {
+  if( pJob->bStarted ) {
+    RCTransmitterDisable();
+  }
+  if( bTxListening ) {
+    bTxListening = false;
+    if( !bLearnListening ) {
+      RCReceiverDisable();
+    }
+  }
+  if( bLearnListening ) {                                   // (Don't "learn" the code we've just sent)
+    mySwitch.resetAvailable();
+  }
+  LOG( LOG_TX_DONE, (pJob->bOn ? 1 : 0) | (pJob->bSeen ? 2 : 0) | (pJob->bCancelled ? 4 : 0), pJob->lCode );
+
+  pDone->byTag = pJob->byTag;
+  pDone->byIdx = pJob->byIdx;
+  pDone->bOn   = pJob->bOn;
+  pDone->bSent = pJob->bStarted;
+  pDone->bSeen = pJob->bSeen;
+
+  byTxCount--;
+  memmove( &TxQueue[0], &TxQueue[1], byTxCount * sizeof(TXJOB) );
+}
+
+
+/*****************************************************************************
+ * FUNC: RCS_TxQueue                                                         *
+ * DESC: Queue the ON or OFF code for a remote 120VAC outlet, listening for  *
+ *       it with our own receiver if the outlet's Loopback is turned on      *
+ * ARGS: byIdx = Outlet profile                                              *
+ *       bOn   = true to send the ON code, false to send the OFF code        *
+ *       byTag = Handed back by RCS_TxPoll() when it's been sent             *
+ * RET:  true  if it was queued                                              *
+ *       false if the queue is full                                          *
+ * NOTE: Any code still waiting (or going out) for the same outlet is        *
+ *       superseded: it finishes at the next RCS_TxPoll().                   *
+ *****************************************************************************/
+bool RCS_TxQueue( byte byIdx, bool bOn, byte byTag ) {
+  TXJOB *pJob;
+
+  for( byte i = 0; i < byTxCount; i++ ) {
+    if( TxQueue[i].byIdx == byIdx ) {
+      TxQueue[i].bCancelled = true;
+    }
+  }
+  if( byTxCount == RCS_TX_QUEUE ) {
+    return false;
+  }
+
+  pJob = &TxQueue[byTxCount++];
+  memset( pJob, 0, sizeof(*pJob) );
+  pJob->byIdx = byIdx;
+  pJob->byTag = byTag;
+  pJob->bOn   = bOn;
+  return true;
+}
+
+
+/*****************************************************************************
+ * FUNC: RCS_TxPoll                                                          *
+ * DESC: Keep the code going out, and notice when it's finished              *
+ * ARGS: pDone = Where to say how it went, when it's finished                *
+ * RET:  true  if a transmission has just finished (see *pDone)              *
+ *       false otherwise (nothing queued, or more frames still to send)      *
+ * NOTE: With Timer1 this only looks; the frames play in the background.     *
+ *       Without it, each call sends one frame with RCSwitch, which takes    *
+ *       e.g. 45ms for a 24-bit code with protocol 1 and a 350us pulse       *
+ *       length. RCSwitch::send() turns its receive interrupt off while it   *
+ *       sends, so Loopback isn't available then (see RCS_CanLoopback()).    *
+ *****************************************************************************/
+bool RCS_TxPoll( RCS_TXDONE *pDone ) {
+  TXJOB *pJob = &TxQueue[0];
+
+  if( byTxCount == 0 ) {
+    return false;
+  }
+  if( !pJob->bStarted && !pJob->bCancelled ) {
+    StartJob( pJob );
+  }
+#ifdef RCS_TIMER_TX
+  if( bTxPlaying && pJob->bCancelled ) {                    // Superseded? Stop at the end of this frame
+    noInterrupts();
+    if( uTxFramesLeft > 1 ) {
+      uTxFramesLeft = 1;
+    }
+    interrupts();
+  }
+#else
+  if( !pJob->bCancelled && (pJob->lFramesLeft > 0) ) {      // Still sending?
+    mySwitch.send( pJob->lCode, pJob->lValueLength );       //  Yes, one more frame
+    pJob->lFramesLeft--;
+    ulFramesSent++;
+  }
+#endif
+  if( bTxListening && mySwitch.available() ) {              // Heard something?
+    if( (long)mySwitch.getReceivedValue() == pJob->lCode ) {
+      pJob->bSeen = true;                                   //  Yes, it was what we sent
+    }
+    mySwitch.resetAvailable();
+  }
+#ifdef RCS_TIMER_TX
+  if( bTxPlaying ) {
+    return false;
+  }
+#else
+  if( !pJob->bCancelled && (pJob->lFramesLeft > 0) ) {
+    return false;
+  }
+#endif
+  FinishJob( pJob, pDone );
+  return true;
+}
+
+
+/*****************************************************************************
+ * FUNC: RCS_ProfileUsable                                                   *
+ * DESC: Check whether an outlet profile holds settings that can be sent     *
+ * ARGS: pOutlet = Address of the outlet's settings                          *
+ * RET:  true  if it has been set up                                         *
+ *       false if it hasn't (e.g. never-written EEPROM, which reads as -1)   *
+ *****************************************************************************/
+bool RCS_ProfileUsable( const OUTLET *pOutlet ) {
+  return    (pOutlet->OnCode      > 0)
+         && (pOutlet->OffCode     > 0)
+         && (pOutlet->PulseLength > 0)
+         && (pOutlet->ValueLength > 0)
+         && (pOutlet->ValueLength <= 32);
+}
+
+
+/*****************************************************************************
+ * FUNC: RCS_CanLoopback                                                     *
+ * DESC: Check whether our receiver can hear the codes we send (Loopback)    *
+ * ARGS: [None]                                                              *
+ * RET:  true  with Timer1, which plays the waveform while RCSwitch's        *
+ *             receive interrupt keeps decoding                              *
+ *       false without it: RCSwitch::send() turns the receive interrupt off  *
+ *             until it's done, so our own frames are never heard            *
+ *****************************************************************************/
+bool RCS_CanLoopback( void ) {
+#ifdef RCS_TIMER_TX
+  return true;
+#else
+  return false;
 #endif
 }
 
@@ -125,16 +526,8 @@ void RCS_SendOffCode( void ) {
 void RCReceiverSetup( void ) {
 //  pinMode( RCS_RX_GND_PIN, OUTPUT );                         // Establish "virtual GND" for 433MHz receiver
 //  digitalWrite( RCS_RX_GND_PIN, LOW );                       // [Currently using *real* GND pin]
-  pinMode( RCS_RX_VCC_PIN, OUTPUT );                         // Establish "virtual VCC" for 433MHz receiver
-#ifdef DEBUGGING
-/*
-SerialDebug.print( "433MHz receiver enabled on pin ");
-SerialDebug.print( RCS_RX_DAT_PIN );
-SerialDebug.print( " (interrupt ");
-SerialDebug.print( digitalPinToInterrupt(RCS_RX_DAT_PIN) );
-SerialDebug.println( ")");
-*/
-#endif
+  RxVccPin::Output();                                        // Establish "virtual VCC" for 433MHz receiver
+  LOG( LOG_RX_READY, RCS_RX_DAT_PIN, digitalPinToInterrupt(RCS_RX_DAT_PIN) );
 }
 
 
@@ -145,14 +538,11 @@ SerialDebug.println( ")");
  * RET:  [None]                                                              *
  *****************************************************************************/
 static void RCReceiverEnable( void ) {
-  digitalWrite( RCS_RX_VCC_PIN, HIGH );                    // Provide power to receiver module
+  RxVccPin::High();                                        // Provide power to receiver module
 //  delay( 100 );
   mySwitch.enableReceive(  digitalPinToInterrupt(RCS_RX_DAT_PIN) );
                                                            // Assign input pin for receiver data connection
-#ifdef DEBUGGING
-SerialDebug.println( "    Called RCReceiverEnable");
-#endif
-
+  LOG( LOG_RX_ON, 0, 0 );
 }
 
 
@@ -163,49 +553,86 @@ SerialDebug.println( "    Called RCReceiverEnable");
  * RET:  [None]                                                              *
  *****************************************************************************/
 static void RCReceiverDisable( void ) {
-#ifdef DEBUGGING
-SerialDebug.println( "    Called RCReceiverDisable");
-#endif
-
+  LOG( LOG_RX_OFF, 0, 0 );
   mySwitch.disableReceive( );
-  digitalWrite( RCS_RX_VCC_PIN, LOW );                     // Remove power from receiver module
+  RxVccPin::Low();                                         // Remove power from receiver module
+}
+
+
+/*****************************************************************************
+ * FUNC: RCS_FramesSent                                                      *
+ * DESC: Count the ON/OFF code frames sent since boot                        *
+ * ARGS: [None]                                                              *
+ * RET:  The count (each code goes out PulseRepeats times, less any frames   *
+ *       it didn't get to because a newer code superseded it)                *
+ *****************************************************************************/
+unsigned long RCS_FramesSent( void )
+{
+  unsigned long ulCount;
+
+  noInterrupts();                                           // (Four bytes; don't let Timer1 change it halfway)
+  ulCount = ulFramesSent;
+  interrupts();
+  return ulCount;
 }
 
 
 /*****************************************************************************
- * FUNC: RCS_CheckForCode                                                    *
- * DESC: Try to detect 433MHz code                                           *
+ * FUNC: RCS_LearnStart                                                      *
+ * DESC: Start listening for a code from an outlet's remote control          *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Call RCS_LearnPoll() until it returns true (or RCS_LEARN_MS has     *
+ *       passed), then RCS_LearnStop().                                      *
+ *****************************************************************************/
+void RCS_LearnStart( void )
+{
+  if( !bTxListening ) {
+    RCReceiverEnable();
+  }
+  bLearnListening = true;
+  mySwitch.resetAvailable();                               // (Don't "learn" our own last ON/OFF code)
+}
+
+
+/*****************************************************************************
+ * FUNC: RCS_LearnPoll                                                       *
+ * DESC: Check whether a code has been detected since RCS_LearnStart()       *
  * ARGS: pOutlet = Address of OUTLET structure to populate                   *
- * RET:  true  if signal from outlet remote was detected                     *
+ * RET:  true  if a code was detected (and stored in *pOutlet)               *
  *       false otherwise                                                     *
+ * NOTE: Nothing counts while we're transmitting (we'd hear ourselves).      *
  *****************************************************************************/
-bool RCS_CheckForCode( OUTLET *pOutlet  )
+bool RCS_LearnPoll( OUTLET *pOutlet )
 {
-  unsigned long startMillis = millis();
-           bool bResult     = false;
+  if( (byTxCount > 0) && TxQueue[0].bStarted ) {
+    return false;
+  }
+  if( !mySwitch.available() ) {
+    return false;
+  }
+  pOutlet->OnCode      = (long)mySwitch.getReceivedValue();  // Not sure which code is being requested, so populate both
+  pOutlet->OffCode     = pOutlet->OnCode;                    // ON and OFF codes with detected value
+  pOutlet->Protocol    = (long)mySwitch.getReceivedProtocol();
+  pOutlet->PulseLength = (long)mySwitch.getReceivedDelay();
+  pOutlet->ValueLength = (long)mySwitch.getReceivedBitlength();
+  LOG( LOG_HEARD, (byte)pOutlet->ValueLength, pOutlet->OnCode );
 
-#ifdef DEBUGGING
-SerialDebug.println( "    Called RCS_CheckForCode");
-#endif
+  mySwitch.resetAvailable();
+  return true;
+}
 
-  RCReceiverEnable();
-  while( startMillis + 3000 > millis() ) {
-    if( mySwitch.available() ) {
-#ifdef DEBUGGING
-SerialDebug.println( "    Detected a button press!");
-#endif
-      pOutlet->OnCode      = (long)mySwitch.getReceivedValue();  // Not sure which code is being requested, so populate both
-      pOutlet->OffCode     = pOutlet->OnCode;                    // ON and OFF codes with detected value
-      pOutlet->Protocol    = (long)mySwitch.getReceivedProtocol();
-      pOutlet->PulseLength = (long)mySwitch.getReceivedDelay();
-      pOutlet->ValueLength = (long)mySwitch.getReceivedBitlength();
-
-      mySwitch.resetAvailable();
-      bResult = true;
-      break;
-    }
-  }
-  RCReceiverDisable();
 
-  return bResult;
+/*****************************************************************************
+ * FUNC: RCS_LearnStop                                                       *
+ * DESC: Stop listening for a code from an outlet's remote control           *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void RCS_LearnStop( void )
+{
+  bLearnListening = false;
+  if( !bTxListening ) {
+    RCReceiverDisable();
+  }
 }
@@ -14,6 +14,12 @@
   /* Module-specific defines */
 # define MYRCS_DEBUGGING                                      // To debug the myRCSwitch module (when PRJ_DEBUGGING is defined)
 
+# define MAX_OUTLETS  4                                       // Outlet profiles (profile 0 = the laptop's outlet); each one
+                                                              //  is kept in EEPROM by myJournal
+# define RCS_LEARN_MS 3000UL                                  // How long to listen for a code from an outlet's remote control
+# define RCS_TX_QUEUE 6                                       // Transmissions that can be waiting (a BATCH for every profile,
+                                                              //  plus an ON/OFF or two)
+
   /* Typedefs */
  typedef struct {
    long OnCode;                                               // Pertinent settings for the remote outlet (to be initialized
@@ -23,16 +29,30 @@
    long PulseRepeats;
    long TurnOnBeforeQuit;
    long ValueLength;
- } OUTLET;
+   long Loopback;                                             // 1 = Listen for our own ON/OFF codes while sending them
+ } OUTLET;                                                    //     (anything else, e.g. erased EEPROM, = don't)
+
+ typedef struct {                                             // A finished transmission (see RCS_TxPoll())
+   byte byTag;                                                //  Whatever the caller passed to RCS_TxQueue()
+   byte byIdx;                                                //  Outlet profile
+   bool bOn;                                                  //  ON code (or OFF)
+   bool bSent;                                                //  false = superseded before it went out
+   bool bSeen;                                                //  Our receiver heard it (Loopback only; see RCS_CanLoopback())
+ } RCS_TXDONE;
 
   /* Global variables */
- extern OUTLET Outlet;
+ extern OUTLET Outlets[MAX_OUTLETS];
 
   /* Public function prototypes */
- void RCTransmitterSetup( void );
- void RCReceiverSetup(    void );
- void RCS_SendOnCode(     void );
- void RCS_SendOffCode(    void );
- bool RCS_CheckForCode( OUTLET *pOutlet  );
+ void          RCTransmitterSetup( void );
+ void          RCReceiverSetup(    void );
+ bool          RCS_TxQueue(        byte byIdx, bool bOn, byte byTag );
+ bool          RCS_TxPoll(         RCS_TXDONE *pDone );
+ bool          RCS_ProfileUsable(  const OUTLET *pOutlet );
+ bool          RCS_CanLoopback(    void );
+ unsigned long RCS_FramesSent(     void );
+ void          RCS_LearnStart(     void );
+ bool          RCS_LearnPoll(      OUTLET *pOutlet );
+ void          RCS_LearnStop(      void );
 
 #endif   // #ifndef MYRCSWITCH_H
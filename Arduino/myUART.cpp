@@ -0,0 +1,284 @@
+/*****************************************************************************
+ * FILE: myUART.cpp                                                          *
+ * DESC: Module to talk to the Windows ChargeOn program                      *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Interrupt-driven serial driver for the Nano's USART0. Received      *
+ *       bytes go into a ring buffer from the RX interrupt, so they're never *
+ *       lost while loop() is busy, and responses are queued in another one  *
+ *       and sent from the "data register empty" interrupt, so printing a    *
+ *       response only waits for the wire if it doesn't fit in the ring.     *
+ *                                                                           *
+ *       On other boards (e.g. a Pro Micro, whose Serial is USB) the same    *
+ *       functions simply use Serial.                                        *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+  /*  Includes */
+#include <Arduino.h>                                        // (Also brings in avr/pgmspace.h, for UART_PrintP())
+#include "Project.h"
+#include "myUART.h"
+
+#if defined(__AVR_ATmega328P__)                             // Nano (or Uno)?
+# define UART_NATIVE                                        //  Yes, drive USART0 ourselves (HardwareSerial must then
+# include <avr/io.h>                                        //   not be used anywhere, or its interrupt handlers clash)
+# include <avr/interrupt.h>
+#endif
+
+  /* Module-specific defines */
+#define RX_MASK  (UART_RX_SIZE - 1)
+#define TX_MASK  (UART_TX_SIZE - 1)
+
+  /* Static variables */
+#ifdef UART_NATIVE
+static volatile byte         RxRing[UART_RX_SIZE];
+static volatile byte         byRxHead    = 0;               // Next slot the RX interrupt fills
+static volatile byte         byRxTail    = 0;               // Next byte UART_Read() returns
+static volatile byte         TxRing[UART_TX_SIZE];
+static volatile byte         byTxHead    = 0;               // Next slot UART_Print() fills
+static volatile byte         byTxTail    = 0;               // Next byte the UDRE interrupt sends
+#endif
+static volatile unsigned int uOverruns   = 0;               // Bytes dropped because the receive ring was full
+static unsigned long         ulBytesIn   = 0;               // Bytes UART_Read() has returned
+static unsigned long         ulBytesOut  = 0;               // Bytes UART_Print() and UART_PrintP() have queued
+
+
+  /* Interrupt handlers */
+#ifdef UART_NATIVE
+
+/*****************************************************************************
+ * FUNC: USART_RX_vect                                                       *
+ * DESC: Store a received byte                                               *
+ *****************************************************************************/
+ISR( USART_RX_vect )
+{
+  byte byData = UDR0;                                       // (Reading UDR0 clears the interrupt)
+  byte byNext = (byRxHead + 1) & RX_MASK;
+
+  if( byNext == byRxTail ) {                                // Ring full?
+    uOverruns++;                                            //  Yes, drop the byte
+    return;
+  }
+  RxRing[byRxHead] = byData;
+  byRxHead         = byNext;
+}
+
+
+/*****************************************************************************
+ * FUNC: USART_UDRE_vect                                                     *
+ * DESC: Send the next queued byte (or stop, if there isn't one)             *
+ *****************************************************************************/
+ISR( USART_UDRE_vect )
+{
+  if( byTxTail == byTxHead ) {                              // Nothing (more) to send?
+    UCSR0B &= ~_BV(UDRIE0);                                 //  Yes, stop interrupting until UART_Print() queues more
+    return;
+  }
+  UDR0     = TxRing[byTxTail];
+  byTxTail = (byTxTail + 1) & TX_MASK;
+}
+
+
+  /* Local functions */
+
+/*****************************************************************************
+ * FUNC: StartSending                                                        *
+ * DESC: Make sure the UDRE interrupt is on                                  *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void StartSending( void )
+{
+  byte bySREG = SREG;                                       // (Without racing the interrupt turning itself off)
+
+  cli();
+  UCSR0B |= _BV(UDRIE0);
+  SREG   = bySREG;
+}
+
+
+/*****************************************************************************
+ * FUNC: QueueByte                                                           *
+ * DESC: Put a byte in the transmit ring                                     *
+ * ARGS: byData = The byte                                                   *
+ * RET:  [None]                                                              *
+ * NOTE: If the ring is full, starts the UDRE interrupt (it may not be on    *
+ *       yet, if this is the start of a long string) and waits for it to     *
+ *       make room. Call StartSending() once the rest is queued.             *
+ *****************************************************************************/
+static void QueueByte( byte byData )
+{
+  byte byNext = (byTxHead + 1) & TX_MASK;
+
+  if( byNext == byTxTail ) {                                // Ring full?
+    StartSending();                                         //  Yes, wait for the UDRE interrupt to make room
+    while( byNext == byTxTail ) {
+      ;
+    }
+  }
+  TxRing[byTxHead] = byData;
+  byTxHead         = byNext;
+}
+
+#endif   // #ifdef UART_NATIVE
+
+
+  /* Global functions */
+
+/*****************************************************************************
+ * FUNC: UART_Begin                                                          *
+ * DESC: Set up the serial port (8 data bits, no parity, 1 stop bit)         *
+ * ARGS: ulBaud = Baud rate                                                  *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void UART_Begin( unsigned long ulBaud )
+{
+#ifdef UART_NATIVE
+  unsigned int uUBRR = (F_CPU / 4 / ulBaud - 1) / 2;       // Double-speed mode, as HardwareSerial uses (117647 baud
+                                                            //  for 115200 at 16MHz, well within tolerance)
+  UCSR0A = _BV(U2X0);
+  UBRR0H = uUBRR >> 8;
+  UBRR0L = uUBRR & 0xFF;
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+#else
+  Serial.begin( ulBaud );
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_Read                                                           *
+ * DESC: Take the next received byte                                         *
+ * ARGS: [None]                                                              *
+ * RET:  The byte (0-255), or -1 if nothing has been received                *
+ *****************************************************************************/
+int UART_Read( void )
+{
+#ifdef UART_NATIVE
+  byte byData;
+
+  if( byRxTail == byRxHead ) {
+    return -1;
+  }
+  byData   = RxRing[byRxTail];
+  byRxTail = (byRxTail + 1) & RX_MASK;
+  ulBytesIn++;
+  return byData;
+#else
+  int nData = Serial.read();
+
+  if( nData >= 0 ) {
+    ulBytesIn++;
+  }
+  return nData;
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_RxWaiting                                                      *
+ * DESC: Is there a received byte waiting for UART_Read()?                   *
+ * ARGS: [None]                                                              *
+ * RET:  true = Yes                                                          *
+ * NOTE: Safe to call with interrupts off (loop() does, just before it       *
+ *       sleeps).                                                            *
+ *****************************************************************************/
+bool UART_RxWaiting( void )
+{
+#ifdef UART_NATIVE
+  return byRxTail != byRxHead;
+#else
+  return Serial.available() > 0;
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_Print                                                          *
+ * DESC: Queue a string to be sent                                           *
+ * ARGS: szText = The string                                                 *
+ * RET:  [None]                                                              *
+ * NOTE: Blocks until the whole string is in the transmit ring: straight    *
+ *       away if there's room, otherwise for as long as the wire takes to    *
+ *       send what doesn't fit (about 87us a byte at 115200 baud).           *
+ *****************************************************************************/
+void UART_Print( const char *szText )
+{
+#ifdef UART_NATIVE
+  while( *szText ) {
+    QueueByte( *szText++ );
+    ulBytesOut++;
+  }
+  StartSending();
+#else
+  ulBytesOut += strlen( szText );
+  Serial.print( szText );
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_PrintP                                                         *
+ * DESC: Queue a string that's in flash (PROGMEM) to be sent                 *
+ * ARGS: szTextP = The string                                                *
+ * RET:  [None]                                                              *
+ * NOTE: As UART_Print() (including blocking while the ring is full), but    *
+ *       the string is read straight out of flash, so it never has to be     *
+ *       copied into SRAM.                                                   *
+ *****************************************************************************/
+void UART_PrintP( const char *szTextP )
+{
+#ifdef UART_NATIVE
+  char cNext;
+
+  while( (cNext = pgm_read_byte(szTextP++)) != '\0' ) {
+    QueueByte( cNext );
+    ulBytesOut++;
+  }
+  StartSending();
+#else
+  ulBytesOut += strlen_P( szTextP );
+  Serial.print( (const __FlashStringHelper *)szTextP );
+#endif
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_Overruns                                                       *
+ * DESC: Count the bytes lost because the receive ring was full              *
+ * ARGS: [None]                                                              *
+ * RET:  The count                                                           *
+ *****************************************************************************/
+unsigned int UART_Overruns( void )
+{
+  unsigned int uCount;
+
+  noInterrupts();                                           // (Two bytes; don't let the RX interrupt change it halfway)
+  uCount = uOverruns;
+  interrupts();
+  return uCount;
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_BytesIn                                                        *
+ * DESC: Count the bytes received (and read) since UART_Begin()              *
+ * ARGS: [None]                                                              *
+ * RET:  The count                                                           *
+ *****************************************************************************/
+unsigned long UART_BytesIn( void )
+{
+  return ulBytesIn;
+}
+
+
+/*****************************************************************************
+ * FUNC: UART_BytesOut                                                       *
+ * DESC: Count the bytes queued to be sent since UART_Begin()                *
+ * ARGS: [None]                                                              *
+ * RET:  The count                                                           *
+ *****************************************************************************/
+unsigned long UART_BytesOut( void )
+{
+  return ulBytesOut;
+}
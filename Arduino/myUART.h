@@ -0,0 +1,28 @@
+/*****************************************************************************
+ * FILE: myUART.h                                                            *
+ * DESC: Header file for myUART module                                       *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Provides prototypes for "global" functions                          *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+ 
+#ifndef MYUART_H
+# define MYUART_H
+
+  /* Module-specific defines */
+# define UART_RX_SIZE  128                                    // Receive ring (must be a power of 2, no more than 256);
+                                                              //  holds the longest SETTINGS signal with room to spare
+# define UART_TX_SIZE  128                                    // Transmit ring (ditto); longer responses wait for room
+
+  /* Public function prototypes */
+ void          UART_Begin(     unsigned long ulBaud );
+ int           UART_Read(      void );
+ bool          UART_RxWaiting( void );
+ void          UART_Print(     const char *szText );
+ void          UART_PrintP(    const char *szTextP );
+ unsigned int  UART_Overruns(  void );
+ unsigned long UART_BytesIn(   void );
+ unsigned long UART_BytesOut(  void );
+
+#endif   // #ifndef MYUART_H
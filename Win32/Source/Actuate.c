@@ -0,0 +1,244 @@
+/*****************************************************************************
+ * FILE: Actuate.c                                                           *
+ * DESC: Outlet actuation (transmit-and-verify) engine                       *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Once an ON/OFF command has been sent, the AC line is watched        *
+ *       closely (every ACTUATE_POLL_MS, and whenever Windows reports a      *
+ *       power status change) instead of sleeping for a fixed time and then  *
+ *       re-sending the command on every battery check.                      *
+ *                                                                           *
+ *       The command is only sent again if the AC line hasn't changed within *
+ *       the "window" (based on how long the outlet usually takes, as        *
+ *       learned by the predictor - see Predict_Latency()), and the          *
+ *       window doubles after every retransmission. If the ChargeOn module   *
+ *       reports that it didn't hear its own transmission (RF loopback), the *
+ *       window is cut short.                                                *
+ *                                                                           *
+ *       This module makes no Windows API calls; the caller supplies the     *
+ *       tick counts and AC line status, and does the actual transmitting.   *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>                     // For sprintf()
+#include <string.h>                    // For memset()
+#include "Actuate.h"
+
+  /* Defines */
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+static DWORD FirstWindow( DWORD dwLatencyMs );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: FirstWindow                                                         *
+ * DESC: Work out how long to wait for the first transmission to take effect *
+ * ARGS: dwLatencyMs = How long the outlet usually takes (0 = not known)     *
+ * RET:  Time to wait (milliseconds)                                         *
+ *****************************************************************************/
+static DWORD FirstWindow( DWORD dwLatencyMs )
+{
+  if( dwLatencyMs == 0 ) {                                 // Don't know how long the outlet takes yet?
+    return ACTUATE_DEFAULT_WINDOW;                         //  No, use a safe guess
+  }
+  return (dwLatencyMs * 3) / 2 + ACTUATE_MARGIN_MS;
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: Actuate_Init                                                        *
+ * DESC: Forget everything (nothing in progress, nothing learned)            *
+ * ARGS: pAct = Address of ACTUATOR structure to initialize                  *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Actuate_Init( ACTUATOR *pAct )
+{
+  memset( pAct, 0, sizeof(*pAct) );
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_Start                                                       *
+ * DESC: Note that an ON/OFF command has just been sent for the first time   *
+ * ARGS: pAct        = Address of ACTUATOR structure                         *
+ *       byWantLine  = AC line status the command should produce (1 = ON)    *
+ *       dwLatencyMs = How long the outlet usually takes to switch           *
+ *                     (Predict_Latency(); 0 = not known yet)                *
+ *       dwTick      = Tick count when the command was sent                  *
+ * RET:  [None]                                                              *
+ * NOTE: A command that supersedes one still in progress counts as having    *
+ *       cancelled it.                                                       *
+ *****************************************************************************/
+void Actuate_Start( ACTUATOR *pAct, BYTE byWantLine, DWORD dwLatencyMs, DWORD dwTick )
+{
+  if( pAct->bActive ) {                                    // Already waiting on another command?
+    pAct->dwCancelled++;                                   //  Yes, it's been overtaken
+  }
+  pAct->bActive      = TRUE;
+  pAct->byWantLine   = byWantLine;
+  pAct->dwStartTick  = dwTick;
+  pAct->dwSendTick   = dwTick;
+  pAct->dwWindowMs   = FirstWindow( dwLatencyMs );
+  pAct->dwAttempts   = 1;
+  pAct->dwEchoHeard  = 0;
+  pAct->dwEchoMissed = 0;
+  pAct->dwTransmissions++;
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_Poll                                                        *
+ * DESC: Check whether the command in progress has taken effect              *
+ * ARGS: pAct   = Address of ACTUATOR structure                              *
+ *       byLine = Current AC line status                                     *
+ *       dwTick = Current tick count                                         *
+ * RET:  ACTUATE_IDLE      = Nothing in progress                             *
+ *       ACTUATE_WAITING   = Keep polling                                    *
+ *       ACTUATE_RESEND    = Send the command again (then call               *
+ *                           Actuate_Resent(), or Actuate_SendFailed() if it *
+ *                           couldn't be sent)                               *
+ *       ACTUATE_CONFIRMED = Done; the time taken / attempts have been       *
+ *                           recorded                                        *
+ *****************************************************************************/
+ACTUATE_STEP Actuate_Poll( ACTUATOR *pAct, BYTE byLine, DWORD dwTick )
+{
+  if( !pAct->bActive ) {
+    return ACTUATE_IDLE;
+  }
+
+  if( byLine == pAct->byWantLine ) {                       // Has the AC line changed as requested?
+    DWORD dwLatency = dwTick - pAct->dwStartTick;          //  Yes, record how long it took
+
+    pAct->bActive         = FALSE;
+    pAct->dwConfirmed++;
+    pAct->dwLastLatencyMs = dwLatency;
+    pAct->dwLastAttempts  = pAct->dwAttempts;
+    if( dwLatency > pAct->dwWorstLatencyMs ) {
+      pAct->dwWorstLatencyMs = dwLatency;
+    }
+    if( pAct->dwAttempts > pAct->dwWorstAttempts ) {
+      pAct->dwWorstAttempts = pAct->dwAttempts;
+    }
+    return ACTUATE_CONFIRMED;
+  }
+
+  if( dwTick - pAct->dwSendTick >= pAct->dwWindowMs ) {    // Waited long enough?
+    return ACTUATE_RESEND;                                 //  Yes, the outlet probably didn't hear the command
+  }
+  return ACTUATE_WAITING;
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_Resent                                                      *
+ * DESC: Note that the command in progress has just been sent again          *
+ * ARGS: pAct   = Address of ACTUATOR structure                              *
+ *       dwTick = Tick count when the command was sent                       *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Actuate_Resent( ACTUATOR *pAct, DWORD dwTick )
+{
+  pAct->dwSendTick = dwTick;
+  pAct->dwAttempts++;
+  pAct->dwTransmissions++;
+  pAct->dwWindowMs *= 2;                                   // Back off
+  if( pAct->dwWindowMs > ACTUATE_MAX_BACKOFF ) {
+    pAct->dwWindowMs = ACTUATE_MAX_BACKOFF;
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_SendFailed                                                  *
+ * DESC: Note that the command in progress couldn't be sent again (the       *
+ *       ChargeOn module didn't answer)                                      *
+ * ARGS: pAct   = Address of ACTUATOR structure                              *
+ *       dwTick = Current tick count                                         *
+ * RET:  [None]                                                              *
+ * NOTE: Nothing went out, so it doesn't count as an attempt; the next       *
+ *       Actuate_Poll() asks for it again once the window has run out.       *
+ *****************************************************************************/
+void Actuate_SendFailed( ACTUATOR *pAct, DWORD dwTick )
+{
+  pAct->dwSendTick = dwTick;
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_OnAir                                                       *
+ * DESC: Note whether the ChargeOn module heard the command it just sent     *
+ * ARGS: pAct   = Address of ACTUATOR structure                              *
+ *       bHeard = TRUE if its receiver decoded the code that was sent        *
+ *       dwTick = Current tick count                                         *
+ * RET:  [None]                                                              *
+ * NOTE: A command that never left the transmitter can't switch the outlet,  *
+ *       so the next Actuate_Poll() asks for it to be resent straight away.  *
+ *****************************************************************************/
+void Actuate_OnAir( ACTUATOR *pAct, BOOL bHeard, DWORD dwTick )
+{
+  if( bHeard ) {
+    pAct->dwHeard++;
+    if( pAct->bActive ) {
+      pAct->dwEchoHeard++;
+    }
+  }
+  else {
+    pAct->dwNotHeard++;
+    if( pAct->bActive ) {
+      pAct->dwEchoMissed++;
+      pAct->dwSendTick = dwTick - pAct->dwWindowMs;        // Pretend the window has already run out
+    }
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_Busy                                                        *
+ * DESC: Is a command to produce the given AC line status already in         *
+ *       progress?                                                           *
+ * ARGS: pAct       = Address of ACTUATOR structure                          *
+ *       byWantLine = AC line status (1 = ON)                                *
+ * RET:  TRUE  = Yes (don't send it again; the actuator will if necessary)   *
+ *       FALSE = No                                                          *
+ *****************************************************************************/
+BOOL Actuate_Busy( const ACTUATOR *pAct, BYTE byWantLine )
+{
+  return pAct->bActive && (pAct->byWantLine == byWantLine);
+}
+
+
+/*****************************************************************************
+ * FUNC: Actuate_FormatStats                                                 *
+ * DESC: Describe how quickly (and reliably) the outlet has been switching   *
+ * ARGS: pAct     = Address of ACTUATOR structure                            *
+ *       szBuffer = Buffer (at least 300 bytes) to receive the description   *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Actuate_FormatStats( const ACTUATOR *pAct, char *szBuffer )
+{
+  sprintf( szBuffer,
+           "Outlet switches confirmed:\t%lu (%lu cancelled)\n"
+           "Commands transmitted:\t%lu (%lu heard, %lu not heard)\n"
+           "Last switch:\t\t%lu ms, %lu attempt%s\n"
+           "Worst switch:\t\t%lu ms, %lu attempt%s",
+           (unsigned long)pAct->dwConfirmed,
+           (unsigned long)pAct->dwCancelled,
+           (unsigned long)pAct->dwTransmissions,
+           (unsigned long)pAct->dwHeard,
+           (unsigned long)pAct->dwNotHeard,
+           (unsigned long)pAct->dwLastLatencyMs,
+           (unsigned long)pAct->dwLastAttempts,
+           (pAct->dwLastAttempts == 1) ? "" : "s",
+           (unsigned long)pAct->dwWorstLatencyMs,
+           (unsigned long)pAct->dwWorstAttempts,
+           (pAct->dwWorstAttempts == 1) ? "" : "s" );
+}
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * FILE: Actuate.h                                                           *
+ * DESC: Definitions for the outlet actuation (transmit-and-verify) engine   *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef ACTUATE_H
+# define ACTUATE_H                               // Prevent items below from being processed more than once
+
+    /* Defines */
+# define ACTUATE_POLL_MS          250            // How often to check the AC line while waiting for the outlet
+# define ACTUATE_DEFAULT_WINDOW   5000           // How long to wait before retransmitting (until the latency is learned)
+# define ACTUATE_MARGIN_MS        750            // Added to 1.5x the learned latency to get the retransmit window
+# define ACTUATE_MAX_BACKOFF      60000          // Longest wait between retransmissions
+# define ACTUATE_WARN_ATTEMPTS    4              // Tell the user something is wrong after this many attempts
+
+    /* Typedefs */
+  typedef enum { ACTUATE_IDLE,                   // 0 = Nothing in progress
+                 ACTUATE_WAITING,                // 1 = Waiting for the AC line to change
+                 ACTUATE_RESEND,                 // 2 = Waited long enough; caller should transmit the command again
+                 ACTUATE_CONFIRMED               // 3 = AC line changed as requested
+               } ACTUATE_STEP;
+
+  typedef struct {
+    BOOL  bActive;                               // Waiting for the AC line to change?
+    BYTE  byWantLine;                            //  Yes, to this
+    DWORD dwStartTick;                           //  Tick count when the command was first sent
+    DWORD dwSendTick;                            //  Tick count when the command was most recently sent
+    DWORD dwWindowMs;                            //  How long to wait after that before sending it again
+    DWORD dwAttempts;                            //  Number of times the command has been sent
+    DWORD dwEchoHeard;                           //   of which the ChargeOn module heard on the air
+    DWORD dwEchoMissed;                          //   and didn't (neither, if it couldn't tell)
+
+    DWORD dwConfirmed;                           // Number of actuations confirmed
+    DWORD dwCancelled;                           // Number of actuations abandoned (superseded by another command)
+    DWORD dwTransmissions;                       // Total number of commands sent
+    DWORD dwHeard;                               //  Heard on the air by the ChargeOn module's own receiver
+    DWORD dwNotHeard;                            //  Not heard (so resent without waiting for the AC line)
+    DWORD dwLastLatencyMs;                       // Most recent actuation
+    DWORD dwLastAttempts;
+    DWORD dwWorstLatencyMs;                      // Slowest actuation
+    DWORD dwWorstAttempts;                       // Most attempts needed for one actuation
+  } ACTUATOR;
+
+    /* Global function prototypes */
+  void         Actuate_Init(        ACTUATOR *pAct );
+  void         Actuate_Start(       ACTUATOR *pAct, BYTE byWantLine, DWORD dwLatencyMs, DWORD dwTick );
+  ACTUATE_STEP Actuate_Poll(        ACTUATOR *pAct, BYTE byLine, DWORD dwTick );
+  void         Actuate_Resent(      ACTUATOR *pAct, DWORD dwTick );
+  void         Actuate_SendFailed(  ACTUATOR *pAct, DWORD dwTick );
+  void         Actuate_OnAir(       ACTUATOR *pAct, BOOL bHeard, DWORD dwTick );
+  BOOL         Actuate_Busy(        const ACTUATOR *pAct, BYTE byWantLine );
+  void         Actuate_FormatStats( const ACTUATOR *pAct, char *szBuffer );
+
+#endif
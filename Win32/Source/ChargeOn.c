@@ -19,7 +19,11 @@ processorArchitecture='x86' publicKeyToken='6595b64144ccf1df' language='*'\"")
 
   /* Defines */
 #define CHARGEON_REGKEY "Software\\Kerry Burton\\ChargeOn"
+#define OUTLET_REGKEY   CHARGEON_REGKEY "\\Outlet%u"   // Outlet profiles 1..MAX_OUTLETS-1 (profile 0 uses the values above)
 #define PULSE_REPEATS_DEFAULT   4
+#define RESUME_GAP_MS           10000            // Wall-clock time unaccounted for by running time that means the PC slept
+#define DEADMAN_CHECKS          5                // With ModuleControl on, the ChargeOn module turns the outlet ON after
+#define DEADMAN_MIN_SECS        60               //  missing this many battery checks' samples (but not sooner than this)
 
   /* Typedefs */
 typedef enum { APP_X,                   // 0
@@ -53,9 +57,21 @@ static VALENTA vlValList[] = { {"AppX",                   sizeof(DWORD), 0, REG_
                                {"OutletValueLength",      sizeof(DWORD), 0, REG_DWORD },  // 11
                                {"UpdateEveryCheck",       sizeof(DWORD), 0, REG_DWORD }   // 12
                              };                  // Registry value names and types
-
-static BOOL  bTurningON  = FALSE;                // In the process of turning the outlet ON?
-static BOOL  bTurningOFF = FALSE;                // In the process of turning the outlet OFF?
+static DWORD    dwSimSpeedup     = VBATTERY_SIM_SPEEDUP;
+static DWORD    dwSimTick;                       // Tick count when the simulated battery was last brought up to date
+static VBATTERY SimBattery;
+static DWORD    dwResumeCheckTick;               // Tick count (includes time asleep) at the last CheckForResume()
+static ULONGLONG ullResumeCheckRunTime;          //  and unbiased interrupt time (doesn't); 0 = not called yet
+static BOOL     bModuleCanControl = TRUE;        // Does the ChargeOn module understand <CO_LIMITS>? (Assume so until it says not)
+static BOOL     bModuleArmed      = FALSE;       // Is it making the MIN/MAX decisions
+static DWORD    dwArmedMin;                      //  with these limits
+static DWORD    dwArmedMax;
+static DWORD    dwArmedDeadSecs;
+static DWORD    dwDeadManTrips    = 0;           // Times its dead-man timer had gone off, at the last sample
+static OUTLET   ExtraOutlets[MAX_OUTLETS-1];     // Outlet profiles 1..MAX_OUTLETS-1 (e.g. a dock or monitor)
+static const char *szOutletValueName[] = { "OnCode", "OffCode", "Protocol", "PulseLength",
+                                           "PulseRepeats", "TurnOnBeforeQuit", "ValueLength", "Loopback" };
+                                                 // Registry value names for outlet profiles, in OUTLET order
 
   /* Global variables */
 DWORD  AppX                 = 50;                // Default setting values (in case the registry items don't exist or can't be read)
@@ -70,9 +86,13 @@ OUTLET Outlet               = { 0, // ON code     [KJB (5 May 2020): Appropriate
                                 PULSE_REPEATS_DEFAULT,
                                    // PulseRepeats                   Alternately, if their ChargeOn module has a built-in Learn
                                 0, // TurnOnBeforeQuit               module (and they have a remote control for the outlet) they
-                                0  // ValueLength                    can use the "Learn" function on the same page. 
+                                0, // ValueLength                    can use the "Learn" function on the same page. 
+                                0  // Loopback
                               };
+DWORD OutletCount           = 1;
 DWORD UpdateEveryCheck      = 1; 
+DWORD OutletAutoRepeats     = 1;                 // Let the PulseRepeats self-tuner adjust Outlet.PulseRepeats?
+DWORD ModuleControl         = 0;                 // Let the ChargeOn module make the MIN/MAX decisions (with a dead-man timer)?
 
 HINSTANCE hInst;                                 // Handle for the Windows program instance
 char      szAppFolder[MAX_PATH];                 // Folder where this program was started from
@@ -80,9 +100,168 @@ PORTINFO  SerialPort;                            // Structure containing the ser
 HWND      hMainDlg;                              // Window handle for the main dialog box
 BYTE      byLineStatus      = UNKNOWN_STATUS;    // Is the AC power line currently providing power to the laptop?
 BYTE      byBattLifePercent = UNKNOWN_PERCENT;   // The current battery charge as reported by Windows (0-100)
+POLICY_STATE ChargePolicy;                       // What the charge policy remembers between battery checks
+BOOL      bSimulateBattery  = FALSE;             // Started with /sim? (Use the VBattery model instead of the real battery)
+ACTUATOR  Actuator;                              // Tracks ON/OFF commands until the AC line confirms them
+GOVERNOR  Governor;                              // Keeps redundant / too-frequent ON/OFF commands off the air
+REPEAT_TUNER RepeatTuner;                        // Adjusts Outlet.PulseRepeats to suit the RF link
 
 /* === LOCAL FUNCTIONS ===================================================== */
 
+/*****************************************************************************
+ * FUNC: TransmitOutletCommand                                               *
+ * DESC: Send an ON or OFF command to the outlet                             *
+ * ARGS: pSerialPort = Pointer to PORTINFO structure containing a serial     *
+ *                     port's handle and user-friendly name                  *
+ *       bOn         = TRUE to turn the outlet ON, FALSE to turn it OFF      *
+ * RET:  TRUE if the ChargeOn module (or simulated battery) accepted it      *
+ *       Otherwise, FALSE                                                    *
+ *****************************************************************************/
+static BOOL TransmitOutletCommand( PORTINFO *pSerialPort, BOOL bOn )
+{
+  if( bSimulateBattery ) {                                 // Using the simulated battery?
+    VBattery_SetOutlet( &SimBattery, bOn );                //  Yes, the "outlet" is part of the simulation
+    return TRUE;
+  }
+  return SendSignal_GetResponse( pSerialPort, bOn ? TURN_ON : TURN_OFF );
+}
+
+
+/*****************************************************************************
+ * FUNC: CheckRFEcho                                                         *
+ * DESC: If the ChargeOn module listened for the ON/OFF command it just sent *
+ *       and didn't hear it, don't wait for the AC line before resending     *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Call right after Actuate_Start() / Actuate_Resent().                *
+ *****************************************************************************/
+static void CheckRFEcho( void )
+{
+  if( !bSimulateBattery && (byRFEcho != RF_ECHO_UNKNOWN) ) {
+    Actuate_OnAir( &Actuator, byRFEcho == RF_ECHO_SEEN, GetTickCount() );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: PushSampleToModule                                                  *
+ * DESC: With ModuleControl on, send the battery state to the ChargeOn       *
+ *       module and let it decide whether to switch the outlet               *
+ * ARGS: pSPS        = Pointer to SYSTEM_POWER_STATUS structure              *
+ *       bInfoIsGood = SYSTEM_POWER_DATA came from a successful call to      *
+ *                     CollectBatteryInfo()                                  *
+ *       pSerialPort = Pointer to PORTINFO structure                         *
+ *       dwTick      = Tick count when the battery state was collected       *
+ * RET:  TRUE  = The module took care of it                                  *
+ *       FALSE = It didn't (older sketch, not armed, or no reply); the       *
+ *               charge policy here has to decide this time                  *
+ * NOTE: The limits are (re)sent whenever the module isn't armed with the    *
+ *       current ones, e.g. after the user changes MIN/MAX, or after the     *
+ *       module restarts (hibernation power-cycles it). Only a sketch that   *
+ *       says it doesn't know <CO_LIMITS> is given up on; if there's just no *
+ *       reply, they're sent again at the next battery check.                *
+ *****************************************************************************/
+static BOOL PushSampleToModule( const SYSTEM_POWER_STATUS *pSPS, BOOL bInfoIsGood, PORTINFO *pSerialPort, DWORD dwTick )
+{
+  DWORD dwDeadSecs = max( DEADMAN_MIN_SECS, DEADMAN_CHECKS * CheckChargeInterval );
+  BYTE  byAct;
+  BOOL  bArmed;
+  DWORD dwTrips;
+  BYTE  byLimits;
+
+  if(    !bModuleArmed                                     // Module not yet making the decisions with the current limits?
+      || (dwArmedMin      != BatteryChargeMin)
+      || (dwArmedMax      != BatteryChargeMax)
+      || (dwArmedDeadSecs != dwDeadSecs) ) {
+    byLimits = Serial_SendLimits( pSerialPort, BatteryChargeMin, BatteryChargeMax, dwDeadSecs );
+    if( byLimits != LIMITS_OK ) {                          //  Yes, did it take them?
+      if( byLimits == LIMITS_UNKNOWN ) {                   //   No, because it can't?
+        bModuleCanControl = FALSE;                         //    Yes, don't ask again until it's reconnected
+      }
+      bModuleArmed = FALSE;                                //   (Otherwise try again next time)
+      return FALSE;
+    }
+    bModuleArmed    = TRUE;
+    dwArmedMin      = BatteryChargeMin;
+    dwArmedMax      = BatteryChargeMax;
+    dwArmedDeadSecs = dwDeadSecs;
+  }
+
+  if( !Serial_SendSample(pSerialPort,
+                         bInfoIsGood ? pSPS->BatteryLifePercent : UNKNOWN_PERCENT,
+                         bInfoIsGood ? pSPS->ACLineStatus       : UNKNOWN_STATUS,
+                         &byAct, &bArmed, &dwTrips)
+      || !bArmed ) {                                       // Module didn't hear it, or has forgotten its limits?
+    bModuleArmed = FALSE;                                  //  Yes, re-arm it next time
+    return FALSE;
+  }
+
+  if( dwTrips != dwDeadManTrips ) {                        // Did the module have to turn the outlet ON by itself?
+    if( dwTrips > dwDeadManTrips ) {
+      SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "ChargeOn module turned outlet ON (battery checks had stopped)" );
+    }
+    dwDeadManTrips = dwTrips;
+  }
+  if( byAct != SAMPLE_ACT_NONE ) {                         // Did it switch the outlet?
+    SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2),
+                   (byAct == SAMPLE_ACT_ON) ? "Turning outlet ON" : "Turning outlet OFF" );
+    Policy_CommandSent( &ChargePolicy, (byAct == SAMPLE_ACT_ON) ? ACTION_TURN_ON : ACTION_TURN_OFF, dwTick );
+  }
+  return TRUE;
+}
+
+
+/*****************************************************************************
+ * FUNC: LoadOutletProfile                                                   *
+ * DESC: Load an extra outlet profile from its own registry key              *
+ * ARGS: byIdx = Outlet profile (1..MAX_OUTLETS-1)                           *
+ * RET:  TRUE if the profile's key exists                                    *
+ * NOTE: Each value is read separately; missing ones are left at 0.          *
+ *****************************************************************************/
+static BOOL LoadOutletProfile( BYTE byIdx )
+{
+  HKEY   hKey;
+  char   szKey[80];
+  DWORD *pdwValue   = (DWORD *)GetOutlet( byIdx );         // (OUTLET is nothing but DWORDs)
+  DWORD  dwValueSize;
+  int    i;
+
+  sprintf( szKey, OUTLET_REGKEY, byIdx );
+  if( RegOpenKeyEx(HKEY_CURRENT_USER, szKey, 0, KEY_READ, &hKey) != ERROR_SUCCESS ) {
+    return FALSE;
+  }
+  for( i = 0; i < sizeof(szOutletValueName)/sizeof(szOutletValueName[0]); i++ ) {
+    dwValueSize = sizeof(DWORD);
+    RegQueryValueEx( hKey, szOutletValueName[i], NULL, NULL, (BYTE *)&pdwValue[i], &dwValueSize );
+  }
+  RegCloseKey( hKey );
+  return TRUE;
+}
+
+
+/*****************************************************************************
+ * FUNC: SaveOutletProfile                                                   *
+ * DESC: Save an extra outlet profile to its own registry key                *
+ * ARGS: byIdx = Outlet profile (1..MAX_OUTLETS-1)                           *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void SaveOutletProfile( BYTE byIdx )
+{
+  HKEY   hKey;
+  char   szKey[80];
+  DWORD *pdwValue = (DWORD *)GetOutlet( byIdx );
+  int    i;
+
+  sprintf( szKey, OUTLET_REGKEY, byIdx );
+  if( RegCreateKeyEx(HKEY_CURRENT_USER, szKey, 0, NULL, REG_OPTION_NON_VOLATILE, KEY_SET_VALUE, NULL, &hKey, NULL) == ERROR_SUCCESS ) {
+    for( i = 0; i < sizeof(szOutletValueName)/sizeof(szOutletValueName[0]); i++ ) {
+      RegSetValueEx( hKey, szOutletValueName[i], 0, REG_DWORD, (BYTE *)&pdwValue[i], sizeof(DWORD) );
+    }
+    RegCloseKey( hKey );
+  }
+}
+
+
 /*****************************************************************************
  * FUNC: InitFromRegistry                                                    *
  * DESC: Load values for "non-volatile" ChargeOn settings from the registry  *
@@ -98,10 +277,17 @@ void InitFromRegistry( void ) {
   HKEY    hKey;
   char    ValueBuf[(MAX_VALUENAME+1) * sizeof(DWORD)];
   DWORD   dwTotalSize = sizeof(ValueBuf) / sizeof(ValueBuf[0]);
+  DWORD   dwValueSize = sizeof(DWORD);
   LSTATUS lResult     = RegOpenKeyEx( HKEY_CURRENT_USER, CHARGEON_REGKEY, 0, KEY_READ, &hKey );
 
   if( lResult == ERROR_SUCCESS ) {
 // KJB (11 May 2020): It may be better (for backwards compatibility?) to retrieve each value separately.
+    RegQueryValueEx( hKey, "OutletAutoRepeats", NULL, NULL, (BYTE *)&OutletAutoRepeats, &dwValueSize );
+                                                           // Added later, so read separately (if it's missing, keep the default)
+    dwValueSize = sizeof(DWORD);
+    RegQueryValueEx( hKey, "OutletLoopback",    NULL, NULL, (BYTE *)&Outlet.Loopback,   &dwValueSize );
+    dwValueSize = sizeof(DWORD);
+    RegQueryValueEx( hKey, "ModuleControl",     NULL, NULL, (BYTE *)&ModuleControl,     &dwValueSize );
     lResult = RegQueryMultipleValues( hKey, vlValList, sizeof(vlValList)/sizeof(vlValList[0]), ValueBuf, &dwTotalSize );
     RegCloseKey(hKey);
     if( lResult == ERROR_SUCCESS ) {
@@ -119,6 +305,11 @@ void InitFromRegistry( void ) {
       Outlet.ValueLength      = *((DWORD *)vlValList[OUTLET_VALUELENGTH]     .ve_valueptr);
       UpdateEveryCheck        = *((DWORD *)vlValList[UPDATE_EVERYCHECK]      .ve_valueptr);
     }
+    for( OutletCount = 1; OutletCount < MAX_OUTLETS; OutletCount++ ) {
+      if( !LoadOutletProfile((BYTE)OutletCount) ) {        // Load any extra outlet profiles (they must be numbered
+        break;                                             //  consecutively from 1)
+      }
+    }
   }
   else {
     MessageBox( hMainDlg,
@@ -143,6 +334,7 @@ void SaveSettingsToRegistry( void )
            HKEY    hKey;
            RECT    DlgPos;
   volatile LRESULT lResult;
+           DWORD   i;
 
   lResult = RegCreateKeyEx( HKEY_CURRENT_USER,             // Open application registry key
                             CHARGEON_REGKEY,               //  (if it does not exist, create it)
@@ -178,11 +370,18 @@ void SaveSettingsToRegistry( void )
     lResult = RegSetValueEx( hKey, "OutletProtocol",         0, REG_DWORD, (BYTE *)&Outlet.Protocol,         sizeof(DWORD) );
     lResult = RegSetValueEx( hKey, "OutletPulseLength",      0, REG_DWORD, (BYTE *)&Outlet.PulseLength,      sizeof(DWORD) );
     lResult = RegSetValueEx( hKey, "OutletPulseRepeats",     0, REG_DWORD, (BYTE *)&Outlet.PulseRepeats,     sizeof(DWORD) );
+    lResult = RegSetValueEx( hKey, "OutletAutoRepeats",      0, REG_DWORD, (BYTE *)&OutletAutoRepeats,       sizeof(DWORD) );
+    lResult = RegSetValueEx( hKey, "OutletLoopback",         0, REG_DWORD, (BYTE *)&Outlet.Loopback,         sizeof(DWORD) );
     lResult = RegSetValueEx( hKey, "OutletTurnOnBeforeQuit", 0, REG_DWORD, (BYTE *)&Outlet.TurnOnBeforeQuit, sizeof(DWORD) );
     lResult = RegSetValueEx( hKey, "OutletValueLength",      0, REG_DWORD, (BYTE *)&Outlet.ValueLength,      sizeof(DWORD) );
     lResult = RegSetValueEx( hKey, "UpdateEveryCheck",       0, REG_DWORD, (BYTE *)&UpdateEveryCheck,        sizeof(DWORD) );
+    lResult = RegSetValueEx( hKey, "ModuleControl",          0, REG_DWORD, (BYTE *)&ModuleControl,           sizeof(DWORD) );
   }
   RegCloseKey( hKey );
+
+  for( i = 1; i < OutletCount; i++ ) {                     // Save any extra outlet profiles
+    SaveOutletProfile( (BYTE)i );
+  }
 }
 
 
@@ -199,15 +398,19 @@ void EnableCharging( PORTINFO *pSerialPort )
   ShowWindow( GetDlgItem(hMainDlg, IDC_SWITCH_OUTLET), SW_HIDE );
                                                            // Hide the "Turn outlet ON" button
   SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "Turning outlet ON" );
-  if( !SendSignal_GetResponse(pSerialPort, TURN_ON) ) {    // Able to ask ChargeOn module (Arduino) to turn remote outlet ON?
+  if( !TransmitOutletCommand(pSerialPort, TRUE) ) {        // Able to ask ChargeOn module (Arduino) to turn remote outlet ON?
     SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "ERROR while turning outlet ON" );
                                                            //  No, display message
     ShowWindow( GetDlgItem(hMainDlg, IDC_SWITCH_OUTLET), SW_SHOW );
                                                            //   Redisplay the "Turn outlet ON" button
   }
   else {
-    bTurningON  = TRUE;                                    //  Yes, set the "turning ON" flag
-    bTurningOFF = FALSE;                                   //   Clear the "turning OFF" flag
+    Policy_CommandSent( &ChargePolicy, ACTION_TURN_ON, GetTickCount() );
+                                                           //  Yes, set the "turning ON" flag (and clear "turning OFF")
+    Actuate_Start( &Actuator, 1, Predict_Latency(&ChargePolicy.Pred), GetTickCount() );
+                                                           //   Watch closely for the AC line to come ON
+    CheckRFEcho();
+    SetTimer( hMainDlg, IDT_TIMER2, ACTUATE_POLL_MS, (TIMERPROC)NULL );
   }
 }
 
@@ -225,15 +428,97 @@ void DisableCharging( PORTINFO *pSerialPort )
   ShowWindow( GetDlgItem(hMainDlg, IDC_SWITCH_OUTLET), SW_HIDE );
                                                            // Hide the "Turn outlet ON/OFF" button
   SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "Turning outlet OFF" );
-  if( !SendSignal_GetResponse(pSerialPort, TURN_OFF) ) {   // Able to ask ChargeOn module (Arduino) to turn remote outlet OFF?
+  if( !TransmitOutletCommand(pSerialPort, FALSE) ) {       // Able to ask ChargeOn module (Arduino) to turn remote outlet OFF?
     SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "ERROR while turning outlet OFF" );
                                                            //  No, display message
     ShowWindow( GetDlgItem(hMainDlg, IDC_SWITCH_OUTLET), SW_SHOW );
                                                            //   Redisplay the "Turn outlet OFF" button
   }
   else {
-    bTurningOFF = TRUE;                                    //  Yes, set the "turning OFF" flag
-    bTurningON  = FALSE;                                   //   Clear the "turning ON" flag
+    Policy_CommandSent( &ChargePolicy, ACTION_TURN_OFF, GetTickCount() );
+                                                           //  Yes, set the "turning OFF" flag (and clear "turning ON")
+    Actuate_Start( &Actuator, 0, Predict_Latency(&ChargePolicy.Pred), GetTickCount() );
+                                                           //   Watch closely for the AC line to go OFF
+    CheckRFEcho();
+    SetTimer( hMainDlg, IDT_TIMER2, ACTUATE_POLL_MS, (TIMERPROC)NULL );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: CheckActuation                                                      *
+ * DESC: See whether the outlet has responded to the latest ON/OFF command,  *
+ *       and send the command again if it's taking too long                  *
+ * ARGS: pSerialPort = Pointer to PORTINFO structure containing a serial     *
+ *                     port's handle and user-friendly name                  *
+ * RET:  [None]                                                              *
+ * NOTE: Called every ACTUATE_POLL_MS (IDT_TIMER2) while a command is in     *
+ *       progress, and whenever Windows reports a power status change.       *
+ *****************************************************************************/
+void CheckActuation( PORTINFO *pSerialPort )
+{
+  SYSTEM_POWER_STATUS SPS;
+  char                szMessage[80];
+
+  if( bDoingTX_RX || !CollectBatteryInfo(&SPS) ) {         // Busy talking to the ChargeOn module, or no battery info?
+    return;                                                //  Yes, try again on the next poll
+  }
+
+  switch( Actuate_Poll(&Actuator, SPS.ACLineStatus, GetTickCount()) ) {
+    case ACTUATE_RESEND:                                   // Outlet hasn't responded in time?
+      if( !Governor_AllowRetry(&Governor, GetTickCount()) ) {
+        break;                                             //  Yes, but we've been resending a lot; wait a bit
+      }
+      if( !TransmitOutletCommand(pSerialPort, Actuator.byWantLine) ) {
+                                                           //  Able to send the command again?
+        Actuate_SendFailed( &Actuator, GetTickCount() );   //   No, try again after another window
+        Serial_LinkSuspect();                              //    (and have the next battery check look for the module)
+        sprintf( szMessage, "ERROR while turning outlet %s", Actuator.byWantLine ? "ON" : "OFF" );
+        SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), szMessage );
+        ShowWindow( GetDlgItem(hMainDlg, IDC_SWITCH_OUTLET), SW_SHOW );
+        break;
+      }
+      Actuate_Resent( &Actuator, GetTickCount() );         //   Yes, wait longer next time
+      CheckRFEcho();
+      if( Actuator.dwAttempts >= ACTUATE_WARN_ATTEMPTS ) { //  Still nothing after several attempts?
+        sprintf( szMessage, "Outlet has not turned %s (%lu attempts%s)",
+                            Actuator.byWantLine ? "ON" : "OFF", (unsigned long)Actuator.dwAttempts,
+                            (byRFEcho == RF_ECHO_SEEN)   ? "; transmitter OK"
+                          : (byRFEcho == RF_ECHO_MISSED) ? "; not heard on the air" : "" );
+        SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), szMessage );
+        ShowWindow( GetDlgItem(hMainDlg, IDC_SWITCH_OUTLET), SW_SHOW );
+                                                           //   Yes, let the user know (and let them try by hand)
+      }
+      break;
+
+    case ACTUATE_CONFIRMED:                                // Outlet switched?
+      KillTimer( hMainDlg, IDT_TIMER2 );                   //  Yes, stop polling
+      SendMessage( hMainDlg, WM_TIMER, IDT_TIMER1, 0 );    //   and update the display right away
+      sprintf( szMessage, "Outlet turned %s in %.1f sec (%lu attempt%s)",
+                          Actuator.byWantLine ? "ON" : "OFF",
+                          Actuator.dwLastLatencyMs / 1000.0,
+                          (unsigned long)Actuator.dwLastAttempts,
+                          (Actuator.dwLastAttempts == 1) ? "" : "s" );
+      SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), szMessage );
+      if( OutletAutoRepeats && !bSimulateBattery ) {       //   Tuning PulseRepeats (to a real outlet)?
+        DWORD dwOldRepeats = Outlet.PulseRepeats;          //    Yes, does it need changing?
+
+        Outlet.PulseRepeats = Repeats_Confirmed( &RepeatTuner, dwOldRepeats, Actuator.dwLastAttempts,
+                                                 Actuator.dwEchoHeard, Actuator.dwEchoMissed );
+        if(    (Outlet.PulseRepeats != dwOldRepeats)       //     Yes, tell the ChargeOn module
+            && !SendSignal_GetResponse(pSerialPort, SETTINGS) ) {
+          Outlet.PulseRepeats = dwOldRepeats;              //      (or keep the old value if it didn't hear)
+          Repeats_Rejected( &RepeatTuner, dwOldRepeats );
+        }
+      }
+      break;
+
+    case ACTUATE_IDLE:                                     // Nothing in progress?
+      KillTimer( hMainDlg, IDT_TIMER2 );                   //  Stop polling
+      break;
+
+    default:                                               // Still waiting...
+      break;
   }
 }
 
@@ -243,10 +528,14 @@ void DisableCharging( PORTINFO *pSerialPort )
  * DESC: Transmit outlet settings to the ChargeOn module (Arduino)           *
  * ARGS: [None]                                                              *
  * RET:  [None]                                                              *
- * NOTE: [None]                                                              *
+ * NOTE: Nothing is sent if the module's settings hash shows it already has  *
+ *       them, and only the fields that changed if it has the ones we sent   *
+ *       last time (older sketches always get everything).                  *
  *****************************************************************************/
 void SendOutletSettings( PORTINFO *pSerialPort )
 {
+  bModuleCanControl = TRUE;                                // (Re)connected; find out again whether it can take control
+  bModuleArmed      = FALSE;
   SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "Sending outlet settings" );
   if(    (Outlet.OnCode           == 0)                    // Outlet settings all have default values?
       && (Outlet.OffCode          == 0)                    // (Unable to read settings from registry?)
@@ -259,10 +548,17 @@ void SendOutletSettings( PORTINFO *pSerialPort )
                                                            //  Yes, (try to) read outlet settings from ChargeOn module (Arduino)
   }
  
-  if( !SendSignal_GetResponse(pSerialPort, SETTINGS) ) {   // Able to send (new?) outlet settings to ChargeOn module (Arduino)?
+  if( Serial_CheckSettingsHash(pSerialPort, (BYTE)OutletCount) == HASH_MATCHES ) {
+    SaveSettingsToRegistry();                              // Module already has these settings?
+    SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "" );//  Yes, nothing to send
+  }
+  else if( !SendSignal_GetResponse(pSerialPort, SETTINGS) ) {   // Able to send (new?) outlet settings to ChargeOn module (Arduino)?
     SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "ERROR while sending outlet settings" );
                                                            //  No, display error message
   }
+  else if( !Serial_SendOutletProfiles(pSerialPort, (BYTE)OutletCount) ) {
+    SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "ERROR while sending settings for the other outlets" );
+  }                                                        //  Yes, but not the extra outlet profiles
   else {
     SaveSettingsToRegistry();
     SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "" );//  Yes, remove original notification
@@ -270,6 +566,72 @@ void SendOutletSettings( PORTINFO *pSerialPort )
 }
 
 
+/*****************************************************************************
+ * FUNC: GetOutlet                                                           *
+ * DESC: Find the settings for an outlet profile                             *
+ * ARGS: byIdx = Outlet profile (0 = the laptop's outlet)                    *
+ * RET:  Address of the profile's OUTLET structure (profile 0 if byIdx is    *
+ *       out of range)                                                       *
+ *****************************************************************************/
+OUTLET *GetOutlet( BYTE byIdx )
+{
+  if( (byIdx == 0) || (byIdx >= MAX_OUTLETS) ) {
+    return &Outlet;
+  }
+  return &ExtraOutlets[byIdx - 1];
+}
+
+
+/*****************************************************************************
+ * FUNC: ReleaseModuleControl                                                *
+ * DESC: Take the MIN/MAX decisions back from the ChargeOn module            *
+ * ARGS: pSerialPort = Pointer to PORTINFO structure                         *
+ * RET:  [None]                                                              *
+ * NOTE: Call when quitting normally, so that the dead-man timer doesn't     *
+ *       turn the outlet ON behind the user's back ("Turn outlet ON before   *
+ *       quitting" decides that).                                            *
+ *****************************************************************************/
+void ReleaseModuleControl( PORTINFO *pSerialPort )
+{
+  if( bModuleArmed ) {
+    Serial_SendLimits( pSerialPort, 0, 0, 0 );
+    bModuleArmed = FALSE;
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: CheckForResume                                                      *
+ * DESC: Has the PC been asleep (or hibernated) since the last call?         *
+ * ARGS: [None]                                                              *
+ * RET:  TRUE  = Yes, it has woken up since then                             *
+ *       FALSE = No (or this is the first call)                              *
+ * NOTE: GetTickCount() keeps counting while the PC is asleep, but the       *
+ *       unbiased interrupt time doesn't, so a jump in the difference        *
+ *       between the two means the PC slept. This catches a resume even if   *
+ *       the PBT_APMRESUMEAUTOMATIC message was missed.                      *
+ *****************************************************************************/
+BOOL CheckForResume( void )
+{
+  DWORD     dwTick = GetTickCount();
+  ULONGLONG ullRunTime;                                    // 100ns units
+  BOOL      bSlept = FALSE;
+
+  if( !QueryUnbiasedInterruptTime(&ullRunTime) ) {         // (Not available before Windows 7)
+    return FALSE;
+  }
+  if( ullResumeCheckRunTime != 0 ) {                       // Called before?
+    DWORD dwRanMs = (DWORD)((ullRunTime - ullResumeCheckRunTime) / 10000);
+
+    bSlept = (dwTick - dwResumeCheckTick) > (dwRanMs + RESUME_GAP_MS);
+                                                           //  Yes, did more time pass than we were running for?
+  }
+  dwResumeCheckTick     = dwTick;
+  ullResumeCheckRunTime = ullRunTime;
+  return bSlept;
+}
+
+
 /*****************************************************************************
  * FUNC: CollectBatteryInfo                                                  *
  * DESC: Collect information about the battery's charge and status           *
@@ -277,12 +639,26 @@ void SendOutletSettings( PORTINFO *pSerialPort )
  *       about the battery state and whether AC power is currently applied   *
  * RET:  TRUE if collection was gathered successfully                        *
  *       Otherwise, FALSE                                                    *
- * NOTE: [None]                                                              *
+ * NOTE: When started with /sim, the info comes from the VBattery model,     *
+ *       running dwSimSpeedup times faster than real time.                   *
  *****************************************************************************/
 BOOL CollectBatteryInfo( SYSTEM_POWER_STATUS *pSPS )
 {
   BOOL bCallSuccess = FALSE;
 
+  if( bSimulateBattery ) {                                 // Using the simulated battery?
+    DWORD dwNow = GetTickCount();                          //  Yes, catch the simulation up to the present
+
+    VBattery_Advance( &SimBattery, (dwNow - dwSimTick) * dwSimSpeedup );
+    dwSimTick = dwNow;
+    memset( pSPS, 0, sizeof(*pSPS) );
+    VBattery_Status( &SimBattery, &pSPS->BatteryLifePercent, &pSPS->ACLineStatus );
+    pSPS->BatteryFlag         = (BYTE)(pSPS->ACLineStatus && !SimBattery.bFull ? 8 : 0);
+    pSPS->BatteryLifeTime     = (DWORD)-1;
+    pSPS->BatteryFullLifeTime = (DWORD)-1;
+    return TRUE;
+  }
+
   bCallSuccess = GetSystemPowerStatus( pSPS );             // Ask Windows to provide battery status info
   return bCallSuccess;
 }
@@ -303,70 +679,43 @@ BOOL CollectBatteryInfo( SYSTEM_POWER_STATUS *pSPS )
  *****************************************************************************/
 void ProcessBatteryInfo( SYSTEM_POWER_STATUS *pSPS, BOOL bInfoIsGood, PORTINFO *pSerialPort )
 {
-  volatile BOOL bNeedToEnableCharging                     = FALSE;
-  volatile BOOL bNeedToDisableCharging                    = FALSE;
-  static   BOOL bNeedToNotifyAboutDischargingBelowMinimum = FALSE;
-//  static BOOL bNeedToNotifyAboutChargingAboveMaximum    = FALSE;
-
-  if(    pSPS->BatteryLifePercent == UNKNOWN_PERCENT       // Battery status is unknown
-      || pSPS->ACLineStatus       == UNKNOWN_STATUS        // OR AC line status is unknown?
-    ) {
-    bNeedToEnableCharging = TRUE;                          //  Yes, we'd better enable charging just in case
+  CHARGE_SAMPLE Sample;
+  POLICY_CONFIG Config;
+  SYSTEMTIME    stSysTime;
+
+  GetLocalTime( &stSysTime );
+  Sample.dwTick       = GetTickCount();                    // Package up the battery info for the policy engine
+  Sample.wMinuteOfDay = (stSysTime.wHour * 60) + stSysTime.wMinute;
+  Sample.bInfoIsGood  = bInfoIsGood;
+  Sample.byPct        = pSPS->BatteryLifePercent;
+  Sample.byLine       = pSPS->ACLineStatus;
+  Policy_InitConfig( &Config, BatteryChargeMin, BatteryChargeMax );
+
+  if(    ModuleControl && bModuleCanControl && !bSimulateBattery
+      && PushSampleToModule(pSPS, bInfoIsGood, pSerialPort, Sample.dwTick) ) {
+    return;                                                // The ChargeOn module is making the decisions
   }
-  else {
-    if( bInfoIsGood ) {                                    // Got battery info OK?
-      if( pSPS->ACLineStatus == 1 ) {                      //  Yes, currently charging?
-        bNeedToNotifyAboutDischargingBelowMinimum = FALSE; //   Yes, clear "need to notify about discharging too far" flag (if it's set)
-        if(   (pSPS->BatteryLifePercent != UNKNOWN_PERCENT)//    Battery percentage is known
-           && (pSPS->BatteryLifePercent >= (BYTE)BatteryChargeMax)
-                                                           //    AND battery percentage matches/exceeds maximum allowed?
-          ) {
-          bNeedToDisableCharging = TRUE;                   //     Yes, need to disable charging
-/* KJB (11 May 2020): Do we really care about the battery charging up too far?
-          if( pSPS->BatteryLifePercent > BatteryChargeMax+2 ){
-                                                           //     Have we continued to charge past the target percentage?
-            if( bNeedToNotifyAboutChargingAboveMaximum ) { //      Yes, do we need to alert the user?
-              MessageBox( 0,                               //       Yes, do so
-                          "Outlet has not turned off as expected.\nTry repositioning the ChargeOn module, or turn off the outlet manually.",
-                          "Outlet did not turn OFF",
-                          MB_OK | MB_ICONINFORMATION
-                        );
-              bNeedToNotifyAboutChargingAboveMaximum = FALSE;
-                                                           //        Clear "need to notify about charging too far" flag
-            }
-          }  // Charging past target percentage?
-*/
-        }  // Need to turn outlet OFF?
-        if( bTurningOFF ) {                                //    (Still) trying to turn the outlet OFF?
-          bNeedToDisableCharging = TRUE;                   //     Yes, need to disable charging
-        }
-      }  // Currently charging?
-
-      else {                                               //   No (not currently charging)...
-//      bNeedToNotifyAboutChargingAboveMaximum = FALSE;      //    Clear "need to notify about charging too far" flag (if it's set)
-        if(    (pSPS->BatteryLifePercent <= (BYTE)BatteryChargeMin)
-                                                           //    Currently discharging at or below the minimum charge allowed
-            || bTurningON                                  //    OR (still) trying to turn the outlet ON?
-          ) {                                              
-          bNeedToEnableCharging = TRUE;                    //     Yes, need to enable charging
-        }
+
+  switch( Policy_Decide(&Config, &ChargePolicy, &Sample) ) {
+                                                           // What does the (compiled-in) charge policy want to do?
+    case ACTION_TURN_OFF:                                  //  Need to disable charging?
+      if( Governor_Request(&Governor, 0, pSPS->ACLineStatus, Actuate_Busy(&Actuator, 0), GOV_SOURCE_POLICY, Sample.dwTick) == GOV_SEND ) {
+                                                           //   Yes, not redundant (or too soon)?
+        DisableCharging( pSerialPort );                    //    Yes, do so (CheckActuation() handles any retries)
       }
-    }
-    else {                                                 //  No, (didn't get battery info OK)
-      bNeedToEnableCharging = TRUE;                        //   We'd better enable charging just in case
-    }
-  }
+      break;
+
+    case ACTION_TURN_ON:                                   //  Need to enable charging?
+      if( Governor_Request(&Governor, 1, pSPS->ACLineStatus, Actuate_Busy(&Actuator, 1),
+                           ChargePolicy.bFailSafe ? GOV_SOURCE_SAFETY : GOV_SOURCE_POLICY, Sample.dwTick) == GOV_SEND ) {
+                                                           //   Yes, not redundant (or too soon, unless the battery info is
+                                                           //    bad or unknown)?
+        EnableCharging( pSerialPort );                     //    Yes, do it! (CheckActuation() handles any retries)
+      }
+      break;
 
-  if( bNeedToDisableCharging ) {                           // Need to disable charging?
-    DisableCharging( pSerialPort );                        //  Yes, do so
-    bTurningON = FALSE;
-  }
-  else if( bNeedToEnableCharging ) {                       //  No, need to enable charging?
-    EnableCharging( pSerialPort );                         //   Yes, do it!
-    bTurningOFF = FALSE;
-  }
-  else {                                                   //   No, continue charging / discharging normally...
-    bTurningON = bTurningOFF = FALSE;
+    default:                                               //  Continue charging / discharging normally...
+      break;
   }
 }
 
@@ -395,6 +744,20 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE h0, LPTSTR lpCmdLine, int nCm
     return -1;                                             //       and EXIT
   }
   hInst = hInstance;                                       // Capture instance handle
+  Policy_InitState( &ChargePolicy );                       // Nothing has been learned about latency / charge slope yet
+  Actuate_Init( &Actuator );
+  Governor_Init( &Governor, GetTickCount() );
+
+  if( strstr(lpCmdLine, "/sim") ) {                        // Asked to use a simulated battery (for testing)?
+    VBATTERY_CONFIG BattConfig;                            //  Yes, start it half charged with the outlet ON
+
+    bSimulateBattery = TRUE;
+    sscanf( strstr(lpCmdLine, "/sim") + 4, ":%lu", &dwSimSpeedup );
+                                                           //   (/sim:N runs it N times faster than real time)
+    VBattery_InitConfig( &BattConfig );
+    VBattery_Init( &SimBattery, &BattConfig, 50, TRUE );
+    dwSimTick = GetTickCount();
+  }
 
   strcpy( szAppFolder, GetCommandLine()+1 );               // Make copy of command line (minus leading " character)
 // KJB (30 May 2020): To be safe, may want to truncate command line at initial occurrence of ".exe" first
@@ -21,12 +21,19 @@
 # include "MainDlg.h"
 # include "SettingsDlg.h"
 # include "Serial.h"
+# include "Predict.h"
+# include "Policy.h"
+# include "VBattery.h"
+# include "Actuate.h"
+# include "Governor.h"
+# include "Repeats.h"
 # include "resource.h"
 
   /* Defines */
 # define WIN32_APP_VERSION   "0.8.07"
 # define UNKNOWN_STATUS      255
 # define UNKNOWN_PERCENT     255
+# define MAX_OUTLETS         4         // Outlet profiles per ChargeOn module (must match MAX_OUTLETS in the sketch)
 
 # if 0
   typedef struct _SYSTEM_POWER_STATUS {
@@ -62,6 +69,7 @@
     DWORD PulseRepeats;
     DWORD TurnOnBeforeQuit;
     DWORD ValueLength;
+    DWORD Loopback;                    // 1 = ChargeOn module listens for its own ON/OFF codes (and says if it heard them)
   } OUTLET;
 
     /* Global function prototypes */
@@ -72,6 +80,10 @@
   BOOL CollectBatteryInfo(     SYSTEM_POWER_STATUS *pSPS );
   void SendOutletSettings(     PORTINFO            *pSerialPort );
   void ProcessBatteryInfo(     SYSTEM_POWER_STATUS *pSPS, BOOL bInfoIsGood, PORTINFO *pSerialPort );
+  void CheckActuation(         PORTINFO            *pSerialPort );
+  OUTLET *GetOutlet(           BYTE                byIdx );
+  BOOL CheckForResume(         void );
+  void ReleaseModuleControl(   PORTINFO            *pSerialPort );
 
     /* Global variables declared in this module */
   extern DWORD     AppX;               // Non-volatile settings that get stored in the registry
@@ -79,8 +91,11 @@
   extern DWORD     BatteryChargeMax;
   extern DWORD     BatteryChargeMin;
   extern DWORD     CheckChargeInterval;
-  extern OUTLET    Outlet;
+  extern OUTLET    Outlet;             // Outlet profile 0 (the laptop's outlet, switched by the charge policy)
+  extern DWORD     OutletCount;        // Number of outlet profiles in use (1 + any found under the Outlet1..3 keys)
   extern DWORD     UpdateEveryCheck;
+  extern DWORD     OutletAutoRepeats;
+  extern DWORD     ModuleControl;      // Let the ChargeOn module make the MIN/MAX decisions?
 
   extern HINSTANCE hInst;              // Handle for the Windows program instance
   extern char      szAppFolder[];      // Folder where this program was started from
@@ -89,5 +104,10 @@
   extern BYTE      byLineStatus;       // Is the AC power line currently providing power to the laptop?
   extern BYTE      byBattLifePercent;  // The current battery charge as reported by Windows (0-100)
   extern BOOL      bSendingSettings;   // In the process of sending outlet settings to ChargeOn module (Arduino?)
+  extern POLICY_STATE ChargePolicy;    // What the charge policy remembers between battery checks
+  extern BOOL      bSimulateBattery;   // Using the VBattery model instead of the real battery?
+  extern ACTUATOR  Actuator;           // Tracks ON/OFF commands until the AC line confirms them
+  extern GOVERNOR  Governor;           // Keeps redundant / too-frequent ON/OFF commands off the air
+  extern REPEAT_TUNER RepeatTuner;     // Adjusts Outlet.PulseRepeats to suit the RF link
 
 #endif
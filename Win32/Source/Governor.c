@@ -0,0 +1,201 @@
+/*****************************************************************************
+ * FILE: Governor.c                                                          *
+ * DESC: Outlet command governor                                             *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Sits between the charge policy (and the "Turn outlet ON/OFF"        *
+ *       button) and the ChargeOn module. Every command costs PulseRepeats   *
+ *       RF frames and a relay cycle, so the governor                        *
+ *         - drops commands for a state the outlet is already in (or is      *
+ *           already being switched to),                                     *
+ *         - holds the policy back until the outlet has been ON (or OFF) for *
+ *           a minimum "dwell" time, so a percentage sitting right on MIN or *
+ *           MAX, or a flickering ACLineStatus, can't make it chatter,       *
+ *         - lets an opposite request cancel a command it's holding back,    *
+ *         - rate-limits retransmits and button presses with a token bucket. *
+ *                                                                           *
+ *       This module makes no Windows API calls; the caller supplies the     *
+ *       tick counts and AC line status, and does the actual transmitting.   *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>                     // For sprintf()
+#include <string.h>                    // For memset()
+#include "Governor.h"
+
+  /* Defines */
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+static BOOL TakeToken( GOVERNOR *pGov, DWORD dwTick );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: TakeToken                                                           *
+ * DESC: Top up the token bucket, then take a token from it (if there is one)*
+ * ARGS: pGov   = Address of GOVERNOR structure                              *
+ *       dwTick = Current tick count                                         *
+ * RET:  TRUE = Got a token, FALSE = Bucket is empty                         *
+ *****************************************************************************/
+static BOOL TakeToken( GOVERNOR *pGov, DWORD dwTick )
+{
+  DWORD dwNew = (dwTick - pGov->dwRefillTick) / GOVERNOR_REFILL_MS;
+
+  if( dwNew > 0 ) {                                        // Time to add more tokens?
+    pGov->dwTokens     += dwNew;                           //  Yes (but no more than the bucket holds)
+    pGov->dwRefillTick += dwNew * GOVERNOR_REFILL_MS;
+    if( pGov->dwTokens >= GOVERNOR_BUCKET_SIZE ) {
+      pGov->dwTokens     = GOVERNOR_BUCKET_SIZE;
+      pGov->dwRefillTick = dwTick;
+    }
+  }
+
+  if( pGov->dwTokens == 0 ) {
+    return FALSE;
+  }
+  pGov->dwTokens--;
+  return TRUE;
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: Governor_Init                                                       *
+ * DESC: Start with default dwell times, a full bucket and no statistics     *
+ * ARGS: pGov   = Address of GOVERNOR structure to initialize                *
+ *       dwTick = Current tick count                                         *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Governor_Init( GOVERNOR *pGov, DWORD dwTick )
+{
+  memset( pGov, 0, sizeof(*pGov) );
+  pGov->dwMinOnMs    = GOVERNOR_MIN_ON_MS;
+  pGov->dwMinOffMs   = GOVERNOR_MIN_OFF_MS;
+  pGov->byCommanded  = GOVERNOR_NONE;
+  pGov->byDeferred   = GOVERNOR_NONE;
+  pGov->dwTokens     = GOVERNOR_BUCKET_SIZE;
+  pGov->dwRefillTick = dwTick;
+}
+
+
+/*****************************************************************************
+ * FUNC: Governor_Request                                                    *
+ * DESC: Decide whether an ON/OFF command should actually be sent            *
+ * ARGS: pGov        = Address of GOVERNOR structure                         *
+ *       byWantLine  = AC line status the command should produce (1 = ON)    *
+ *       byLine      = Current AC line status                                *
+ *       bInProgress = Is the same command already waiting to be confirmed?  *
+ *       source      = GOV_SOURCE_POLICY, GOV_SOURCE_USER or                 *
+ *                     GOV_SOURCE_SAFETY                                     *
+ *       dwTick      = Current tick count                                    *
+ * RET:  GOV_SEND  = Send the command now (it has been recorded as sent)     *
+ *       GOV_DEFER = Not yet; the outlet hasn't been in its current state    *
+ *                   for the minimum dwell time                              *
+ *       GOV_DROP  = Don't send it                                           *
+ * NOTE: The policy asks again on every battery check, so a deferred command *
+ *       is simply sent once a later request finds the dwell time is up.    *
+ *       The user's button ignores the dwell time, but not the token bucket. *
+ *       A fail-safe ON ignores both: it is never deferred or rate-limited.  *
+ *****************************************************************************/
+GOV_VERDICT Governor_Request( GOVERNOR *pGov, BYTE byWantLine, BYTE byLine, BOOL bInProgress, GOV_SOURCE source, DWORD dwTick )
+{
+  pGov->dwRequests++;
+
+  if( (pGov->byDeferred != GOVERNOR_NONE) && (pGov->byDeferred != byWantLine) ) {
+    pGov->dwCancelled++;                                   // Holding back the opposite command? It's no longer wanted
+    pGov->byDeferred = GOVERNOR_NONE;
+  }
+
+  if( bInProgress || (byLine == byWantLine) ) {            // Outlet is already there (or on its way)?
+    pGov->dwRedundant++;                                   //  Yes, nothing to do
+    pGov->byDeferred = GOVERNOR_NONE;
+    return GOV_DROP;
+  }
+
+  if( source == GOV_SOURCE_USER ) {                        // User pressed the button?
+    if( !TakeToken(pGov, dwTick) ) {                       //  Yes, pressing it over and over?
+      pGov->dwRateLimited++;                               //   Yes, ignore this press
+      return GOV_DROP;
+    }
+  }
+  else if(    (source == GOV_SOURCE_POLICY)                // Policy wants to reverse the last command
+           && (pGov->byCommanded != GOVERNOR_NONE)
+           && (pGov->byCommanded != byWantLine)
+           && (dwTick - pGov->dwCommandTick < (pGov->byCommanded ? pGov->dwMinOnMs : pGov->dwMinOffMs)) ) {
+                                                           //  before the outlet has dwelt there long enough?
+    if( pGov->byDeferred == GOVERNOR_NONE ) {              //   Yes, hold it back (counting it only once)
+      pGov->dwDeferred++;
+      pGov->byDeferred = byWantLine;
+    }
+    return GOV_DEFER;
+  }
+
+  pGov->byDeferred    = GOVERNOR_NONE;                     // Send it!
+  pGov->byCommanded   = byWantLine;
+  pGov->dwCommandTick = dwTick;
+  pGov->dwSent++;
+  return GOV_SEND;
+}
+
+
+/*****************************************************************************
+ * FUNC: Governor_AllowRetry                                                 *
+ * DESC: Decide whether a command that hasn't taken effect may be re-sent    *
+ * ARGS: pGov   = Address of GOVERNOR structure                              *
+ *       dwTick = Current tick count                                         *
+ * RET:  TRUE = Send it again now, FALSE = Not yet (ask again later)         *
+ *****************************************************************************/
+BOOL Governor_AllowRetry( GOVERNOR *pGov, DWORD dwTick )
+{
+  if( !TakeToken(pGov, dwTick) ) {
+    pGov->dwRetriesDenied++;
+    return FALSE;
+  }
+  pGov->dwRetriesSent++;
+  return TRUE;
+}
+
+
+/*****************************************************************************
+ * FUNC: Governor_Suppressed                                                 *
+ * DESC: Count the commands the governor has kept off the air                *
+ * ARGS: pGov = Address of GOVERNOR structure                                *
+ * RET:  Number of requests dropped or held back                             *
+ *****************************************************************************/
+DWORD Governor_Suppressed( const GOVERNOR *pGov )
+{
+  return pGov->dwRequests - pGov->dwSent;
+}
+
+
+/*****************************************************************************
+ * FUNC: Governor_FormatStats                                                *
+ * DESC: Describe what the governor has done                                 *
+ * ARGS: pGov     = Address of GOVERNOR structure                            *
+ *       szBuffer = Buffer (at least 300 bytes) to receive the description   *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Governor_FormatStats( const GOVERNOR *pGov, char *szBuffer )
+{
+  sprintf( szBuffer,
+           "Commands requested:\t%lu (%lu sent)\n"
+           "   Already ON/OFF:\t%lu\n"
+           "   Held for dwell time:\t%lu (%lu cancelled)\n"
+           "   Button rate-limited:\t%lu\n"
+           "Retransmits:\t\t%lu (%lu held back)",
+           (unsigned long)pGov->dwRequests,
+           (unsigned long)pGov->dwSent,
+           (unsigned long)pGov->dwRedundant,
+           (unsigned long)pGov->dwDeferred,
+           (unsigned long)pGov->dwCancelled,
+           (unsigned long)pGov->dwRateLimited,
+           (unsigned long)pGov->dwRetriesSent,
+           (unsigned long)pGov->dwRetriesDenied );
+}
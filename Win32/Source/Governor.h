@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * FILE: Governor.h                                                          *
+ * DESC: Definitions for the outlet command governor                         *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef GOVERNOR_H
+# define GOVERNOR_H                              // Prevent items below from being processed more than once
+
+    /* Defines */
+# define GOVERNOR_MIN_ON_MS     (2UL*60*1000)    // Outlet stays ON at least this long before the policy may turn it OFF
+# define GOVERNOR_MIN_OFF_MS    (2UL*60*1000)    // Outlet stays OFF at least this long before the policy may turn it ON
+# define GOVERNOR_BUCKET_SIZE   4                // Retransmits / button presses allowed in a burst
+# define GOVERNOR_REFILL_MS     30000            // ... plus one more every this many milliseconds
+# define GOVERNOR_NONE          255              // No command sent / deferred (yet)
+
+    /* Typedefs */
+  typedef enum { GOV_SOURCE_POLICY,              // 0 = Charge policy decision
+                 GOV_SOURCE_USER,                // 1 = "Turn outlet ON/OFF" button
+                 GOV_SOURCE_SAFETY               // 2 = Fail-safe ON (battery info bad or unknown)
+               } GOV_SOURCE;
+
+  typedef enum { GOV_DROP,                       // 0 = Don't send (redundant, or rate-limited)
+                 GOV_SEND,                       // 1 = Send it now
+                 GOV_DEFER                       // 2 = Not yet (minimum dwell time); ask again later
+               } GOV_VERDICT;
+
+  typedef struct {
+    DWORD dwMinOnMs;                             // Minimum ON dwell time
+    DWORD dwMinOffMs;                            // Minimum OFF dwell time
+    BYTE  byCommanded;                           // State the outlet was last told to go to (or GOVERNOR_NONE)
+    DWORD dwCommandTick;                         //  and when
+    BYTE  byDeferred;                            // Command being held back by the dwell time (or GOVERNOR_NONE)
+    DWORD dwTokens;                              // Token bucket for retransmits / button presses
+    DWORD dwRefillTick;                          //  Tick count when the bucket was last topped up
+
+    DWORD dwRequests;                            // Commands requested (by the policy or the user)
+    DWORD dwSent;                                // Commands sent
+    DWORD dwRedundant;                           // Dropped because the outlet is already (going) there
+    DWORD dwDeferred;                            // Held back by the minimum dwell time
+    DWORD dwCancelled;                           // Held-back commands cancelled by an opposite request
+    DWORD dwRateLimited;                         // Button presses dropped by the token bucket
+    DWORD dwRetriesSent;                         // Retransmits allowed
+    DWORD dwRetriesDenied;                       // Retransmits held back by the token bucket
+  } GOVERNOR;
+
+    /* Global function prototypes */
+  void        Governor_Init(        GOVERNOR *pGov, DWORD dwTick );
+  GOV_VERDICT Governor_Request(     GOVERNOR *pGov, BYTE byWantLine, BYTE byLine, BOOL bInProgress, GOV_SOURCE source, DWORD dwTick );
+  BOOL        Governor_AllowRetry(  GOVERNOR *pGov, DWORD dwTick );
+  DWORD       Governor_Suppressed(  const GOVERNOR *pGov );
+  void        Governor_FormatStats( const GOVERNOR *pGov, char *szBuffer );
+
+#endif
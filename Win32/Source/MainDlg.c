@@ -19,6 +19,7 @@
 #define MINMAX   95                         // Absolute maximum value for "Min %" spinner control
 #define MAXMIN   25                         // Absolute minimum value for "Max %" spinner control
 #define MAXMAX  100                         // Absolute maximum value for "Max %" spinner control
+#define STATS_CSV_FILE  "ChargeOn_Stats.csv" // Where LogModuleStats() writes (in the program's folder)
 
   /* Typedefs */
 
@@ -28,15 +29,149 @@ static HFONT   hFontPercent;                // Handle for font to be used in the
 static HFONT   hFontCharging;               // Handle for font to be used in the IDC_CHARGING static text control
 static BOOL    bSerialOK = FALSE;           // Is the serial port connection currently "alive"?
 static char    szTempBuffer[300];           // Used as the destination for "sprintf" calls (mostly for Message Box text)
+static BOOL    bResumed  = FALSE;           // Woke up from sleep/hibernation, and haven't yet checked the ChargeOn module?
+static BOOL    bLogStats = FALSE;           // Logging the ChargeOn module's statistics to STATS_CSV_FILE (Ctrl-Shift-M)?
 //static LOGFONT m_lfont;
 
   /* Global variables */
 BOOL bMonitorOnly = FALSE;                  // Flag to record user's choice about whether to continue even though no serial port is available
 
   /* Function prototypes */
+static void ResyncAfterResume( HWND hDlg );
+static void ResyncModule(      HWND hDlg );
+static void HandleModuleEvents( HWND hDlg );
+static void LogModuleStats(     void );
 
 /* === LOCAL FUNCTIONS ===================================================== */
 
+/*****************************************************************************
+ * FUNC: ResyncAfterResume                                                   *
+ * DESC: After the PC wakes up, make sure the ChargeOn module is still there *
+ *       and still has our outlet settings                                   *
+ * ARGS: hDlg = Handle to dialog window                                      *
+ * RET:  [None]                                                              *
+ * NOTE: Hibernation power-cycles the module (it reloads its settings from   *
+ *       EEPROM), and the USB serial port may have been closed under us.     *
+ *****************************************************************************/
+static void ResyncAfterResume( HWND hDlg )
+{
+  Policy_Resumed( &ChargePolicy );                         // Don't measure the charge slope across the sleep
+  if( !bMonitorOnly ) {                                    // Controlling the outlet?
+    ResyncModule( hDlg );                                  //  Yes (otherwise the next battery check looks for a module anyway)
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: ResyncModule                                                        *
+ * DESC: Make sure the ChargeOn module is still there and still has our      *
+ *       outlet settings                                                     *
+ * ARGS: hDlg = Handle to dialog window                                      *
+ * RET:  [None]                                                              *
+ * NOTE: A <CO_HASH> exchange checks both in a few milliseconds; the port is *
+ *       only reopened (or, failing that, every port scanned) if it fails.   *
+ *****************************************************************************/
+static void ResyncModule( HWND hDlg )
+{
+  BYTE byHash;
+
+  byHash = Serial_CheckSettingsHash( &SerialPort, (BYTE)OutletCount );
+  if( (byHash == HASH_NO_REPLY) && !SendSignal_GetResponse(&SerialPort, HEARTBEAT) ) {
+                                                           // No answer at all (not just an older sketch)?
+    CloseHandle( SerialPort.hComPort );                    //  Yes, the port probably went away; try it again
+    if( !Serial_Reopen(&SerialPort) ) {                    //   Did it come back under the same name?
+      bSerialOK = InitSerial( &SerialPort );               //    No, look on every port (this sends the settings too)
+      if( !bSerialOK ) {
+        SetWindowText( GetDlgItem(hDlg, IDC_STATUS), "Lost communication with ChargeOn module" );
+      }
+      return;
+    }
+    byHash = Serial_CheckSettingsHash( &SerialPort, (BYTE)OutletCount );
+  }
+
+  if( byHash != HASH_MATCHES ) {                           // Module lost (or can't vouch for) our settings?
+    SendOutletSettings( &SerialPort );                     //  Yes, send them again
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: HandleModuleEvents                                                  *
+ * DESC: Act on anything the ChargeOn module has told us without being asked *
+ * ARGS: hDlg = Handle to dialog window                                      *
+ * RET:  [None]                                                              *
+ * NOTE: Called every EVENT_POLL_MS (IDT_TIMER3). Looking for events costs   *
+ *       nothing on the wire, unlike a <CO_BEAT> exchange.                   *
+ *****************************************************************************/
+static void HandleModuleEvents( HWND hDlg )
+{
+  MODULE_EVENT Event;
+
+  if( !bSerialOK || bMonitorOnly || !Serial_PollEvents(&SerialPort) ) {
+    return;
+  }
+  while( Serial_NextEvent(&Event) ) {
+    switch( Event.byType ) {
+      case EVT_BOOT:                                       // Module restarted (reset, or USB power-cycled)?
+        ResyncModule( hDlg );                              //  Yes, it's back to the settings in its EEPROM
+        break;
+
+      case EVT_DEADMAN:                                    // Module turned the outlet ON by itself?
+        SetWindowText( GetDlgItem(hDlg, IDC_STATUS2), "ChargeOn module turned outlet ON (battery checks had stopped)" );
+        break;
+
+      case EVT_ERROR:
+        if( Serial_EventValue(&Event, "Err", 0) == ERR_UNKNOWN_SIGNAL ) {
+          SetWindowText( GetDlgItem(hDlg, IDC_STATUS2), "ChargeOn module sketch is out of date" );
+        }
+        else if( Serial_EventValue(&Event, "Err", 0) == ERR_SAVE_FAILED ) {
+          SetWindowText( GetDlgItem(hDlg, IDC_STATUS2), "ChargeOn module couldn't save the outlet settings (EEPROM worn out?)" );
+        }
+        break;
+
+      default:                                             // (EVT_SENT: the ON/OFF response already told us;
+        break;                                             //  EVT_LEARNED: only expected while learning a code)
+    }
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: LogModuleStats                                                      *
+ * DESC: Add a line with the ChargeOn module's statistics to STATS_CSV_FILE  *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ * NOTE: Called every STATS_POLL_MS (IDT_TIMER4) once turned on with         *
+ *       Ctrl-Shift-M. A new file gets the column names first. Skipped if    *
+ *       the module is busy or doesn't answer (it's tried again next time).  *
+ *****************************************************************************/
+static void LogModuleStats( void )
+{
+  MODULE_STATS Stats;
+  char         szFile[MAX_PATH + 20];
+  char         szLine[600];
+  FILE        *pFile;
+
+  if( !bSerialOK || bMonitorOnly || bInitializingPort || bDoingTX_RX || !Serial_GetStats(&SerialPort, &Stats) ) {
+    return;
+  }
+  sprintf( szFile, "%s\\%s", szAppFolder, STATS_CSV_FILE );
+  if( !PathFileExists(szFile) ) {                          // New file?
+    if( (pFile = fopen(szFile, "w")) == NULL ) {           //  Yes, start it with the column names
+      return;
+    }
+    Serial_FormatStatsCSV( &Stats, szLine, TRUE );
+    fputs( szLine, pFile );
+  }
+  else if( (pFile = fopen(szFile, "a")) == NULL ) {
+    return;
+  }
+  Serial_FormatStatsCSV( &Stats, szLine, FALSE );
+  fputs( szLine, pFile );
+  fclose( pFile );
+}
+
+
 /*****************************************************************************
  * FUNC: MainDialogProc                                                      *
  * DESC: Manage everything related to the main dialog box                    *
@@ -56,6 +191,7 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
       hMenu = LoadMenu( hInst, MAKEINTRESOURCE(IDM_MENU) );// Set up the main menu
       SetMenu( hDlg, hMenu );
       InitFromRegistry();                                  // Load application (and remote outlet) settings from the registry
+      Repeats_Init( &RepeatTuner, Outlet.PulseRepeats );   //  and start tuning from the user's PulseRepeats
 
       hFontPercent  = CreateFont( 24, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_SWISS, "Arial" );
       hFontCharging = CreateFont( 16, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_SWISS, "Arial" );
@@ -84,7 +220,11 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
       SetWindowPos( hDlg, HWND_TOPMOST, AppX, AppY, 1, 1, SWP_NOSIZE | SWP_NOZORDER | SWP_SHOWWINDOW );
                                                            // Set main dialog window's position and SHOW the window
       bSerialOK = InitSerial( &SerialPort );               // Look for / configure a ChargeOn hardware module (usually connected via USB)
-      if( !bSerialOK ) {                                   // Found a (connected & available) ChargeOn module?
+      if( !bSerialOK && bSimulateBattery ) {               // No ChargeOn module, but using the simulated battery?
+        bMonitorOnly = TRUE;                               //  Yes, the simulation takes the place of the outlet
+        SetWindowText( GetDlgItem(hDlg, IDC_STATUS), "Simulated battery (no ChargeOn module)" );
+      }
+      else if( !bSerialOK ) {                              // Found a (connected & available) ChargeOn module?
         int nRetval = MessageBox( hDlg,                    //  No, let user decide whether to continue or quit
                                   "ERROR: Could not find an available/suitable ChargeOn module.\n\nPress OK to monitor the battery, or Cancel to exit.",
                                   "ChargeOn Module Not Found",
@@ -104,6 +244,8 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
       }
       SetTimer(hDlg, IDT_TIMER1, CheckChargeInterval*1000, (TIMERPROC)NULL );
                                                            // Set "check battery state" timer to fire every X seconds (user-configurable)
+      SetTimer(hDlg, IDT_TIMER3, EVENT_POLL_MS, (TIMERPROC)NULL );
+                                                           // Watch for events from the ChargeOn module
 
       InitSettingsPropSheet();                             // Initialize property sheet (and pages) for Settings dialog
       RegisterHotKey( hDlg,                                // Set up "hot keys" for various special functions
@@ -114,6 +256,18 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
                       2,
                       MOD_CONTROL | MOD_SHIFT | MOD_NOREPEAT,
                       0x4F );                              //  Hotkey #2 is Ctrl-Shift-O
+      RegisterHotKey( hDlg,
+                      3,
+                      MOD_CONTROL | MOD_SHIFT | MOD_NOREPEAT,
+                      0x50 );                              //  Hotkey #3 is Ctrl-Shift-P
+      RegisterHotKey( hDlg,
+                      4,
+                      MOD_CONTROL | MOD_SHIFT | MOD_NOREPEAT,
+                      0x4C );                              //  Hotkey #4 is Ctrl-Shift-L
+      RegisterHotKey( hDlg,
+                      5,
+                      MOD_CONTROL | MOD_SHIFT | MOD_NOREPEAT,
+                      0x4D );                              //  Hotkey #5 is Ctrl-Shift-M
 
       return TRUE;
       break;  // WM_INITDIALOG
@@ -127,6 +281,14 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
             return 0;                                      //  Yes, ignore this timer tick and wait for the next one
           }
 
+          if( CheckForResume() ) {                         // Has the PC been asleep since the last check?
+            bResumed = TRUE;                               //  Yes (even if Windows didn't tell us)
+          }
+          if( bResumed ) {                                 // Just woke up?
+            bResumed = FALSE;                              //  Yes, check on the ChargeOn module before using it
+            ResyncAfterResume( hDlg );
+          }
+
           if( bMonitorOnly ) {                             // In "only monitor battery" mode?
              bSerialOK = InitSerial( &SerialPort );        //  Yes, see if a ChargeOn hardware module has been plugged in
                                                            //   (and if so - configure it)
@@ -205,7 +367,7 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
             SetWindowText( GetDlgItem(hDlg, IDC_CHARGING), szTempBuffer );
                                                            //   Display message
           }
-          if( !bMonitorOnly ) {                            // Are we only doing no-outlet-control battery monitoring?
+          if( !bMonitorOnly || bSimulateBattery ) {        // Are we only doing no-outlet-control battery monitoring?
             ProcessBatteryInfo( &SysPowStat, bCollectedInfoOK, &SerialPort );
                                                            //  No, so make decisions and take actions (if any) based on battery state
           }
@@ -213,12 +375,17 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
 
           // Regardless of whether we collected / acted on battery state info...
         if( !bMonitorOnly && !bInitializingPort ) {        // Are we in "control" mode and NOT currently initializing a serial port?
-          if( SendSignal_GetResponse(&SerialPort, HEARTBEAT) ) {
-                                                           //  Yes, were we able to send a "heartbeat" signal to the ChargeOn module
-                                                           //  and receive an appropriate response?
+          if(    Serial_HeardWithin(HEARTBEAT_IDLE_MS)     //  Yes, has the ChargeOn module answered recently, or were we
+              || SendSignal_GetResponse(&SerialPort, HEARTBEAT) ) {
+                                                           //  able to send a "heartbeat" signal to it and receive an
+                                                           //  appropriate response?
             sprintf( szTempBuffer, "Connected on %s", SerialPort.szPortName );
             SetWindowText( GetDlgItem(hDlg, IDC_STATUS), szTempBuffer );
                                                            //   Yes, display name of the serial port we're connected to
+            if( ModuleStatus.bRestarted ) {                //   Did its uptime say it has restarted?
+              ModuleStatus.bRestarted = FALSE;             //    Yes (and we missed the BOOT event); check its settings
+              ResyncModule( hDlg );
+            }
           }
           else {                                           //   No (heartbeat signal exchange failed)...
             SetWindowText( GetDlgItem(hDlg, IDC_STATUS), "Lost communication with ChargeOn module" );
@@ -229,7 +396,32 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
           }
         }
         return 0;                                          // Message was processed
-      }  // WM_TIMER
+
+        case IDT_TIMER2:                                   // Waiting for the outlet to respond to an ON/OFF command?
+          CheckActuation( &SerialPort );                   //  Yes, see if it has (or needs telling again)
+          return 0;
+
+        case IDT_TIMER3:                                   // Has the ChargeOn module told us anything?
+          HandleModuleEvents( hDlg );
+          return 0;
+
+        case IDT_TIMER4:                                   // Time to log the ChargeOn module's statistics?
+          LogModuleStats();
+          return 0;
+      }
+      return 0;                                            // Message was processed
+      break;  // WM_TIMER
+
+    case WM_POWERBROADCAST:                                // Power-related event
+      if( wParam == PBT_APMPOWERSTATUSCHANGE ) {           //  Did the AC line (or battery) status change?
+        CheckActuation( &SerialPort );                     //   Yes, that may be the outlet responding
+      }
+      else if( wParam == PBT_APMRESUMEAUTOMATIC ) {        //  Did the PC just wake up?
+        bResumed = TRUE;                                   //   Yes, check the battery (and the ChargeOn module) right away,
+        SendMessage( hDlg, WM_TIMER, IDT_TIMER1, 0 );      //    rather than up to CheckChargeInterval seconds from now
+      }
+      return TRUE;
+      break;  // WM_POWERBROADCAST
 
     case WM_NOTIFY:
     {
@@ -575,11 +767,17 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
 
         case IDC_SWITCH_OUTLET:                            // "Turn outlet ON/OFF" button
           if( HIWORD(wParam) == BN_CLICKED ) {             // Was the button clicked?
-            if( byLineStatus ) {                           //  Yes, is the outlet currently ON?
-              DisableCharging( &SerialPort );              //   Yes, turn outlet OFF
-            }
-            else {                                         //   No...
-              EnableCharging( &SerialPort );               //    Turn outlet ON
+            BYTE byWantLine = byLineStatus ? 0 : 1;        //  Yes, want the opposite of what the outlet is doing now
+
+            if( Governor_Request(&Governor, byWantLine, byLineStatus, Actuate_Busy(&Actuator, byWantLine),
+                                 GOV_SOURCE_USER, GetTickCount()) == GOV_SEND ) {
+                                                           //   Not already on its way (and not clicked too often)?
+              if( byWantLine == 0 ) {                      //    Yes, is the outlet currently ON?
+                DisableCharging( &SerialPort );            //     Yes, turn outlet OFF
+              }
+              else {                                       //     No...
+                EnableCharging( &SerialPort );             //      Turn outlet ON
+              }
             }
           }
           break;
@@ -603,18 +801,67 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
       else if( wParam == 2 ) {                             //   No, was it hotkey #2?
         SendSignal_GetResponse( &SerialPort, SHOW_OUTLET );//    Yes, tell ChargeOn module to display Outlet values
       }
+      else if( wParam == 3 ) {                             //    No, was it hotkey #3?
+        char szStats[1536];                                //     (Too long for szTempBuffer)
+
+        Predict_FormatStats( &ChargePolicy.Pred, szStats );//     Yes, show what has been learned about switching early
+        strcat( szStats, "\n\n" );                         //      and how quickly the outlet has been responding
+        Actuate_FormatStats( &Actuator, szStats + strlen(szStats) );
+        strcat( szStats, "\n\n" );                         //      and how many commands were kept off the air
+        Governor_FormatStats( &Governor, szStats + strlen(szStats) );
+        strcat( szStats, "\n\n" );                         //      and how PulseRepeats has been tuned
+        Repeats_FormatStats( &RepeatTuner, szStats + strlen(szStats) );
+        MessageBox( hDlg, szStats, "Outlet Switching Statistics", MB_OK );
+      }
+      else if( wParam == 4 ) {                             //     No, was it hotkey #4?
+        char  szLog[3072];                                 //      (Room for everything the module keeps)
+        DWORD dwLost;
+
+        if( !Serial_FetchLog(&SerialPort, szLog, sizeof(szLog), &dwLost) ) {
+                                                           //      Yes, show what the ChargeOn module has been doing
+          strcpy( szLog, "Could not fetch the log (the ChargeOn module may need a newer sketch)" );
+        }
+        else if( szLog[0] == '\0' ) {
+          strcpy( szLog, "Nothing new (or the sketch was built without PRJ_DEBUGGING)" );
+        }
+        if( dwLost ) {
+          sprintf( szLog + strlen(szLog), "\n(%lu older events were lost)", (unsigned long)dwLost );
+        }
+        MessageBox( hDlg, szLog, "ChargeOn Module Log", MB_OK );
+      }
+      else if( wParam == 5 ) {                             //      No, was it hotkey #5?
+        MODULE_STATS Stats;
+        char         szStats[1280];                        //       (Too long for szTempBuffer)
+
+        if( !Serial_GetStats(&SerialPort, &Stats) ) {      //       Yes, show how the ChargeOn module has been performing
+          MessageBox( hDlg, "Could not get statistics (the ChargeOn module may need a newer sketch)",
+                      "ChargeOn Module Statistics", MB_ICONWARNING | MB_OK );
+          break;
+        }
+        Serial_FormatStats( &Stats, szStats );
+        sprintf( szStats + strlen(szStats), "\n\n%s these to %s every %d seconds?",
+                                            bLogStats ? "Keep logging" : "Log",
+                                            STATS_CSV_FILE, STATS_POLL_MS / 1000 );
+        bLogStats = (MessageBox(hDlg, szStats, "ChargeOn Module Statistics", MB_YESNO) == IDYES);
+        if( bLogStats ) {                                  //        and log them from now on, if asked to
+          LogModuleStats();
+          SetTimer( hDlg, IDT_TIMER4, STATS_POLL_MS, (TIMERPROC)NULL );
+        }
+        else {
+          KillTimer( hDlg, IDT_TIMER4 );
+        }
+      }
       break;  // WM_HOTKEY
 
 
     case WM_CLOSE:                                         // Received message to close the main dialog
     {
-      KillTimer(hDlg, IDT_TIMER1);                         // Don't do any more battery checks
+      int nRetval = IDNO;
+
       SaveSettingsToRegistry();                            // Save ALL settings (not just UI settings) to the registry
       if( bSerialOK && (byLineStatus == 0) ) {             // ChargeOn module is connected, and battery is currently discharging?
-        int nRetval;
-      
-        if( Outlet.TurnOnBeforeQuit ) {                    //   Yes, is the "Turn outlet ON before quitting" box checked?
-          nRetval = IDYES;                                 //    Yes, remember that
+        if( Outlet.TurnOnBeforeQuit ) {                    //  Yes, is the "Turn outlet ON before quitting" box checked?
+          nRetval = IDYES;                                 //   Yes, remember that
         }
         else {
           nRetval = MessageBox( hDlg,
@@ -626,15 +873,35 @@ BOOL CALLBACK MainDialogProc( HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam
                                   "      \"Turn outlet ON before quitting\"",
                                 "BATTERY IS DISCHARGING!",
                                 MB_ICONWARNING | MB_YESNOCANCEL ); 
-                                                           //    No, let user decide whether to turn outlet on before quitting
+                                                           //   No, let user decide whether to turn outlet on before quitting
+        }
+        if( nRetval == IDCANCEL ) {                        //  User clicked "Cancel"?
+          return TRUE;                                     //   Yes, don't close the app (everything keeps running)
+        }
+      }
+
+      KillTimer(hDlg, IDT_TIMER1);                         // Closing for sure; don't do any more battery checks
+      KillTimer(hDlg, IDT_TIMER2);                         //  (or outlet checks)
+      KillTimer(hDlg, IDT_TIMER3);                         //  (or event checks)
+      KillTimer(hDlg, IDT_TIMER4);                         //  (or statistics logging)
+      if( bSerialOK ) {                                    // ChargeOn module is connected?
+        ReleaseModuleControl( &SerialPort );               //  Yes, make sure it won't switch the outlet after we've gone
+        DWORD dwOnMask = (nRetval == IDYES) ? 1 : 0;       //  Turn on the laptop's outlet if the user (or the checkbox) said "Yes",
+        DWORD dwSent, dwSeen;                              //   and any other outlets set to be turned ON before quitting,
+        BYTE  byIdx;                                       //   whether or not the laptop is charging (all in one exchange)
+
+        for( byIdx = 1; byIdx < OutletCount; byIdx++ ) {
+          if( GetOutlet(byIdx)->TurnOnBeforeQuit ) {
+            dwOnMask |= (1UL << byIdx);
+          }
         }
-        if( nRetval == IDCANCEL ) {                        //     User clicked "Cancel"?
-          return TRUE;                                     //      Yes, don't close the app
+        if( dwOnMask == 1 ) {
+          SendSignal_GetResponse( &SerialPort, TURN_ON );
         }
-        else if( nRetval == IDYES ) {                      //      No, user clicked "Yes"?
-          SendSignal_GetResponse( &SerialPort, TURN_ON );  //       Yes, turn on the outlet!
+        else if( dwOnMask ) {
+          Serial_SendBatch( &SerialPort, dwOnMask, 0, &dwSent, &dwSeen );
         }
-        CloseHandle( SerialPort.hComPort );                //     Close current COM port handle
+        CloseHandle( SerialPort.hComPort );                //  Close current COM port handle
       }
       DestroyWindow(hDlg);                                 // Send message to destroy the main dialog window
       return TRUE;
@@ -0,0 +1,316 @@
+/*****************************************************************************
+ * FILE: Policy.c                                                            *
+ * DESC: Charge policy engine                                                *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Decides whether the outlet should be turned ON or OFF, given one    *
+ *       battery sample plus the state remembered from earlier samples.      *
+ *       Makes no Win32 calls and sends nothing to the ChargeOn module; the  *
+ *       caller acts on the returned CHARGE_ACTION and reports back through  *
+ *       Policy_CommandSent().                                               *
+ *       Exactly one policy rule is compiled in (see CHARGE_POLICY in        *
+ *       Policy.h). Since it's a static function with a single caller, the   *
+ *       compiler folds it straight into Policy_Decide().                    *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <string.h>                    // For memset()
+#include "Predict.h"
+#include "Policy.h"
+
+  /* Defines */
+#define UNKNOWN_VALUE  255             // Same as UNKNOWN_STATUS / UNKNOWN_PERCENT
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+static CHARGE_ACTION BandRule(   POLICY_STATE *pState, const CHARGE_SAMPLE *pSample, int nMin, int nMax );
+static CHARGE_ACTION PolicyRule( const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: Policy_InitConfig                                                   *
+ * DESC: Populate a POLICY_CONFIG structure with the user's MIN/MAX values   *
+ *       and default values for everything else                              *
+ * ARGS: pConfig = Address of POLICY_CONFIG structure to populate            *
+ *       dwMin   = BatteryChargeMin                                          *
+ *       dwMax   = BatteryChargeMax                                          *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Policy_InitConfig( POLICY_CONFIG *pConfig, DWORD dwMin, DWORD dwMax )
+{
+  pConfig->dwMin          = dwMin;
+  pConfig->dwMax          = dwMax;
+  pConfig->dwMinSwitchMs  = POLICY_MIN_SWITCH_MS;
+  pConfig->wReadyMinute   = POLICY_READY_MINUTE;
+  pConfig->wChargeMinutes = POLICY_CHARGE_MINUTES;
+  pConfig->dwStorageLevel = POLICY_STORAGE_LEVEL;
+}
+
+
+/*****************************************************************************
+ * FUNC: Policy_InitState                                                    *
+ * DESC: Forget everything the policy has remembered / learned               *
+ * ARGS: pState = Address of POLICY_STATE structure to initialize            *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Policy_InitState( POLICY_STATE *pState )
+{
+  memset( pState, 0, sizeof(*pState) );
+  pState->nDecisionTarget = PREDICT_NO_TARGET;
+  Predict_Init( &pState->Pred );
+}
+
+
+/*****************************************************************************
+ * FUNC: Policy_Decide                                                       *
+ * DESC: Make a decision based on the latest battery sample                  *
+ * ARGS: pConfig = Address of POLICY_CONFIG structure (user settings)        *
+ *       pState  = Address of POLICY_STATE structure (updated)               *
+ *       pSample = Address of the latest battery sample                      *
+ * RET:  ACTION_NONE, ACTION_TURN_ON or ACTION_TURN_OFF                      *
+ * NOTE: If anything is "wrong" (sample is "bad" or has unknown values) the  *
+ *       decision is ALWAYS to turn the remote outlet ON, whatever policy is *
+ *       compiled in.                                                        *
+ *****************************************************************************/
+CHARGE_ACTION Policy_Decide( const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample )
+{
+  CHARGE_ACTION action;
+
+  pState->nDecisionTarget = PREDICT_NO_TARGET;
+  pState->bFailSafe       = FALSE;
+  if( pSample->bInfoIsGood ) {                             // Got battery info OK?
+    Predict_Sample( &pState->Pred, pSample->dwTick, pSample->byPct, pSample->byLine );
+                                                           //  Yes, keep learning the charge slope and actuation latency
+  }
+
+  if(    (pSample->byPct  == UNKNOWN_VALUE)                // Battery status is unknown
+      || (pSample->byLine == UNKNOWN_VALUE)                // OR AC line status is unknown
+      || !pSample->bInfoIsGood                             // OR didn't get battery info OK?
+    ) {
+    action = ACTION_TURN_ON;                               //  Yes, we'd better enable charging just in case
+    pState->bFailSafe = TRUE;                              //   (and without waiting for the governor's dwell time)
+  }
+  else {
+    action = PolicyRule( pConfig, pState, pSample );       //  No, let the policy decide
+  }
+
+  if( action == ACTION_TURN_OFF ) {
+    pState->bTurningON = FALSE;
+  }
+  else if( action == ACTION_TURN_ON ) {
+    pState->bTurningOFF = FALSE;
+  }
+  else {                                                   // Continue charging / discharging normally...
+    pState->bTurningON = pState->bTurningOFF = FALSE;
+  }
+  return action;
+}
+
+
+/*****************************************************************************
+ * FUNC: Policy_CommandSent                                                  *
+ * DESC: Tell the policy that an ON/OFF command was successfully sent to the *
+ *       ChargeOn module (whether or not Policy_Decide() asked for it)       *
+ * ARGS: pState = Address of POLICY_STATE structure                          *
+ *       action = ACTION_TURN_ON or ACTION_TURN_OFF                          *
+ *       dwTick = Current tick count (milliseconds)                          *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Policy_CommandSent( POLICY_STATE *pState, CHARGE_ACTION action, DWORD dwTick )
+{
+  BOOL bRepeat = (action == ACTION_TURN_ON)  ? pState->bTurningON
+                                             : pState->bTurningOFF;
+
+  pState->bTurningON  = (action == ACTION_TURN_ON);        // Keep (re)sending this command until the AC line changes
+  pState->bTurningOFF = (action == ACTION_TURN_OFF);
+  if( !bRepeat ) {                                         // First time this command was sent?
+    pState->dwLastCmdTick = dwTick;                        //  Yes, remember when
+    pState->bCmdSent      = TRUE;
+  }
+  Predict_CommandSent( &pState->Pred, dwTick, (action == ACTION_TURN_ON) ? 1 : 0, pState->nDecisionTarget );
+  pState->nDecisionTarget = PREDICT_NO_TARGET;
+}
+
+
+/*****************************************************************************
+ * FUNC: Policy_Resumed                                                      *
+ * DESC: Tell the policy that the PC has just woken up (from sleep or        *
+ *       hibernation)                                                        *
+ * ARGS: pState = Address of POLICY_STATE structure                          *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Policy_Resumed( POLICY_STATE *pState )
+{
+  Predict_Resumed( &pState->Pred );
+}
+
+
+/*****************************************************************************
+ * FUNC: BandRule                                                            *
+ * DESC: Plain MIN/MAX hysteresis, with ON/OFF issued early enough to        *
+ *       cover the learned actuation latency                                 *
+ * ARGS: pState  = Address of POLICY_STATE structure                         *
+ *       pSample = Address of the latest (known-good) battery sample         *
+ *       nMin    = Turn the outlet ON at or below this percentage            *
+ *       nMax    = Turn the outlet OFF at or above this percentage           *
+ * RET:  ACTION_NONE, ACTION_TURN_ON or ACTION_TURN_OFF                      *
+ *****************************************************************************/
+static CHARGE_ACTION BandRule( POLICY_STATE *pState, const CHARGE_SAMPLE *pSample, int nMin, int nMax )
+{
+  int nLead = Predict_Lead( &pState->Pred, pSample->dwTick );
+                                                           // How far will the battery move before a command takes effect?
+  int nPct  = (int)pSample->byPct * PREDICT_LEAD_SCALE;    //  (in tenths of a percentage point, as are these)
+
+  nMin *= PREDICT_LEAD_SCALE;
+  nMax *= PREDICT_LEAD_SCALE;
+  if( nLead > (nMax - nMin) / 2 ) {
+    nLead = (nMax - nMin) / 2;                             //  (Never reach across more than half of the MIN/MAX band)
+  }
+
+  if( pSample->byLine == 1 ) {                             // Currently charging?
+    pState->bNeedToNotifyAboutDischargingBelowMinimum = FALSE;
+                                                           //  Yes, clear "need to notify about discharging too far" flag (if it's set)
+    if( nPct + nLead >= nMax ) {                           //   Battery percentage matches/exceeds maximum allowed
+                                                           //    (or will, by the time the outlet actually turns OFF)?
+      pState->nDecisionTarget = nMax / PREDICT_LEAD_SCALE; //    Yes, need to disable charging
+/* KJB (11 May 2020): Do we really care about the battery charging up too far?
+      if( pSample->byPct > nMax+2 ){                       //     Have we continued to charge past the target percentage?
+        if( pState->bNeedToNotifyAboutChargingAboveMaximum ) {
+                                                           //      Yes, do we need to alert the user?
+          MessageBox( 0,                                   //       Yes, do so
+                      "Outlet has not turned off as expected.\nTry repositioning the ChargeOn module, or turn off the outlet manually.",
+                      "Outlet did not turn OFF",
+                      MB_OK | MB_ICONINFORMATION
+                    );
+          pState->bNeedToNotifyAboutChargingAboveMaximum = FALSE;
+                                                           //        Clear "need to notify about charging too far" flag
+        }
+      }  // Charging past target percentage?
+*/
+      return ACTION_TURN_OFF;
+    }
+    if( pState->bTurningOFF ) {                            //   (Still) trying to turn the outlet OFF?
+      return ACTION_TURN_OFF;                              //    Yes, need to disable charging
+    }
+  }
+  else {                                                   //  No (not currently charging)...
+    if( pState->bTurningON ) {                             //   (Still) trying to turn the outlet ON?
+      return ACTION_TURN_ON;                               //    Yes, need to enable charging
+    }
+    if( nPct - nLead <= nMin ) {                           //   Currently discharging at or below the minimum charge allowed
+                                                           //    (or will be, by the time the outlet actually turns ON)?
+      pState->nDecisionTarget = nMin / PREDICT_LEAD_SCALE; //    Yes, need to enable charging
+      return ACTION_TURN_ON;
+    }
+  }
+  return ACTION_NONE;
+}
+
+
+#if CHARGE_POLICY == POLICY_HYSTERESIS
+/*****************************************************************************
+ * FUNC: PolicyRule [HYSTERESIS]                                             *
+ * DESC: Charge up to MAX, then discharge down to MIN                        *
+ * ARGS: pConfig = Address of POLICY_CONFIG structure                        *
+ *       pState  = Address of POLICY_STATE structure                         *
+ *       pSample = Address of the latest (known-good) battery sample         *
+ * RET:  ACTION_NONE, ACTION_TURN_ON or ACTION_TURN_OFF                      *
+ *****************************************************************************/
+static CHARGE_ACTION PolicyRule( const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample )
+{
+  return BandRule( pState, pSample, (int)pConfig->dwMin, (int)pConfig->dwMax );
+}
+
+const char *Policy_Name( void ) { return "Hysteresis"; }
+
+
+#elif CHARGE_POLICY == POLICY_RATE_LIMITED
+/*****************************************************************************
+ * FUNC: PolicyRule [RATE_LIMITED]                                           *
+ * DESC: Like HYSTERESIS, but a new ON/OFF command is held back until        *
+ *       dwMinSwitchMs has passed since the previous one ... unless the      *
+ *       battery has drifted POLICY_RATE_SLACK points outside MIN/MAX        *
+ * ARGS: pConfig = Address of POLICY_CONFIG structure                        *
+ *       pState  = Address of POLICY_STATE structure                         *
+ *       pSample = Address of the latest (known-good) battery sample         *
+ * RET:  ACTION_NONE, ACTION_TURN_ON or ACTION_TURN_OFF                      *
+ *****************************************************************************/
+static CHARGE_ACTION PolicyRule( const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample )
+{
+  CHARGE_ACTION action = BandRule( pState, pSample, (int)pConfig->dwMin, (int)pConfig->dwMax );
+
+  if(    (action != ACTION_NONE)                           // Want to switch the outlet
+      && !pState->bTurningON && !pState->bTurningOFF       // AND it's a new command (not a retry)
+      && pState->bCmdSent                                  // AND the outlet has been switched before
+      && (pSample->dwTick - pState->dwLastCmdTick < pConfig->dwMinSwitchMs)
+                                                           // AND that was too recently?
+    ) {
+    if(    ((action == ACTION_TURN_ON)  && ((int)pSample->byPct > (int)pConfig->dwMin - POLICY_RATE_SLACK))
+        || ((action == ACTION_TURN_OFF) && ((int)pSample->byPct < (int)pConfig->dwMax + POLICY_RATE_SLACK)) ) {
+                                                           //  Yes, is the battery still reasonably close to MIN/MAX?
+      pState->nDecisionTarget = PREDICT_NO_TARGET;
+      action = ACTION_NONE;                                //   Yes, it can wait
+    }
+  }
+  return action;
+}
+
+const char *Policy_Name( void ) { return "Rate-limited"; }
+
+
+#elif CHARGE_POLICY == POLICY_SCHEDULE
+/*****************************************************************************
+ * FUNC: PolicyRule [SCHEDULE]                                               *
+ * DESC: Like HYSTERESIS, but during the wChargeMinutes leading up to        *
+ *       wReadyMinute the MAX is raised to 100% so the battery is full when  *
+ *       the user needs it                                                   *
+ * ARGS: pConfig = Address of POLICY_CONFIG structure                        *
+ *       pState  = Address of POLICY_STATE structure                         *
+ *       pSample = Address of the latest (known-good) battery sample         *
+ * RET:  ACTION_NONE, ACTION_TURN_ON or ACTION_TURN_OFF                      *
+ *****************************************************************************/
+static CHARGE_ACTION PolicyRule( const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample )
+{
+  int  nMinutesToReady = ((int)pConfig->wReadyMinute - (int)pSample->wMinuteOfDay + 1440) % 1440;
+  BOOL bChargeToFull   = (nMinutesToReady < (int)pConfig->wChargeMinutes);
+
+  if( bChargeToFull && (pSample->byLine == 0) && !pState->bTurningON ) {
+    pState->nDecisionTarget = PREDICT_NO_TARGET;           // Time to top up, and the battery is discharging?
+    return ACTION_TURN_ON;                                 //  Yes, start charging now
+  }
+  return BandRule( pState, pSample, (int)pConfig->dwMin, bChargeToFull ? 100 : (int)pConfig->dwMax );
+}
+
+const char *Policy_Name( void ) { return "Schedule-aware"; }
+
+
+#elif CHARGE_POLICY == POLICY_STORAGE
+/*****************************************************************************
+ * FUNC: PolicyRule [STORAGE]                                                *
+ * DESC: Ignore the user's MIN/MAX; keep the battery within                  *
+ *       POLICY_STORAGE_BAND points of dwStorageLevel                        *
+ * ARGS: pConfig = Address of POLICY_CONFIG structure                        *
+ *       pState  = Address of POLICY_STATE structure                         *
+ *       pSample = Address of the latest (known-good) battery sample         *
+ * RET:  ACTION_NONE, ACTION_TURN_ON or ACTION_TURN_OFF                      *
+ *****************************************************************************/
+static CHARGE_ACTION PolicyRule( const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample )
+{
+  return BandRule( pState,
+                   pSample,
+                   (int)pConfig->dwStorageLevel - POLICY_STORAGE_BAND,
+                   (int)pConfig->dwStorageLevel + POLICY_STORAGE_BAND );
+}
+
+const char *Policy_Name( void ) { return "Storage"; }
+
+
+#else
+# error "CHARGE_POLICY must be one of the POLICY_* values defined in Policy.h"
+#endif
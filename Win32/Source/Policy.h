@@ -0,0 +1,73 @@
+/*****************************************************************************
+ * FILE: Policy.h                                                            *
+ * DESC: Definitions for the charge policy engine                            *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Choose the policy by (re)defining CHARGE_POLICY, either here or in  *
+ *       the project's compiler options (e.g. -DCHARGE_POLICY=2)             *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef POLICY_H
+# define POLICY_H                                // Prevent items below from being processed more than once
+
+    /* Defines */
+# define POLICY_HYSTERESIS    1                  // Charge to MAX, discharge to MIN (the original ChargeOn behavior)
+# define POLICY_RATE_LIMITED  2                  // Hysteresis, but don't switch the outlet more often than every X minutes
+# define POLICY_SCHEDULE      3                  // Hysteresis, but charge to 100% ahead of a daily "ready" time
+# define POLICY_STORAGE       4                  // Hold the battery in a narrow band around a storage level
+
+# ifndef CHARGE_POLICY
+#  define CHARGE_POLICY       POLICY_HYSTERESIS  // Policy compiled into the program
+# endif
+
+# define POLICY_MIN_SWITCH_MS (30UL*60*1000)     // [RATE_LIMITED] Minimum time between automatic ON/OFF commands
+# define POLICY_RATE_SLACK    5                  // [RATE_LIMITED] ... unless the battery is this far outside MIN/MAX
+# define POLICY_READY_MINUTE  (7*60)             // [SCHEDULE]     Battery should be full at 07:00 local time
+# define POLICY_CHARGE_MINUTES (3*60)            // [SCHEDULE]     Start charging to 100% this long beforehand
+# define POLICY_STORAGE_LEVEL 50                 // [STORAGE]      Storage level (percent)
+# define POLICY_STORAGE_BAND  3                  // [STORAGE]      Allowed drift either side of the storage level
+
+    /* Typedefs */
+  typedef enum { ACTION_NONE,                    // 0 = Keep charging / discharging as we are
+                 ACTION_TURN_ON,                 // 1 = Turn the outlet ON
+                 ACTION_TURN_OFF                 // 2 = Turn the outlet OFF
+               } CHARGE_ACTION;
+
+  typedef struct {                               // One battery check, as collected by the caller
+    DWORD dwTick;                                // Tick count (milliseconds) when the sample was taken
+    WORD  wMinuteOfDay;                          // Local time of day, in minutes since midnight (0-1439)
+    BOOL  bInfoIsGood;                           // Did the sample come from a successful CollectBatteryInfo() call?
+    BYTE  byPct;                                 // SYSTEM_POWER_STATUS.BatteryLifePercent
+    BYTE  byLine;                                // SYSTEM_POWER_STATUS.ACLineStatus
+  } CHARGE_SAMPLE;
+
+  typedef struct {                               // User-configurable inputs to the policy
+    DWORD dwMin;                                 // BatteryChargeMin
+    DWORD dwMax;                                 // BatteryChargeMax
+    DWORD dwMinSwitchMs;                         // [RATE_LIMITED]
+    WORD  wReadyMinute;                          // [SCHEDULE]
+    WORD  wChargeMinutes;                        // [SCHEDULE]
+    DWORD dwStorageLevel;                        // [STORAGE]
+  } POLICY_CONFIG;
+
+  typedef struct {                               // Everything the policy remembers between samples
+    BOOL      bTurningON;                        // In the process of turning the outlet ON?
+    BOOL      bTurningOFF;                       // In the process of turning the outlet OFF?
+    BOOL      bNeedToNotifyAboutDischargingBelowMinimum;
+    int       nDecisionTarget;                   // MIN/MAX target behind the most recent decision (or PREDICT_NO_TARGET)
+    BOOL      bFailSafe;                         // Most recent decision was ON because the sample was bad or unknown
+    DWORD     dwLastCmdTick;                     // Tick count when the outlet was last asked to change state
+    BOOL      bCmdSent;                          // Has any command been sent yet?
+    PREDICTOR Pred;                              // Learned actuation latency / charge slope
+  } POLICY_STATE;
+
+    /* Global function prototypes */
+  void          Policy_InitConfig(  POLICY_CONFIG *pConfig, DWORD dwMin, DWORD dwMax );
+  void          Policy_InitState(   POLICY_STATE  *pState );
+  CHARGE_ACTION Policy_Decide(      const POLICY_CONFIG *pConfig, POLICY_STATE *pState, const CHARGE_SAMPLE *pSample );
+  void          Policy_CommandSent( POLICY_STATE  *pState,  CHARGE_ACTION action, DWORD dwTick );
+  void          Policy_Resumed(     POLICY_STATE  *pState );
+  const char   *Policy_Name(        void );
+
+#endif
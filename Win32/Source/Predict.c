@@ -0,0 +1,356 @@
+/*****************************************************************************
+ * FILE: Predict.c                                                           *
+ * DESC: Latency-compensating outlet switching                               *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Learns how long it takes for an ON/OFF command to show up as an AC  *
+ *       line change (RF transmit + outlet relay + Windows power status      *
+ *       refresh) and how fast the battery percentage is currently moving.   *
+ *       ProcessBatteryInfo() uses the product of the two to issue OFF/ON a  *
+ *       little early, so the actual turnaround lands on the MAX/MIN target. *
+ *       Also learns how late BatteryLifePercent shows each change, since    *
+ *       Windows only refreshes it every so often.                           *
+ *       Contains no Win32 calls; the caller supplies the tick count.        *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>                     // For sprintf()
+#include <string.h>                    // For memset()
+#include "Predict.h"
+
+  /* Defines */
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+static void LearnReportLag(  PREDICTOR *pPred, DWORD dwTick );
+static void RecordOvershoot( PREDICTOR *pPred );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: Predict_Init                                                        *
+ * DESC: Reset everything the predictor has learned                          *
+ * ARGS: pPred = Address of PREDICTOR structure to initialize                *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Predict_Init( PREDICTOR *pPred )
+{
+  memset( pPred, 0, sizeof(*pPred) );
+  pPred->byLastPct  = PREDICT_UNKNOWN;
+  pPred->byLastLine = PREDICT_UNKNOWN;
+  pPred->nTarget    = PREDICT_NO_TARGET;
+}
+
+
+/*****************************************************************************
+ * FUNC: Predict_Sample                                                      *
+ * DESC: Feed the latest battery percentage / AC line status to the         *
+ *       predictor; updates the learned slope, the learned actuation latency *
+ *       and report lag, and the overshoot statistics                        *
+ * ARGS: pPred  = Address of PREDICTOR structure                             *
+ *       dwTick = Current tick count (milliseconds)                          *
+ *       byPct  = Battery percentage as reported by Windows                  *
+ *       byLine = AC line status as reported by Windows                      *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Predict_Sample( PREDICTOR *pPred, DWORD dwTick, BYTE byPct, BYTE byLine )
+{
+  if( (byPct == PREDICT_UNKNOWN) || (byLine == PREDICT_UNKNOWN) ) {
+    return;                                                // Nothing useful to learn from an "unknown" sample
+  }
+
+  if( pPred->byLastPct != PREDICT_UNKNOWN ) {              // Not the first sample?
+    DWORD dwPoll = dwTick - pPred->dwLastTick;             //  Yes, keep track of how often they come
+
+    pPred->dwPollMs = pPred->dwPollMs ? ((pPred->dwPollMs * (PREDICT_POLL_WEIGHT-1)) + dwPoll) / PREDICT_POLL_WEIGHT
+                                      : dwPoll;
+    if( byPct != pPred->byLastPct ) {                      //  Did the percentage just change?
+      LearnReportLag( pPred, dwTick );                     //   Yes, Windows must have refreshed it
+      pPred->bChangeSeen  = TRUE;
+      pPred->dwChangeTick = dwTick;
+    }
+  }
+  pPred->dwLastTick = dwTick;
+
+  if( byLine != pPred->byLastLine ) {                      // Did the AC line just change state?
+    pPred->bAnchored   = FALSE;                            //  Yes, the old slope no longer applies
+    pPred->bSlopeKnown = FALSE;
+    if( pPred->bCmdPending && (byLine == pPred->byCmdLine) ) {
+                                                           //   Were we waiting for exactly this change?
+      DWORD dwLatency = dwTick - pPred->dwCmdTick;         //    Yes, we now know how long it took
+
+      if( dwLatency < PREDICT_MAX_LATENCY_MS ) {
+        if( pPred->dwLatencySamples == 0 ) {               //     First measurement?
+          pPred->dwLatencyMs = dwLatency;                  //      Yes, take it as-is
+        }
+        else {                                             //      No, blend it in with what we already know
+          pPred->dwLatencyMs = (  (pPred->dwLatencyMs * (PREDICT_LATENCY_WEIGHT-1))
+                                + dwLatency ) / PREDICT_LATENCY_WEIGHT;
+        }
+        pPred->dwLatencySamples++;
+      }
+      pPred->bCmdPending = FALSE;
+    }
+  }
+  else if( byPct != pPred->byLastPct ) {                   //  No, did the battery percentage change?
+    if( pPred->bAnchored && (dwTick != pPred->dwAnchorTick) ) {
+                                                           //   Yes, is there an earlier change (same direction) to measure from?
+      double dSlope = ((double)byPct - (double)pPred->byAnchorPct) / (double)(dwTick - pPred->dwAnchorTick);
+
+      if( (byLine ? (dSlope > 0) : (dSlope < 0)) ) {       //    Yes, does the slope point the expected way?
+        if( !pPred->bSlopeKnown ) {                        //     Yes, first measurement in this direction?
+          pPred->dSlope      = dSlope;                     //      Yes, take it as-is
+          pPred->bSlopeKnown = TRUE;
+        }
+        else {                                             //      No, blend it in with what we already know
+          pPred->dSlope = ((pPred->dSlope * (PREDICT_SLOPE_WEIGHT-1)) + dSlope) / PREDICT_SLOPE_WEIGHT;
+        }
+      }
+    }
+    pPred->bAnchored    = TRUE;                            //   Measure the next slope from this change
+    pPred->byAnchorPct  = byPct;
+    pPred->dwAnchorTick = dwTick;
+  }
+
+  if( pPred->nTarget != PREDICT_NO_TARGET ) {              // Is a MIN/MAX turnaround being tracked?
+    if( pPred->byExtremePct == PREDICT_UNKNOWN ) {         //  Yes, first known percentage since the command?
+      pPred->byExtremePct = byPct;                         //   Yes, start from here
+    }
+    if( pPred->byTargetLine == 0 ) {                       //  Turned OFF at MAX?
+      if( byPct > pPred->byExtremePct ) {                  //   Yes, still climbing?
+        pPred->byExtremePct = byPct;                       //    Yes, remember the peak
+      }
+      else if( (byLine == 0) && (byPct < pPred->byExtremePct) ) {
+        RecordOvershoot( pPred );                          //    No, discharging below the peak; the turnaround is complete
+      }
+    }
+    else {                                                 //  No, turned ON at MIN...
+      if( byPct < pPred->byExtremePct ) {                  //   Still dropping?
+        pPred->byExtremePct = byPct;                       //    Yes, remember the trough
+      }
+      else if( (byLine == 1) && (byPct > pPred->byExtremePct) ) {
+        RecordOvershoot( pPred );                          //    No, charging above the trough; the turnaround is complete
+      }
+    }
+  }
+
+  pPred->byLastPct  = byPct;
+  pPred->byLastLine = byLine;
+}
+
+
+/*****************************************************************************
+ * FUNC: Predict_CommandSent                                                 *
+ * DESC: Tell the predictor that an ON/OFF command was just sent             *
+ * ARGS: pPred   = Address of PREDICTOR structure                            *
+ *       dwTick  = Current tick count (milliseconds)                         *
+ *       byLine  = AC line status the command should produce (1=ON, 0=OFF)   *
+ *       nTarget = BatteryChargeMax (OFF) / BatteryChargeMin (ON) the        *
+ *                 command was aimed at, or PREDICT_NO_TARGET                *
+ * RET:  [None]                                                              *
+ * NOTE: ProcessBatteryInfo() re-sends the same command on every tick until  *
+ *       the AC line changes; only the FIRST one starts the latency clock.   *
+ *****************************************************************************/
+void Predict_CommandSent( PREDICTOR *pPred, DWORD dwTick, BYTE byLine, int nTarget )
+{
+  if( pPred->bCmdPending && (pPred->byCmdLine == byLine) ) {
+    return;                                                // Just a repeat of the command we're already timing
+  }
+
+  if( pPred->nTarget != PREDICT_NO_TARGET ) {              // Was the previous turnaround still being tracked?
+    RecordOvershoot( pPred );                              //  Yes, close it out now
+  }
+
+  pPred->bCmdPending  = (byLine != pPred->byLastLine);     // (No AC line change to wait for if it's already there)
+  pPred->byCmdLine    = byLine;
+  pPred->dwCmdTick    = dwTick;
+  pPred->nTarget      = nTarget;
+  pPred->byTargetLine = byLine;
+  pPred->byExtremePct = pPred->byLastPct;
+}
+
+
+/*****************************************************************************
+ * FUNC: Predict_Resumed                                                     *
+ * DESC: Tell the predictor that the PC has just woken up                    *
+ * ARGS: pPred = Address of PREDICTOR structure                              *
+ * RET:  [None]                                                              *
+ * NOTE: The battery hardly moves while the PC is asleep, so neither a slope *
+ *       nor a latency measured across the sleep would mean anything.        *
+ *****************************************************************************/
+void Predict_Resumed( PREDICTOR *pPred )
+{
+  pPred->bAnchored   = FALSE;                              // Measure the next slope from the next change
+  pPred->bChangeSeen = FALSE;                              //  (and the next refresh period)
+  pPred->byLastPct   = PREDICT_UNKNOWN;                    //  (and the time between samples)
+  pPred->bCmdPending = FALSE;                              // Don't time a command that was sent before the sleep
+}
+
+
+/*****************************************************************************
+ * FUNC: Predict_Latency                                                     *
+ * DESC: How long does the outlet usually take to switch?                    *
+ * ARGS: pPred = Address of PREDICTOR structure                              *
+ * RET:  Learned actuation latency (milliseconds), or 0 if not known yet     *
+ * NOTE: For the actuator's retransmit window, so the two never disagree.    *
+ *****************************************************************************/
+DWORD Predict_Latency( const PREDICTOR *pPred )
+{
+  return pPred->dwLatencySamples ? pPred->dwLatencyMs : 0;
+}
+
+
+/*****************************************************************************
+ * FUNC: Predict_Lead                                                        *
+ * DESC: How far past the reported percentage (in its current direction)     *
+ *       will the battery be by the time a command sent now takes effect?    *
+ * ARGS: pPred  = Address of PREDICTOR structure                             *
+ *       dwTick = Current tick count (milliseconds)                          *
+ * RET:  Tenths of a percentage point (see PREDICT_LEAD_SCALE; 0 until both  *
+ *       slope and latency have been learned)                                *
+ * NOTE: A typical lead is well under one percentage point, which rounding   *
+ *       to whole points would throw away. So the lead also counts how far   *
+ *       the battery has moved since the reported percentage last changed    *
+ *       (at most one point, plus the learned report lag), and the caller    *
+ *       compares in tenths.                                                 *
+ *****************************************************************************/
+int Predict_Lead( const PREDICTOR *pPred, DWORD dwTick )
+{
+  double dSpeed;                                           // Percentage points per millisecond, in the current direction
+  double dLead;
+  double dStep;
+
+  if( !pPred->bSlopeKnown || (pPred->dwLatencySamples == 0) ) {
+    return 0;                                              // Don't guess; behave exactly like the plain hysteresis
+  }
+
+  dSpeed = (pPred->dSlope < 0) ? -pPred->dSlope : pPred->dSlope;
+  dLead  = dSpeed * (double)pPred->dwLatencyMs;            // Percentage points covered during one actuation latency
+  if( pPred->bAnchored ) {                                 // Plus the part of a point covered since the last change
+    dStep = dSpeed * (double)(dwTick - pPred->dwAnchorTick);
+    dLead += (dStep < 1.0) ? dStep : 1.0;
+    dLead += dSpeed * (double)pPred->dwReportLagMs;        //  (which Windows showed this late)
+  }
+  return (int)(dLead * PREDICT_LEAD_SCALE + 0.5);          // Round to the nearest tenth
+}
+
+
+/*****************************************************************************
+ * FUNC: Predict_FormatStats                                                 *
+ * DESC: Describe what has been learned, and how close turnarounds have come *
+ *       to their targets                                                    *
+ * ARGS: pPred    = Address of PREDICTOR structure                           *
+ *       szBuffer = Buffer (at least 450 bytes) to receive the description   *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Predict_FormatStats( const PREDICTOR *pPred, char *szBuffer )
+{
+  sprintf( szBuffer,
+           "Learned actuation latency:\t%lu ms (%lu samples)\n"
+           "Learned refresh period:\t%lu ms (so changes show %lu ms late; %lu samples)\n"
+           "Current charge slope:\t%+.1f %% per hour\n"
+           "Current lead:\t\t%.1f %%\n\n"
+           "Turnarounds at MAX:\t%lu\n"
+           "   Average overshoot:\t%+.1f %%\n"
+           "   Worst overshoot:\t%+d %%\n\n"
+           "Turnarounds at MIN:\t%lu\n"
+           "   Average undershoot:\t%+.1f %%\n"
+           "   Worst undershoot:\t%+d %%",
+           (unsigned long)pPred->dwLatencyMs,
+           (unsigned long)pPred->dwLatencySamples,
+           (unsigned long)pPred->dwRefreshMs,
+           (unsigned long)pPred->dwReportLagMs,
+           (unsigned long)pPred->dwReportLagSamples,
+           pPred->bSlopeKnown ? pPred->dSlope * 3600000.0 : 0.0,
+           (double)Predict_Lead( pPred, pPred->dwAnchorTick ) / PREDICT_LEAD_SCALE,
+           (unsigned long)pPred->osMax.dwCount,
+           pPred->osMax.dwCount ? (double)pPred->osMax.lTotal / pPred->osMax.dwCount : 0.0,
+           pPred->osMax.nWorst,
+           (unsigned long)pPred->osMin.dwCount,
+           pPred->osMin.dwCount ? (double)pPred->osMin.lTotal / pPred->osMin.dwCount : 0.0,
+           pPred->osMin.nWorst );
+}
+
+
+/*****************************************************************************
+ * FUNC: LearnReportLag                                                      *
+ * DESC: Learn how often Windows refreshes the reported percentage, and so   *
+ *       how late each change shows up                                       *
+ * ARGS: pPred  = Address of PREDICTOR structure                             *
+ *       dwTick = Tick count of the sample whose percentage just changed     *
+ * RET:  [None]                                                              *
+ * NOTE: The percentage only changes when Windows refreshes it, so the time  *
+ *       between any two changes is a whole number of refresh periods (give *
+ *       or take one sample). The refresh period is the largest time that    *
+ *       divides them all, found the way Euclid finds a greatest common      *
+ *       divisor, but allowing for that slack. If it comes out no bigger     *
+ *       than the slack, Windows refreshes about as often as we look.        *
+ *       A change is seen anywhere from 0 to one refresh period plus one     *
+ *       sample after the charge crosses the point: half that, on average.   *
+ *****************************************************************************/
+static void LearnReportLag( PREDICTOR *pPred, DWORD dwTick )
+{
+  DWORD dwGap  = dwTick - pPred->dwChangeTick;
+  DWORD dwSlack = pPred->dwPollMs;
+  DWORD dwA;
+  DWORD dwB;
+  DWORD dwRem;
+
+  if( !pPred->bChangeSeen || (dwGap > PREDICT_MAX_REFRESH_MS) ) {
+    return;                                                // (Nothing to measure from)
+  }
+
+  if( pPred->dwRefreshMs == 0 ) {                          // First gap?
+    pPred->dwRefreshMs = dwGap;                            //  Yes, it's a whole number of refresh periods
+  }
+  else {                                                   //  No, find the largest period that divides both
+    dwA = (pPred->dwRefreshMs > dwGap) ? pPred->dwRefreshMs : dwGap;
+    dwB = (pPred->dwRefreshMs > dwGap) ? dwGap : pPred->dwRefreshMs;
+    while( dwB > dwSlack ) {
+      dwRem = dwA % dwB;
+      if( (dwRem <= dwSlack) || (dwB - dwRem <= dwSlack) ) {
+        break;                                             //  (dwB divides dwA, near enough)
+      }
+      dwA = dwB;
+      dwB = dwRem;
+    }
+    pPred->dwRefreshMs = (dwB > dwSlack) ? dwB : dwSlack;  //  (or they have no common period longer than one sample)
+  }
+  pPred->dwReportLagMs = (pPred->dwRefreshMs + pPred->dwPollMs) / 2;
+  pPred->dwReportLagSamples++;
+}
+
+
+/*****************************************************************************
+ * FUNC: RecordOvershoot                                                     *
+ * DESC: Add the turnaround currently being tracked to the statistics        *
+ * ARGS: pPred = Address of PREDICTOR structure                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void RecordOvershoot( PREDICTOR *pPred )
+{
+  OVERSHOOT_STATS *pStats;
+  int              nOvershoot;
+
+  if( pPred->byExtremePct != PREDICT_UNKNOWN ) {           // Did we see at least one sample after the command?
+    if( pPred->byTargetLine == 0 ) {                       //  Yes, turnaround at MAX?
+      pStats     = &pPred->osMax;                          //   Yes, went this far past MAX
+      nOvershoot = (int)pPred->byExtremePct - pPred->nTarget;
+    }
+    else {                                                 //   No, turnaround at MIN; went this far below MIN
+      pStats     = &pPred->osMin;
+      nOvershoot = pPred->nTarget - (int)pPred->byExtremePct;
+    }
+    if( (pStats->dwCount == 0) || (nOvershoot > pStats->nWorst) ) {
+      pStats->nWorst = nOvershoot;
+    }
+    pStats->lTotal += nOvershoot;
+    pStats->dwCount++;
+  }
+  pPred->nTarget = PREDICT_NO_TARGET;                      // Done with this turnaround
+}
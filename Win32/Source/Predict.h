@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * FILE: Predict.h                                                           *
+ * DESC: Definitions for latency-compensating outlet switching               *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef PREDICT_H
+# define PREDICT_H                               // Prevent items below from being processed more than once
+
+    /* Defines */
+# define PREDICT_UNKNOWN        255              // Same as UNKNOWN_STATUS / UNKNOWN_PERCENT
+# define PREDICT_NO_TARGET      (-1)             // Command was not issued to hit a MIN/MAX target (e.g. user clicked the button)
+# define PREDICT_LATENCY_WEIGHT 4                // Smoothing factor for learned latency   (new value counts 1/4)
+# define PREDICT_SLOPE_WEIGHT   4                // Smoothing factor for learned slope     (new value counts 1/4)
+# define PREDICT_POLL_WEIGHT    8                // Smoothing factor for time between samples (new value counts 1/8)
+# define PREDICT_MAX_LATENCY_MS (10UL*60*1000)   // Ignore "latencies" longer than this (outlet was probably switched by hand)
+# define PREDICT_MAX_REFRESH_MS (10UL*60*1000)   // Ignore gaps between percentage changes longer than this
+# define PREDICT_LEAD_SCALE     10               // Predict_Lead() is in tenths of a percentage point
+
+    /* Typedefs */
+  typedef struct {                               // Overshoot statistics for one kind of turnaround (at MAX or at MIN)
+    DWORD dwCount;                               // Number of turnarounds measured
+    long  lTotal;                                // Sum of all overshoots (percentage points; negative = stopped short)
+    int   nWorst;                                // Largest single overshoot (percentage points)
+  } OVERSHOOT_STATS;
+
+  typedef struct {
+    BYTE            byLastPct;                   // Battery percentage at the previous sample
+    BYTE            byLastLine;                  // AC line status at the previous sample
+    BOOL            bAnchored;                   // Has the percentage changed at least once in the current direction?
+    BYTE            byAnchorPct;                 //  Yes, percentage at that change
+    DWORD           dwAnchorTick;                //       and the tick count when it happened
+    double          dSlope;                      // Smoothed charge slope, in percentage points per millisecond
+                                                 //  (positive while charging, negative while discharging)
+    BOOL            bSlopeKnown;                 // Has at least one slope measurement been made in the current direction?
+    DWORD           dwLastTick;                  // Tick count at the previous sample
+    DWORD           dwPollMs;                    // Smoothed time between samples (CheckChargeInterval)
+    BOOL            bChangeSeen;                 // Has the percentage changed (in either direction)?
+    DWORD           dwChangeTick;                //  Yes, tick count when it last did
+    DWORD           dwRefreshMs;                 // Learned BatteryLifePercent refresh period (0 = not yet known)
+    DWORD           dwReportLagMs;               //  and the average lag it causes (charge crosses a point -> we see it)
+    DWORD           dwReportLagSamples;          // Number of gaps between changes measured so far
+
+    BOOL            bCmdPending;                 // Waiting for the AC line to reflect the most recent ON/OFF command?
+    BYTE            byCmdLine;                   // AC line status the pending command should produce
+    DWORD           dwCmdTick;                   // Tick count when the pending command was first sent
+    DWORD           dwLatencyMs;                 // Learned actuation latency (command sent -> AC line change observed)
+    DWORD           dwLatencySamples;            // Number of latency measurements made so far
+
+    int             nTarget;                     // MIN/MAX percentage the current turnaround was aimed at
+    BYTE            byTargetLine;                // AC line status the turnaround was aimed at
+    BYTE            byExtremePct;                // Highest (after OFF) or lowest (after ON) percentage since the command
+    OVERSHOOT_STATS osMax;                       // Overshoot past BatteryChargeMax
+    OVERSHOOT_STATS osMin;                       // Undershoot past BatteryChargeMin
+  } PREDICTOR;
+
+    /* Global function prototypes */
+  void  Predict_Init(        PREDICTOR *pPred );
+  void  Predict_Sample(      PREDICTOR *pPred, DWORD dwTick, BYTE byPct,  BYTE byLine );
+  void  Predict_CommandSent( PREDICTOR *pPred, DWORD dwTick, BYTE byLine, int  nTarget );
+  void  Predict_Resumed(     PREDICTOR *pPred );
+  int   Predict_Lead(        const PREDICTOR *pPred, DWORD dwTick );
+  DWORD Predict_Latency(     const PREDICTOR *pPred );
+  void  Predict_FormatStats( const PREDICTOR *pPred, char *szBuffer );
+
+#endif
@@ -0,0 +1,163 @@
+/*****************************************************************************
+ * FILE: Repeats.c                                                           *
+ * DESC: PulseRepeats self-tuner                                             *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Every ON/OFF command is sent PulseRepeats times in a row, and the   *
+ *       ChargeOn module can't do anything else while it's transmitting. A   *
+ *       module sitting right next to the outlet needs far fewer repeats     *
+ *       than one at the other end of the house, so instead of relying on    *
+ *       the value entered by the user, watch how each command turns out:    *
+ *         - If it needed retransmitting, step PulseRepeats up, and don't go *
+ *           back down that far again (at least, not for a good while).      *
+ *         - After a run of first-try successes, step it down by one.        *
+ *       If the ChargeOn module heard every transmission of a command on the *
+ *       air (RF loopback), a retransmit wasn't down to lost RF frames (the  *
+ *       outlet was just slow), so it doesn't count.                         *
+ *                                                                           *
+ *       This module makes no Windows API calls; the caller sends the new    *
+ *       value to the ChargeOn module.                                       *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>                     // For sprintf()
+#include <string.h>                    // For memset()
+#include "Repeats.h"
+
+  /* Defines */
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: Repeats_Init                                                        *
+ * DESC: Start tuning from a given PulseRepeats value                        *
+ * ARGS: pTune     = Address of REPEAT_TUNER structure to initialize         *
+ *       dwRepeats = Current PulseRepeats setting                            *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Repeats_Init( REPEAT_TUNER *pTune, DWORD dwRepeats )
+{
+  memset( pTune, 0, sizeof(*pTune) );
+  pTune->dwRepeats = dwRepeats;
+  pTune->dwFloor   = REPEATS_MIN;
+}
+
+
+/*****************************************************************************
+ * FUNC: Repeats_Confirmed                                                   *
+ * DESC: Learn from a command that has (finally) switched the outlet         *
+ * ARGS: pTune      = Address of REPEAT_TUNER structure                      *
+ *       dwRepeats  = PulseRepeats setting the command was sent with         *
+ *       dwAttempts = Number of times the command had to be sent             *
+ *       dwHeard    = How many of those the ChargeOn module heard on the air *
+ *       dwMissed   =  and didn't (those it couldn't tell about are neither) *
+ * RET:  PulseRepeats to use from now on (may be the same as dwRepeats)      *
+ * NOTE: If the user has changed PulseRepeats by hand, tuning starts over    *
+ *       from their value. If the new value can't be sent to the ChargeOn    *
+ *       module, call Repeats_Rejected().                                    *
+ *****************************************************************************/
+DWORD Repeats_Confirmed( REPEAT_TUNER *pTune, DWORD dwRepeats, DWORD dwAttempts, DWORD dwHeard, DWORD dwMissed )
+{
+  if( dwRepeats != pTune->dwRepeats ) {                    // Setting changed behind our back?
+    pTune->dwRepeats = dwRepeats;                          //  Yes, start over from the new value
+    pTune->dwFloor   = REPEATS_MIN;
+    pTune->dwStreak  = 0;
+  }
+  pTune->nLastChange = 0;
+
+  if( (dwAttempts > 1) && (dwHeard == dwAttempts) && (dwMissed == 0) ) {
+    pTune->dwHeardRetried++;                               // Resent, but every transmission went out fine? Nothing to learn
+  }
+  else if( dwAttempts > 1 ) {                              // First transmission wasn't enough?
+    pTune->dwRetried++;                                    //  Yes, this many repeats is too few
+    pTune->dwStreak = 0;
+    if( (pTune->dwFloor <= dwRepeats) && (dwRepeats < REPEATS_MAX) ) {
+      pTune->dwFloor = dwRepeats + 1;
+    }
+    if( pTune->dwRepeats < REPEATS_MAX ) {
+      pTune->dwRepeats += REPEATS_RAISE_BY;
+      if( pTune->dwRepeats > REPEATS_MAX ) {
+        pTune->dwRepeats = REPEATS_MAX;
+      }
+      pTune->dwRaised++;
+      pTune->nLastChange = 1;
+    }
+  }
+  else {
+    pTune->dwFirstTry++;
+    pTune->dwStreak++;
+    if(    (pTune->dwStreak >= REPEATS_RETRY_FLOOR)        // Been working first time for a long while?
+        && (pTune->dwFloor > REPEATS_MIN) ) {
+      pTune->dwFloor--;                                    //  Yes, the failure that set the floor may have been a fluke
+    }
+    if(    (pTune->dwStreak >= REPEATS_LOWER_AFTER)        // Worked first time often enough to try fewer repeats?
+        && (pTune->dwRepeats > pTune->dwFloor) ) {
+      pTune->dwRepeats--;                                  //  Yes, one fewer
+      pTune->dwStreak = 0;
+      pTune->dwLowered++;
+      pTune->nLastChange = -1;
+    }
+  }
+
+  if( pTune->dwRepeats < REPEATS_MIN ) {                   // Keep within safe bounds (even if the user didn't)
+    pTune->dwRepeats = REPEATS_MIN;
+  }
+  return pTune->dwRepeats;
+}
+
+
+/*****************************************************************************
+ * FUNC: Repeats_Rejected                                                    *
+ * DESC: The value from Repeats_Confirmed() couldn't be sent to the ChargeOn *
+ *       module, so go back to the one it still has                          *
+ * ARGS: pTune     = Address of REPEAT_TUNER structure                       *
+ *       dwRepeats = PulseRepeats setting still in use                       *
+ * RET:  [None]                                                              *
+ * NOTE: What was learned (the floor, the counts) is kept; only the change   *
+ *       is undone, so it will be made again next time if it's still due.    *
+ *****************************************************************************/
+void Repeats_Rejected( REPEAT_TUNER *pTune, DWORD dwRepeats )
+{
+  if( pTune->nLastChange > 0 ) {
+    pTune->dwRaised--;
+  }
+  else if( pTune->nLastChange < 0 ) {
+    pTune->dwLowered--;
+  }
+  pTune->nLastChange = 0;
+  pTune->dwRepeats   = dwRepeats;
+}
+
+
+/*****************************************************************************
+ * FUNC: Repeats_FormatStats                                                 *
+ * DESC: Describe what the tuner has done                                    *
+ * ARGS: pTune    = Address of REPEAT_TUNER structure                        *
+ *       szBuffer = Buffer (at least 250 bytes) to receive the description   *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Repeats_FormatStats( const REPEAT_TUNER *pTune, char *szBuffer )
+{
+  sprintf( szBuffer,
+           "Pulse repeats:\t\t%lu (lowest safe: %lu)\n"
+           "   Worked first time:\t%lu\n"
+           "   Needed resending:\t%lu (and %lu heard on the air)\n"
+           "   Raised / lowered:\t%lu / %lu",
+           (unsigned long)pTune->dwRepeats,
+           (unsigned long)pTune->dwFloor,
+           (unsigned long)pTune->dwFirstTry,
+           (unsigned long)pTune->dwRetried,
+           (unsigned long)pTune->dwHeardRetried,
+           (unsigned long)pTune->dwRaised,
+           (unsigned long)pTune->dwLowered );
+}
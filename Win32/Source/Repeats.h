@@ -0,0 +1,41 @@
+/*****************************************************************************
+ * FILE: Repeats.h                                                           *
+ * DESC: Definitions for the PulseRepeats self-tuner                         *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef REPEATS_H
+# define REPEATS_H                               // Prevent items below from being processed more than once
+
+    /* Defines */
+# define REPEATS_MIN            2                // Never send fewer RF frames per command than this
+# define REPEATS_MAX            20               //  or more than this
+# define REPEATS_RAISE_BY       2                // Step up this much when a command needed retransmitting
+# define REPEATS_LOWER_AFTER    8                // Step down by 1 after this many first-try successes in a row
+# define REPEATS_RETRY_FLOOR    64               //  (or below a value that once needed a retransmit, after this many)
+
+    /* Typedefs */
+  typedef struct {
+    DWORD dwRepeats;                             // PulseRepeats the tuner last chose (or was handed)
+    DWORD dwFloor;                               // Lowest value that hasn't (yet) needed a retransmit
+    DWORD dwStreak;                              // First-try successes in a row at dwRepeats
+    int   nLastChange;                           // What the last Repeats_Confirmed() did (+1 raised, -1 lowered, 0 neither)
+
+    DWORD dwFirstTry;                            // Commands that worked first time
+    DWORD dwRetried;                             // Commands that needed retransmitting
+    DWORD dwHeardRetried;                        //  but every transmission was heard on the air (not counted above)
+    DWORD dwRaised;                              // Number of times PulseRepeats was raised
+    DWORD dwLowered;                             //  and lowered
+  } REPEAT_TUNER;
+
+    /* Global function prototypes */
+  void  Repeats_Init(        REPEAT_TUNER *pTune, DWORD dwRepeats );
+  DWORD Repeats_Confirmed(   REPEAT_TUNER *pTune, DWORD dwRepeats, DWORD dwAttempts,
+                             DWORD dwHeard, DWORD dwMissed );
+  void  Repeats_Rejected(    REPEAT_TUNER *pTune, DWORD dwRepeats );
+  void  Repeats_FormatStats( const REPEAT_TUNER *pTune, char *szBuffer );
+
+#endif
@@ -10,9 +10,20 @@
   /* Includes */
 #include "ChargeOn.h"
 #include <stdlib.h>                    // For atol()
+#include "../../Arduino/LogCodes.h"    // Event codes in the ChargeOn module's log (shared with the sketch)
   /* Defines */
+#define ECHO_REPLY_LEN      10                             // strlen("[Seen:1][]")
+#define RESPONSE_LEN        128                            // Room for a response plus an event frame that arrives ahead of it
+#define STATUS_REPLY_LEN    25                             // strlen("[Up:4294967][Gen:65535][]")
+#define LOG_ENTRY_LEN       20                             // Hex digits per log entry (LOG_HEX_LEN in the sketch)
+#define LOG_MAX_REPLIES     16                             // Most <CO_LOG> exchanges per Serial_FetchLog() (the sketch
+                                                           //  keeps 24 entries, and sends 3 per reply)
 
   /* Typedefs */
+typedef struct {                                           // How to show one of the ChargeOn module's log events
+  BYTE        byHow;                                       // LA_xxx (see LogCodes.h)
+  const char *szText;                                      // With "{b}" for byArg and "{l}" for lArg
+} LOG_TEXT;
 
   /* Static variables */
 static const char WAKE_SIGNAL[]           = "<CO_WAKE>";
@@ -53,18 +64,80 @@ static const char EEPROM_SIGNAL[]         = "<CO_EEPROM>";
 static const char EEPROM_OK_SIGNAL[]      = "<CO_EEPROM_OK>";
 //static const char EEPROM_ERROR[]          = "EEPROM";
 
-static       char szSettingsBuffer[85];
+static const char BATCH_SIGNAL[]          = "<CO_BATCH>";
+static const char BATCH_OK_SIGNAL[]       = "<CO_BATCH_OK>";
+
+static const char HASH_SIGNAL[]           = "<CO_HASH>";
+static const char HASH_OK_SIGNAL[]        = "<CO_HASH_OK>";
+
+static const char LIMITS_SIGNAL[]         = "<CO_LIMITS>";
+static const char LIMITS_OK_SIGNAL[]      = "<CO_LIMITS_OK>";
+
+static const char SAMPLE_SIGNAL[]         = "<CO_SAMPLE>";
+static const char SAMPLE_OK_SIGNAL[]      = "<CO_SAMPLE_OK>";
+
+static const char LEARN_START_SIGNAL[]    = "<CO_LEARN_START>";
+static const char LEARN_START_OK_SIGNAL[] = "<CO_LEARN_START_OK>";
+
+static const char LOG_SIGNAL[]            = "<CO_LOG>";
+static const char LOG_OK_SIGNAL[]         = "<CO_LOG_OK>";
+
+static const char STATS_SIGNAL[]          = "<CO_STATS>";
+static const char STATS_OK_SIGNAL[]       = "<CO_STATS_OK>";
+
+static const char EVENT_SIGNAL[]          = "<CO_EVT>";    // Sent by the ChargeOn module without being asked
+
+static       char szSettingsBuffer[120];
+static       BYTE bySettingsIdx           = 0;             // Outlet profile to send with the next SETTINGS signal
+static     OUTLET ModuleOutlets[MAX_OUTLETS];              // Outlet profiles as last sent to the ChargeOn module
+static       BOOL bDeltaOK                = FALSE;         // Is it known to still have exactly those? (Send only changes)
 
 static const int  CAPTURECODE_TIMEOUTSECS = 3;
 
+static MODULE_EVENT EventQueue[EVENT_QUEUE_LEN];           // Events waiting for Serial_NextEvent()
+static BYTE         byEventCount          = 0;
+static char         szEventBuffer[RESPONSE_LEN];           // Event frame(s) still arriving (between exchanges)
+static DWORD        dwEventBytes          = 0;
+static DWORD        dwLastHeardTick       = 0;             // When the ChargeOn module last answered (or sent an event)
+static BOOL         bLinkSuspect          = TRUE;          // Has an exchange failed since then?
+
+#define LOG_TEXT_ENTRY( code, how, text )  { how, text },
+static const LOG_TEXT LogTexts[] = {                       // Indexed by LOG_xxx code
+  { LA_NUM, "(Nothing)" },
+  LOG_EVENTS( LOG_TEXT_ENTRY )
+};
+
+static const char *StatsCommands[] = {                     // The sketch's COMMANDS, in order (for <CO_STATS> "[Cmd:...]")
+  "WAKE", "ON", "OFF", "BEAT", "SETTINGS", "OUTLET", "LEARN", "VERSION", "EEPROM",
+  "BATCH", "HASH", "LIMITS", "SAMPLE", "LEARN_START", "LOG", "STATS"
+};
+
 
   /* Global variables */
 BOOL bInitializingPort = FALSE;                            // Flag to prevent certain processes while serial port is being initialized
 BOOL bDoingTX_RX       = FALSE;                            // In the process of communicating with the serial port?
+BYTE byRFEcho          = RF_ECHO_UNKNOWN;                  // Did the ChargeOn module hear the last ON/OFF code it sent?
+MODULE_STATUS ModuleStatus = { FALSE };                    // What the ChargeOn module last said about itself
 
 
   /* Function prototypes */
-static BOOL SetPortState( HANDLE hSerial );
+static BOOL  OpenAndWake(   PORTINFO *pSerialPort, UINT uPortNum );
+static BOOL  SetPortState(  HANDLE hSerial );
+static WORD  SettingsHash(  BYTE byCount, BOOL bAsSent );
+static void  FormatSettings( char *szBuffer, BYTE byIdx );
+static DWORD MaxSendTimeMs( const OUTLET *pOutlet );
+static BOOL  ReadRestOfResponse( HANDLE hSerial, char *pBuffer, DWORD dwSize, DWORD dwWanted,
+                                 DWORD *pdwRead, DWORD dwGiveUpTick );
+static BOOL  Exchange(      PORTINFO *pSerial, const char *szSignal, const char *szOKsignal,
+                            char *InBuffer, DWORD dwInSize, DWORD dwExtraMs );
+static long  ResponseValue( const char *InBuffer, const char *szName, long lDefault );
+static DWORD StripEvents(   char *pBuffer, DWORD dwLen );
+static void  QueueEvent(    const char *pFields, DWORD dwLen );
+static BOOL  TakeEvent(     BYTE byType, MODULE_EVENT *pEvent );
+static void  ReadEvents(    HANDLE hSerial );
+static void  NoteExchange(  BOOL bAnswered, const char *InBuffer );
+static BOOL  LearnAsync(    PORTINFO *pSerial, OUTLET *pOutlet, BOOL *pbLearned );
+static void  FormatLogEntry( char *szLine, const char *pHex );
 
 /* === LOCAL FUNCTIONS ===================================================== */
 
@@ -81,47 +154,17 @@ static BOOL SetPortState( HANDLE hSerial );
 BOOL InitSerial( PORTINFO *pSerialPort )
 {
   UINT       uPortNum;
-  NAMESTRING pTempPortName;
   BOOL       bStatus        = FALSE;
 
   bInitializingPort = TRUE;                                // Prevent certain processes while serial port is being initialized
 
   for( uPortNum = 1; uPortNum < MAX_PORT_NUM; uPortNum++ ) {
                                                            // Until all possible COM ports have been checked...
-    sprintf( pTempPortName, TEXT("\\\\.\\COM%u"), uPortNum );
-                                                           // Populate next candidate device string
-    strcpy( pSerialPort->szPortName, pTempPortName+4 );    // Remember port NAME portion of the string
-    pSerialPort->hComPort = CreateFile(                    // Try to open the specified port
-                                        pTempPortName,                   // Port name
-                                        GENERIC_READ | GENERIC_WRITE,    // Open for read/write
-                                        0,                               // No sharing (ports can't be shared)
-                                        NULL,                            // No security
-                                        OPEN_EXISTING,                   // Open existing port only
-                                        FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
-                                                                         // Non-overlapped, non-buffered I/O
-                                        NULL                             // Template file not needed for comm devices
-                                      );
-    if( pSerialPort->hComPort == INVALID_HANDLE_VALUE ) {  // Returned handle is invalid?
-      continue;                                            //  Yes, try the next COM port
-    }
-    else {                                                 //  No...
-Sleep(1500);
-      if( !SetPortState(pSerialPort->hComPort) ) {         //   Able to configure the desired settings for the port?
-                                                           //    No, print error message
-        CloseHandle( pSerialPort->hComPort );              //     Close the handle
-        continue;                                          //     Try the next COM port
-      }
-      else if( !SendSignal_GetResponse(pSerialPort, WAKE) ) {
-                                                           //    Yes, able to "wake up" the COM port?
-        CloseHandle( pSerialPort->hComPort );              //     No, close the handle
-        continue;                                          //      Try the next COM port
-      }
-      else {                                               //     Yes (found an available & suitable ChargeOn module!)
-        bStatus = TRUE;                                    //      Set status flag to indicate Success
-        SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "" );
-        SendOutletSettings( pSerialPort );                 //      Make sure ChargeOn module has current outlet settings
-        break;
-      }
+    if( OpenAndWake(pSerialPort, uPortNum) ) {             //  Found an available & suitable ChargeOn module?
+      bStatus = TRUE;                                      //   Yes, set status flag to indicate Success
+      SetWindowText( GetDlgItem(hMainDlg, IDC_STATUS2), "" );
+      SendOutletSettings( pSerialPort );                   //    Make sure ChargeOn module has current outlet settings
+      break;
     }
   } /* for */
 
@@ -131,6 +174,74 @@ Sleep(1500);
 } // InitSerial()
 
 
+/*****************************************************************************
+ * FUNC: Serial_Reopen                                                       *
+ * DESC: Reconnect to the ChargeOn module on the port it was last found on   *
+ * ARGS: pSerialPort = Address of port info (szPortName says which port)     *
+ * RET:  TRUE  = Port was reopened and the module answered                   *
+ *       FALSE = It didn't (call InitSerial() to look on every port)         *
+ * NOTE: Much quicker than InitSerial() after the PC wakes up, when the USB  *
+ *       serial port has usually come back under the same name. The outlet   *
+ *       settings are NOT sent; check them with Serial_CheckSettingsHash().  *
+ *****************************************************************************/
+BOOL Serial_Reopen( PORTINFO *pSerialPort )
+{
+  UINT uPortNum = 0;
+  BOOL bStatus  = FALSE;
+
+  if( sscanf(pSerialPort->szPortName, "COM%u", &uPortNum) != 1 ) {
+    return FALSE;                                          // Never connected
+  }
+  bInitializingPort = TRUE;                                // Prevent certain processes while serial port is being initialized
+  bStatus           = OpenAndWake( pSerialPort, uPortNum );
+  bInitializingPort = FALSE;                               // Allow "blocked" processes
+  return bStatus;
+} // Serial_Reopen()
+
+
+/*****************************************************************************
+ * FUNC: OpenAndWake                                                         *
+ * DESC: Try one COM port; it must:                                          *
+ *         1) Open and be configured successfully                            *
+ *         2) Send the appropriate reply in response to our "wake up" signal *
+ * ARGS: pSerialPort = Address of port info to be populated                  *
+ *       uPortNum    = COM port number                                       *
+ * RET:  TRUE  = Port is open, with a ChargeOn module on the other end       *
+ *       FALSE = It isn't (the port has been closed again)                   *
+ *****************************************************************************/
+static BOOL OpenAndWake( PORTINFO *pSerialPort, UINT uPortNum )
+{
+  NAMESTRING pTempPortName;
+
+  sprintf( pTempPortName, TEXT("\\\\.\\COM%u"), uPortNum );
+                                                           // Populate candidate device string
+  strcpy( pSerialPort->szPortName, pTempPortName+4 );      // Remember port NAME portion of the string
+  pSerialPort->hComPort = CreateFile(                      // Try to open the specified port
+                                      pTempPortName,                   // Port name
+                                      GENERIC_READ | GENERIC_WRITE,    // Open for read/write
+                                      0,                               // No sharing (ports can't be shared)
+                                      NULL,                            // No security
+                                      OPEN_EXISTING,                   // Open existing port only
+                                      FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
+                                                                       // Non-overlapped, non-buffered I/O
+                                      NULL                             // Template file not needed for comm devices
+                                    );
+  if( pSerialPort->hComPort == INVALID_HANDLE_VALUE ) {    // Returned handle is invalid?
+    return FALSE;                                          //  Yes, no good
+  }
+Sleep(1500);
+  if( !SetPortState(pSerialPort->hComPort) ) {             //  No, able to configure the desired settings for the port?
+    CloseHandle( pSerialPort->hComPort );                  //   No, close the handle
+    return FALSE;
+  }
+  if( !SendSignal_GetResponse(pSerialPort, WAKE) ) {       //   Yes, able to "wake up" the COM port?
+    CloseHandle( pSerialPort->hComPort );                  //    No, close the handle
+    return FALSE;
+  }
+  return TRUE;                                             //    Yes (found an available & suitable ChargeOn module!)
+} // OpenAndWake()
+
+
 /*************************************************************************************
  * FUNC: SetPortState                                                                *
  * DESC: Set up DCB (Device Control Block) and timeouts for current port of interest *
@@ -184,6 +295,337 @@ static BOOL SetPortState( HANDLE hSerial )
 } // SetPortState()
 
 
+/*************************************************************************************
+ * FUNC: MaxSendTimeMs                                                               *
+ * DESC: Work out the longest the ChargeOn module could take to send an ON/OFF code  *
+ *       PulseRepeats times                                                          *
+ * ARGS: pOutlet = Address of the outlet's settings                                  *
+ * RET:  Time (milliseconds)                                                         *
+ * NOTE: The slowest RCSwitch protocol (3) uses 101 pulse lengths for the sync and   *
+ *       15 for each bit.                                                            *
+ *************************************************************************************/
+
+static DWORD MaxSendTimeMs( const OUTLET *pOutlet )
+{
+  return (pOutlet->PulseRepeats * (101 + (15 * pOutlet->ValueLength)) * pOutlet->PulseLength) / 1000 + 250;
+}
+
+
+/*************************************************************************************
+ * FUNC: ReadRestOfResponse                                                          *
+ * DESC: Keep reading until a response is complete (dwWanted bytes, or ending with  *
+ *       "[]"), or it's time to give up                                              *
+ * ARGS: hSerial      = Handle for the serial port                                   *
+ *       pBuffer      = Buffer holding the part of the response read so far          *
+ *       dwSize       = Size of pBuffer                                              *
+ *       dwWanted     = Length of the complete response (less than dwSize)           *
+ *       pdwRead      = Address of the number of bytes read so far (updated)         *
+ *       dwGiveUpTick = Tick count at which to stop waiting                          *
+ * RET:  TRUE  = Response is complete, or we gave up waiting for it                  *
+ *       FALSE = Error while reading                                                 *
+ * NOTE: Event frames that arrive along with the response are queued and taken out   *
+ *       of pBuffer (which is left null-terminated). While one has only partly       *
+ *       arrived, we read past dwWanted to get the rest of it.                       *
+ *************************************************************************************/
+
+static BOOL ReadRestOfResponse( HANDLE hSerial, char *pBuffer, DWORD dwSize, DWORD dwWanted,
+                                DWORD *pdwRead, DWORD dwGiveUpTick )
+{
+  DWORD dwNewBytes;
+  DWORD dwLimit;
+  char  *pPartial;
+
+  for( ;; ) {
+    *pdwRead = StripEvents( pBuffer, *pdwRead );
+    pPartial = strstr( pBuffer, EVENT_SIGNAL );            // (Any event frame still here is incomplete)
+    dwLimit  = pPartial ? dwSize - 1 : dwWanted;
+    if(    (*pdwRead >= dwLimit)
+        || (!pPartial && (*pdwRead >= 2) && !strncmp(pBuffer + *pdwRead - 2, "[]", 2))
+        || ((long)(dwGiveUpTick - GetTickCount()) <= 0) ) {
+      break;
+    }
+    Sleep( 10 );                                           // Give the ChargeOn module a moment
+    if( !ReadFile(hSerial, pBuffer + *pdwRead, dwLimit - *pdwRead, &dwNewBytes, NULL) ) {
+      return FALSE;
+    }
+    *pdwRead += dwNewBytes;
+  }
+
+  if( pPartial && (dwEventBytes + strlen(pPartial) < sizeof(szEventBuffer)) ) {
+    strcpy( szEventBuffer + dwEventBytes, pPartial );      // Gave up before the event frame was complete?
+    dwEventBytes += strlen( pPartial );                    //  Yes, let Serial_PollEvents() finish reading it
+    *pPartial     = '\0';
+    *pdwRead      = strlen( pBuffer );
+  }
+  return TRUE;
+}
+
+
+/*************************************************************************************
+ * FUNC: Exchange                                                                    *
+ * DESC: Send a signal (with any "[Name:value]...[]" data already appended) and read *
+ *       a response ending with "[]"                                                 *
+ * ARGS: pSerial    = Address of PORTINFO struct for serial connection               *
+ *       szSignal   = Complete signal to send                                        *
+ *       szOKsignal = What the response must start with                              *
+ *       InBuffer   = Buffer to receive the (null-terminated) response               *
+ *       dwInSize   = Size of InBuffer                                               *
+ *       dwExtraMs  = How much longer than usual the ChargeOn module may take to     *
+ *                    respond (e.g. while it sends an ON/OFF code)                   *
+ * RET:  TRUE  = Successfully wrote to port and received the expected response       *
+ *       FALSE = Error while writing/reading, or received unexpected response        *
+ *************************************************************************************/
+
+static BOOL Exchange( PORTINFO *pSerial, const char *szSignal, const char *szOKsignal,
+                      char *InBuffer, DWORD dwInSize, DWORD dwExtraMs )
+{
+  DWORD dwNoOfBytesToWrite = strlen( szSignal );           // Number of bytes to write to the port
+  DWORD dwNoOfBytesWritten = 0;                            // Number of bytes actually written to the port
+  DWORD dwNoOfBytesRead    = 0;                            // Number of bytes actually read from the port
+  DWORD dwGiveUpTick;                                      // When to stop waiting for the response
+  BOOL  bRetVal;
+
+  InBuffer[0] = '\0';
+  if( bDoingTX_RX == TRUE ) {                              // Already communicating with serial port? 
+    Sleep( 50 );                                           //  Yes, wait before trying again
+    if( bDoingTX_RX == TRUE ) {                            //   Still communicating with serial port?
+      return FALSE;                                        //    Yes, fail
+    }
+  }
+  bDoingTX_RX = TRUE;                                      // Starting a new "conversation" with serial port
+
+  dwGiveUpTick = GetTickCount() + ((dwNoOfBytesToWrite * CBR_115200) / MY_BAUDRATE) + 100 + dwExtraMs;
+  bRetVal      =    WriteFile(pSerial->hComPort, szSignal, dwNoOfBytesToWrite, &dwNoOfBytesWritten, NULL)
+                 && ReadRestOfResponse(pSerial->hComPort, InBuffer, dwInSize, dwInSize - 1, &dwNoOfBytesRead, dwGiveUpTick);
+  InBuffer[dwNoOfBytesRead] = '\0';
+  bRetVal      = bRetVal && !strncmp(InBuffer, szOKsignal, strlen(szOKsignal));
+  NoteExchange( bRetVal, InBuffer );
+
+  bDoingTX_RX = FALSE;                                     // No longer communicating with serial port
+  return bRetVal;
+} // Exchange()
+
+
+/*************************************************************************************
+ * FUNC: ResponseValue                                                               *
+ * DESC: Find "[Name:value]" in a response                                           *
+ * ARGS: InBuffer = Response from the ChargeOn module                                *
+ *       szName   = Name of the value                                                *
+ *       lDefault = What to return if it isn't there                                 *
+ * RET:  The value                                                                   *
+ *************************************************************************************/
+
+static long ResponseValue( const char *InBuffer, const char *szName, long lDefault )
+{
+  char        szTag[20];
+  const char *pTag;
+
+  sprintf( szTag, "[%s:", szName );
+  pTag = strstr( InBuffer, szTag );
+  return pTag ? atol(pTag + strlen(szTag)) : lDefault;
+} // ResponseValue()
+
+
+/*************************************************************************************
+ * FUNC: FormatSettings                                                              *
+ * DESC: Build the SETTINGS signal for an outlet profile                             *
+ * ARGS: szBuffer = Buffer (at least 120 bytes) to receive the signal                *
+ *       byIdx    = Outlet profile (0 = the laptop's outlet)                         *
+ * RET:  [None]                                                                      *
+ * NOTE: If the ChargeOn module is known to have ModuleOutlets[] (bDeltaOK), only    *
+ *       the fields that differ from it are included; the sketch leaves the others   *
+ *       as they are.                                                                *
+ *************************************************************************************/
+
+static void FormatSettings( char *szBuffer, BYTE byIdx )
+{
+  const OUTLET *pOutlet = GetOutlet( byIdx );
+  const OUTLET *pOld    = &ModuleOutlets[byIdx];
+  char         *pField;
+
+  strcpy( szBuffer, SETTINGS_SIGNAL );
+  pField = szBuffer + strlen( szBuffer );
+  if( byIdx ) {                                            // (Profile 0 is sent without an index, as older sketches expect)
+    pField += sprintf( pField, "[Idx:%u]", byIdx );
+  }
+  if( !bDeltaOK || (pOutlet->OnCode != pOld->OnCode) ) {
+    pField += sprintf( pField, "[On:%d]", pOutlet->OnCode );
+  }
+  if( !bDeltaOK || (pOutlet->OffCode != pOld->OffCode) ) {
+    pField += sprintf( pField, "[Off:%d]", pOutlet->OffCode );
+  }
+  if( !bDeltaOK || (pOutlet->Protocol != pOld->Protocol) ) {
+    pField += sprintf( pField, "[Pro:%d]", pOutlet->Protocol );
+  }
+  if( !bDeltaOK || (pOutlet->PulseLength != pOld->PulseLength) ) {
+    pField += sprintf( pField, "[PLen:%d]", pOutlet->PulseLength );
+  }
+  if( !bDeltaOK || (pOutlet->PulseRepeats != pOld->PulseRepeats) ) {
+    pField += sprintf( pField, "[PReps:%d]", pOutlet->PulseRepeats );
+  }
+  if( !bDeltaOK || (pOutlet->TurnOnBeforeQuit != pOld->TurnOnBeforeQuit) ) {
+    pField += sprintf( pField, "[TOBQ:%d]", pOutlet->TurnOnBeforeQuit );
+  }
+  if( !bDeltaOK || (pOutlet->ValueLength != pOld->ValueLength) ) {
+    pField += sprintf( pField, "[VLen:%d]", pOutlet->ValueLength );
+  }
+  if( !bDeltaOK || (pOutlet->Loopback != pOld->Loopback) ) {
+    pField += sprintf( pField, "[Loop:%d]", pOutlet->Loopback );
+  }
+  strcpy( pField, "[]" );
+} // FormatSettings()
+
+
+/*************************************************************************************
+ * FUNC: StripEvents                                                                 *
+ * DESC: Queue (and remove) any complete "<CO_EVT>[E:n]...[]" frames in a buffer     *
+ * ARGS: pBuffer = Buffer holding bytes read from the serial port                    *
+ *       dwLen   = Number of bytes in it (pBuffer must have room for one more)       *
+ * RET:  Number of bytes left (pBuffer is null-terminated)                           *
+ * NOTE: The ChargeOn module only sends an event between responses, never in the     *
+ *       middle of one, so the first "[]" after "<CO_EVT>" always ends the frame.    *
+ *************************************************************************************/
+
+static DWORD StripEvents( char *pBuffer, DWORD dwLen )
+{
+  char *pEvent;
+  char *pEnd;
+
+  pBuffer[dwLen] = '\0';
+  while(    ((pEvent = strstr(pBuffer, EVENT_SIGNAL)) != NULL)
+         && ((pEnd   = strstr(pEvent, "[]")) != NULL) ) {
+    QueueEvent( pEvent + strlen(EVENT_SIGNAL), pEnd - pEvent - strlen(EVENT_SIGNAL) );
+    pEnd += 2;
+    memmove( pEvent, pEnd, strlen(pEnd) + 1 );
+  }
+  return strlen( pBuffer );
+} // StripEvents()
+
+
+/*************************************************************************************
+ * FUNC: QueueEvent                                                                  *
+ * DESC: Add an event to the queue (dropping the oldest one if it's full)            *
+ * ARGS: pFields = The event's "[E:n][Name:value]..." fields                         *
+ *       dwLen   = Length of the fields                                              *
+ * RET:  [None]                                                                      *
+ *************************************************************************************/
+
+static void QueueEvent( const char *pFields, DWORD dwLen )
+{
+  MODULE_EVENT *pEvent;
+
+  if( byEventCount == EVENT_QUEUE_LEN ) {                  // Nobody collecting them?
+    memmove( &EventQueue[0], &EventQueue[1], (EVENT_QUEUE_LEN - 1) * sizeof(MODULE_EVENT) );
+    byEventCount--;                                        //  Forget the oldest
+  }
+  pEvent = &EventQueue[byEventCount++];
+  if( dwLen >= sizeof(pEvent->szFields) ) {
+    dwLen = sizeof(pEvent->szFields) - 1;
+  }
+  memcpy( pEvent->szFields, pFields, dwLen );
+  pEvent->szFields[dwLen] = '\0';
+  pEvent->byType          = (BYTE)ResponseValue( pEvent->szFields, "E", 0 );
+  dwLastHeardTick         = GetTickCount();                // (The module is evidently still there)
+  bLinkSuspect            = FALSE;
+} // QueueEvent()
+
+
+/*************************************************************************************
+ * FUNC: TakeEvent                                                                   *
+ * DESC: Remove the oldest queued event of a given type                              *
+ * ARGS: byType = EVT_xxx (or 0 for any type)                                        *
+ *       pEvent = Address of MODULE_EVENT to receive it                              *
+ * RET:  TRUE  = Found one                                                           *
+ *       FALSE = None queued                                                         *
+ *************************************************************************************/
+
+static BOOL TakeEvent( BYTE byType, MODULE_EVENT *pEvent )
+{
+  BYTE byIdx;
+
+  for( byIdx = 0; byIdx < byEventCount; byIdx++ ) {
+    if( (byType == 0) || (EventQueue[byIdx].byType == byType) ) {
+      *pEvent = EventQueue[byIdx];
+      byEventCount--;
+      memmove( &EventQueue[byIdx], &EventQueue[byIdx + 1], (byEventCount - byIdx) * sizeof(MODULE_EVENT) );
+      return TRUE;
+    }
+  }
+  return FALSE;
+} // TakeEvent()
+
+
+/*************************************************************************************
+ * FUNC: ReadEvents                                                                  *
+ * DESC: Read whatever the ChargeOn module has sent since the last exchange, and     *
+ *       queue any complete event frames                                             *
+ * ARGS: hSerial = Handle for the serial port                                        *
+ * RET:  [None]                                                                      *
+ * NOTE: The caller must own the port (bDoingTX_RX). Anything that can't be part of  *
+ *       an event frame (e.g. a response that came too late) is thrown away.         *
+ *************************************************************************************/
+
+static void ReadEvents( HANDLE hSerial )
+{
+  DWORD dwNewBytes = 0;
+  char  *pEvent;
+  DWORD dwKeep;
+
+  if( !ReadFile(hSerial, szEventBuffer + dwEventBytes, sizeof(szEventBuffer) - 1 - dwEventBytes, &dwNewBytes, NULL) ) {
+    dwNewBytes = 0;
+  }
+  dwEventBytes = StripEvents( szEventBuffer, dwEventBytes + dwNewBytes );
+
+  pEvent = strstr( szEventBuffer, EVENT_SIGNAL );
+  if( pEvent == szEventBuffer ) {                          // Start of a frame (already at the front)?
+    if( dwEventBytes == sizeof(szEventBuffer) - 1 ) {      //  Yes, but it can't be a real one if it fills the buffer
+      dwEventBytes = 0;
+    }
+  }
+  else if( pEvent ) {                                      // Start of a frame (after some junk)?
+    dwEventBytes = strlen( pEvent );                       //  Yes, keep just the frame
+    memmove( szEventBuffer, pEvent, dwEventBytes + 1 );
+  }
+  else {                                                   // Only junk; but keep what could be the start of "<CO_EVT>"
+    dwKeep = min( dwEventBytes, strlen(EVENT_SIGNAL) - 1 );
+    memmove( szEventBuffer, szEventBuffer + dwEventBytes - dwKeep, dwKeep + 1 );
+    dwEventBytes = dwKeep;
+  }
+} // ReadEvents()
+
+
+/*************************************************************************************
+ * FUNC: NoteExchange                                                                *
+ * DESC: Keep track of whether the ChargeOn module is answering, and of any status   *
+ *       it included in its response                                                 *
+ * ARGS: bAnswered = Did the exchange succeed?                                       *
+ *       InBuffer  = The response                                                    *
+ * RET:  [None]                                                                      *
+ *************************************************************************************/
+
+static void NoteExchange( BOOL bAnswered, const char *InBuffer )
+{
+  long lUpSecs;
+
+  if( !bAnswered ) {                                       // No answer (or the wrong one)?
+    bLinkSuspect = TRUE;                                   //  Yes, check with a heartbeat next time
+    return;
+  }
+  dwLastHeardTick = GetTickCount();
+  bLinkSuspect    = FALSE;
+
+  lUpSecs = ResponseValue( InBuffer, "Up", -1 );
+  if( lUpSecs >= 0 ) {                                     // Did it say how it's doing?
+    if( ModuleStatus.bKnown && ((DWORD)lUpSecs < ModuleStatus.dwUpSecs) ) {
+      ModuleStatus.bRestarted = TRUE;                      //  Yes, and it has restarted since it last said so
+    }
+    ModuleStatus.bKnown   = TRUE;
+    ModuleStatus.dwUpSecs = (DWORD)lUpSecs;
+    ModuleStatus.dwGen    = (DWORD)ResponseValue( InBuffer, "Gen", 0 );
+  }
+} // NoteExchange()
+
+
 /*************************************************************************************
  * FUNC: SendSignal_GetResponse                                                      *
  * DESC: Send specific signal to microcontroller, expect appropriate response        *
@@ -196,6 +638,8 @@ static BOOL SetPortState( HANDLE hSerial )
  *                = OUTLET    to have ChargeOn module print current outlet settings  *
  * RET:  TRUE  = Successfully wrote to port and received expected response           *
  *       FALSE = Error while writing/reading, or received unexpected response        *
+ * NOTE: With Outlet.Loopback on, the response to TURN_ON/TURN_OFF only arrives once *
+ *       the code has been sent, and ends with "[Seen:n][]"; byRFEcho is set from it *
  *************************************************************************************/
 
 BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
@@ -210,15 +654,11 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
   char  *OutBuffer         = (char *)chat[talkType].signal;// OutBuffer should be char or byte array, otherwise write will fail
 
   if( talkType == SETTINGS ) {                             // SETTINGS signal requires additional data
-    sprintf( szSettingsBuffer, "%s[On:%d][Off:%d][Pro:%d][PLen:%d][PReps:%d][TOBQ:%d][VLen:%d][]",
-                               (char *)chat[SETTINGS].signal,
-                               Outlet.OnCode,
-                               Outlet.OffCode,
-                               Outlet.Protocol,
-                               Outlet.PulseLength,
-                               Outlet.PulseRepeats,
-                               Outlet.TurnOnBeforeQuit,
-                               Outlet.ValueLength );
+    if(    bDeltaOK                                        //  Does the ChargeOn module have this profile already?
+        && !memcmp(GetOutlet(bySettingsIdx), &ModuleOutlets[bySettingsIdx], sizeof(OUTLET)) ) {
+      return TRUE;                                         //   Yes, nothing to send
+    }
+    FormatSettings( szSettingsBuffer, bySettingsIdx );     //   No, send it (or just what has changed)
     OutBuffer = szSettingsBuffer;
   }
 
@@ -227,10 +667,13 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
   DWORD dwSleepPeriod      = ((dwNoOfBytesToWrite * CBR_115200) / MY_BAUDRATE);
                                                            // Number of millseconds to wait (after sending the signal)
                                                            //  before attempting to read the response
-  char  InBuffer[25];                                      // Store response from ChargeOn module (Arduino) here
+  char  InBuffer[RESPONSE_LEN] = "";                       // Store response from ChargeOn module (Arduino) here
   DWORD dwNoOfBytesToRead  = strlen( chat[talkType].expectedResponse );
                                                            // Number of bytes to read from the port
   DWORD dwNoOfBytesRead    = 0;                            // Number of bytes actually read from the port
+  BOOL  bWantEcho          = ((talkType == TURN_ON) || (talkType == TURN_OFF)) && (Outlet.Loopback == 1);
+  BOOL  bWantStatus        = (talkType == WAKE) || (talkType == HEARTBEAT) || (talkType == SETTINGS);
+  DWORD dwGiveUpTick;                                      // When to stop waiting for the rest of the response
   char  szMessageBuff[70]  = "";                           // Create message string for user (if any) here
   BOOL  bRetVal            = FALSE;                        // Assume failure until proven otherwise
 
@@ -241,6 +684,17 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
     }
   }
   bDoingTX_RX = TRUE;                                      // Starting a new "conversation" with serial port
+  byRFEcho    = RF_ECHO_UNKNOWN;
+  if( bWantEcho ) {                                        // Will the response say whether the code was heard?
+    dwNoOfBytesToRead += ECHO_REPLY_LEN;                   //  Yes, wait for that too (it never comes from older sketches)
+    dwGiveUpTick       = GetTickCount() + dwSleepPeriod + MaxSendTimeMs( &Outlet );
+  }
+  else {
+    dwGiveUpTick       = GetTickCount() + dwSleepPeriod + 100;
+  }
+  if( bWantStatus ) {                                      // Newer sketches add "[Up:secs][Gen:n][]" to these responses
+    dwNoOfBytesToRead += STATUS_REPLY_LEN;
+  }
 
   if( !WriteFile(pSerial->hComPort,                        // Able to write signal to serial port?
                  OutBuffer,
@@ -270,7 +724,11 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
       }
       bRetVal = FALSE;                                     //    and FAIL
     }
-    else if( strncmp(InBuffer, chat[talkType].expectedResponse, dwNoOfBytesToRead) ) {
+    else if( !ReadRestOfResponse(pSerial->hComPort, InBuffer, sizeof(InBuffer), dwNoOfBytesToRead, &dwNoOfBytesRead, dwGiveUpTick) ) {
+                                                           //    Yes, but couldn't read the rest of it (a loopback
+      bRetVal = FALSE;                                     //     response, or one held up by an event frame); FAIL
+    }
+    else if( strncmp(InBuffer, chat[talkType].expectedResponse, strlen(chat[talkType].expectedResponse)) ) {
                                                            //    Yes, did we get the *expected* response?
       if( !bMonitorOnly ) {
         sprintf( szMessageBuff, "Unexpected response \"%s\" to %s signal", InBuffer, chat[talkType].errorMessage );
@@ -280,17 +738,20 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
       bRetVal = FALSE;                                     //     and FAIL
     }
     else {                                                 //     Yes (we got the *expected* response)
-      if( talkType == TURN_ON ) {                          //      Are we switching the outlet ON?
-        Sleep(1250);                                       //       Yes, allow time for microcontroller (and outlet)
-                                                           //        to complete the process
-// KJB (13 Jun 2020): Try reducing Sleep() value to 500; it's better to send the ON code to the outlet multiple times
-//                    (if necessary) than to make the user wait more than a second no matter what
+      bRetVal = TRUE;                                      //      Success! (For TURN_ON/TURN_OFF, CheckActuation()
+                                                           //       watches for the outlet to respond, and resends if needed)
+      if( bWantEcho && strstr(InBuffer, "[Seen:") ) {      //      Did the ChargeOn module say whether it heard the code?
+        byRFEcho = (strstr(InBuffer, "[Seen:1]") != NULL) ? RF_ECHO_SEEN : RF_ECHO_MISSED;
       }
-      else if( talkType == TURN_OFF ) {                    //       No, are we switching the outlet OFF?
-        Sleep(250);                                        //        Yes, allow time for microcontroller (and outlet)
-                                                           //         to complete the process
-      }
-      bRetVal = TRUE;                                      //      Success!
+    }
+  }
+  NoteExchange( bRetVal, InBuffer );
+  if( talkType == SETTINGS ) {                             // Keep track of what the ChargeOn module has
+    if( bRetVal ) {
+      ModuleOutlets[bySettingsIdx] = *GetOutlet( bySettingsIdx );
+    }
+    else {
+      bDeltaOK = FALSE;                                    //  (Not sure any more; send everything next time)
     }
   }
 
@@ -299,6 +760,57 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
 } // SendSignal_GetResponse()
 
 
+/*************************************************************************************
+ * FUNC: LearnAsync                                                                  *
+ * DESC: Ask the ChargeOn module to listen for a remote control, then wait for the   *
+ *       code to arrive as an event                                                  *
+ * ARGS: pSerial   = Address of PORTINFO struct for serial connection                *
+ *       pOutlet   = Address of Outlet structure to be populated                     *
+ *       pbLearned = Set to TRUE if a usable code was heard                          *
+ * RET:  TRUE  = The module understood LEARN_START (*pbLearned says how it went)     *
+ *       FALSE = It didn't answer (older sketch, or port busy); use <CO_LEARN>       *
+ * NOTE: Returns as soon as the button is pressed, rather than always waiting for    *
+ *       the whole CAPTURECODE_TIMEOUTSECS like <CO_LEARN> does.                     *
+ *************************************************************************************/
+
+static BOOL LearnAsync( PORTINFO *pSerial, OUTLET *pOutlet, BOOL *pbLearned )
+{
+  char         InBuffer[RESPONSE_LEN];                     // Store response from ChargeOn module (Arduino) here
+  MODULE_EVENT Event;
+  DWORD        dwGiveUpTick;
+  BOOL         bHeard     = FALSE;
+
+  *pbLearned = FALSE;
+  if( !Exchange(pSerial, LEARN_START_SIGNAL, LEARN_START_OK_SIGNAL, InBuffer, sizeof(InBuffer), 0) ) {
+    return FALSE;
+  }
+
+  dwGiveUpTick = GetTickCount() + ResponseValue( InBuffer, "Ms", CAPTURECODE_TIMEOUTSECS * 1000 ) + 500;
+  bDoingTX_RX  = TRUE;                                     // (Keep the battery checks off the port while we wait)
+  while( (long)(dwGiveUpTick - GetTickCount()) > 0 ) {
+    if( TakeEvent(EVT_LEARNED, &Event) ) {                 // Heard the remote control?
+      bHeard = TRUE;                                       //  Yes
+      break;
+    }
+    if( TakeEvent(EVT_ERROR, &Event) ) {                   // Gave up listening?
+      break;                                               //  Yes
+    }
+    Sleep( 10 );
+    ReadEvents( pSerial->hComPort );
+  }
+  bDoingTX_RX  = FALSE;
+
+  if( bHeard ) {
+    pOutlet->OnCode      = pOutlet->OffCode = Serial_EventValue( &Event, "Code", 0 );
+    pOutlet->Protocol    = Serial_EventValue( &Event, "Pro",  0 );
+    pOutlet->PulseLength = Serial_EventValue( &Event, "PLen", 0 );
+    pOutlet->ValueLength = Serial_EventValue( &Event, "VLen", 0 );
+    *pbLearned           = pOutlet->OnCode && pOutlet->PulseLength && pOutlet->ValueLength;
+  }
+  return TRUE;
+} // LearnAsync()
+
+
 /*************************************************************************************
  * FUNC: Serial_GetOutletInfo                                                        *
  * DESC: Send EEPROM or LEARN signal to microcontroller, expect response with data   *
@@ -310,6 +822,7 @@ BOOL SendSignal_GetResponse( PORTINFO *pSerial, SerialExchangeType talkType )
  *       pOut        = Address of Outlet structure to be populated                   *
  * RET:  TRUE  = Successfully wrote to port and received good response               *
  *       FALSE = Error while writing/reading, or received unexpected response        *
+ * NOTE: LEARN uses <CO_LEARN_START> if the sketch knows it (see LearnAsync())       *
  *************************************************************************************/
 
 BOOL Serial_GetOutletInfo( HWND hParentWnd, PORTINFO *pSerial, SerialExchangeType requestType, void *pOut )
@@ -321,10 +834,14 @@ BOOL Serial_GetOutletInfo( HWND hParentWnd, PORTINFO *pSerial, SerialExchangeTyp
   DWORD  dwNoOfBytesWritten = 0;                           // Number of bytes actually written to the port
   DWORD  dwSleepPeriod;                                    // Number of milliseconds to wait for a response
 
-  char   InBuffer[85];                                     // Store response from ChargeOn module (Arduino) here
+  char   InBuffer[110]      = "";                          // Store response from ChargeOn module (Arduino) here
   DWORD  dwNoOfBytesRead    = 0;                           // Number of bytes actually read from the port
   BOOL   bRetVal            = FALSE;                       // Assume failure until proven otherwise
 
+  if( (requestType == LEARN) && LearnAsync(pSerial, pOutlet, &bRetVal) ) {
+    return bRetVal;                                        // Newer sketch; done as soon as the button was pressed
+  }
+
   if( bDoingTX_RX == TRUE ) {                              // Already communicating with serial port? 
     Sleep( 50 );                                           //  Yes, wait before trying again
     if( bDoingTX_RX == TRUE ) {                            //   Still communicating with serial port?
@@ -356,11 +873,13 @@ BOOL Serial_GetOutletInfo( HWND hParentWnd, PORTINFO *pSerial, SerialExchangeTyp
                  &dwNoOfBytesWritten,
                  NULL) ) {
     Sleep( dwSleepPeriod );                                //  Yes, allow Arduino time to capture data and send response 
-    if( ReadFile(pSerial->hComPort,                        //   Able to read response from serial port?
-                 InBuffer,
-                 sizeof(InBuffer),
-                 &dwNoOfBytesRead,
-                 NULL) ) {
+    if(    ReadFile(pSerial->hComPort,                     //   Able to read response from serial port?
+                    InBuffer,
+                    sizeof(InBuffer) - 1,                  //    (leaving room for the terminating null)
+                    &dwNoOfBytesRead,
+                    NULL)
+        && ReadRestOfResponse(pSerial->hComPort, InBuffer, sizeof(InBuffer), sizeof(InBuffer) - 1,
+                              &dwNoOfBytesRead, GetTickCount() + 100) ) {
       if( !strncmp(InBuffer, OKsignal, strlen(OKsignal)) ) {
                                                            //    Yes, did we get the *expected* response?
         char *nameToken;
@@ -395,6 +914,9 @@ BOOL Serial_GetOutletInfo( HWND hParentWnd, PORTINFO *pSerial, SerialExchangeTyp
           else if( !strcmp(nameToken, "VLen") ) {
             pOutlet->ValueLength = atol( valToken );
           }
+          else if( !strcmp(nameToken, "Loop") ) {          //      (Only expected for EEPROM, from newer sketches)
+            pOutlet->Loopback = atol( valToken );
+          }
 
           nameToken = strtok( NULL, "[:" );
         }
@@ -435,7 +957,7 @@ BOOL GetArduinoSketchVersion( HWND hParentWnd, PORTINFO *pSerial, char *szArduin
   DWORD dwNoOfBytesWritten = 0;                            // Number of bytes actually written to the port
   DWORD dwSleepPeriod      = ((dwNoOfBytesToWrite * CBR_115200) / MY_BAUDRATE);
 
-  char  InBuffer[75];                                      // Input buffer
+  char  InBuffer[RESPONSE_LEN];                            // Input buffer
 //  DWORD dwNoOfBytesToRead;                                 // Number of bytes to read from the port
   DWORD dwNoOfBytesRead    = 0;                            // Number of bytes actually read from the port
   BOOL  bRetVal            = FALSE;
@@ -455,11 +977,13 @@ BOOL GetArduinoSketchVersion( HWND hParentWnd, PORTINFO *pSerial, char *szArduin
                  &dwNoOfBytesWritten,
                  NULL) ) {
     Sleep( dwSleepPeriod );                                //  Yes, allow Arduino time to capture data and send response 
-    if( ReadFile(pSerial->hComPort,                        //   Able to read response from serial port?
-                 InBuffer,
-                 sizeof(InBuffer),
-                 &dwNoOfBytesRead,
-                 NULL) ) {
+    if(    ReadFile(pSerial->hComPort,                     //   Able to read response from serial port?
+                    InBuffer,
+                    sizeof(InBuffer) - 1,                  //    (leaving room for the terminating null)
+                    &dwNoOfBytesRead,
+                    NULL)
+        && ReadRestOfResponse(pSerial->hComPort, InBuffer, sizeof(InBuffer), sizeof(InBuffer) - 1,
+                              &dwNoOfBytesRead, GetTickCount() + 100) ) {
       if( !strncmp(InBuffer, VERSION_OK_SIGNAL, strlen(VERSION_OK_SIGNAL)) ) {
                                                            //    Yes, did we get the *expected* response?
         char *nameToken;
@@ -486,3 +1010,567 @@ BOOL GetArduinoSketchVersion( HWND hParentWnd, PORTINFO *pSerial, char *szArduin
   bDoingTX_RX = FALSE;                                     // No longer communicating with serial port
   return bRetVal;
 } // GetArduinoSketchVersion()
+
+
+/*************************************************************************************
+ * FUNC: Serial_SendOutletProfiles                                                   *
+ * DESC: Send SETTINGS for outlet profiles 1 and up (profile 0 is sent on its own)   *
+ * ARGS: pSerial = Address of PORTINFO struct for serial connection                  *
+ *       byCount = Number of outlet profiles in use                                  *
+ * RET:  TRUE  = All of them were acknowledged (or there are none)                   *
+ *       FALSE = At least one wasn't                                                 *
+ * NOTE: Only send these to a sketch that knows about [Idx:n]; an older one would    *
+ *       store every profile over profile 0.                                         *
+ *************************************************************************************/
+
+BOOL Serial_SendOutletProfiles( PORTINFO *pSerial, BYTE byCount )
+{
+  BOOL bRetVal = TRUE;
+
+  for( bySettingsIdx = 1; bySettingsIdx < byCount; bySettingsIdx++ ) {
+    if( !SendSignal_GetResponse(pSerial, SETTINGS) ) {
+      bRetVal = FALSE;
+    }
+  }
+  bySettingsIdx = 0;                                       // Back to the laptop's outlet
+  return bRetVal;
+} // Serial_SendOutletProfiles()
+
+
+/*************************************************************************************
+ * FUNC: Serial_SendBatch                                                            *
+ * DESC: Send BATCH signal to microcontroller, to switch several outlets in one       *
+ *       exchange: "<CO_BATCH>[On:mask][Off:mask][]" (bit n = outlet profile n)      *
+ * ARGS: pSerial   = Address of PORTINFO struct for serial connection                *
+ *       dwOnMask  = Outlet profiles to turn ON                                      *
+ *       dwOffMask = Outlet profiles to turn OFF                                     *
+ *       pdwSent   = Receives the profiles the ChargeOn module sent a code to        *
+ *       pdwSeen   = Receives the profiles whose code it heard (Loopback only)       *
+ * RET:  TRUE  = Successfully wrote to port and received good response               *
+ *       FALSE = Error while writing/reading, or received unexpected response        *
+ * NOTE: The response only arrives once every code has been sent.                    *
+ *************************************************************************************/
+
+BOOL Serial_SendBatch( PORTINFO *pSerial, DWORD dwOnMask, DWORD dwOffMask, DWORD *pdwSent, DWORD *pdwSeen )
+{
+  char  OutBuffer[50];
+  char  InBuffer[RESPONSE_LEN];                            // Store response from ChargeOn module (Arduino) here
+  DWORD dwSendMs = 0;                                      // Longest the ChargeOn module could take to send the codes
+  BYTE  byIdx;
+
+  *pdwSent = *pdwSeen = 0;
+  sprintf( OutBuffer, "%s[On:%lu][Off:%lu][]", BATCH_SIGNAL, (unsigned long)dwOnMask, (unsigned long)dwOffMask );
+  for( byIdx = 0; byIdx < MAX_OUTLETS; byIdx++ ) {         // Allow for every outlet's code being sent
+    if( (dwOnMask | dwOffMask) & (1UL << byIdx) ) {
+      dwSendMs += MaxSendTimeMs( GetOutlet(byIdx) );
+    }
+  }
+
+  if(    !Exchange(pSerial, OutBuffer, BATCH_OK_SIGNAL, InBuffer, sizeof(InBuffer), dwSendMs)
+      || !strstr(InBuffer, "[Sent:") ) {                   // Able to send the signal and get the *expected* response?
+    return FALSE;                                          //  No
+  }
+  *pdwSent = (DWORD)ResponseValue( InBuffer, "Sent", 0 );  //  Yes, see which outlets it sent a code to
+  *pdwSeen = (DWORD)ResponseValue( InBuffer, "Seen", 0 );
+  return TRUE;
+} // Serial_SendBatch()
+
+
+/*************************************************************************************
+ * FUNC: SettingsHash                                                                *
+ * DESC: CRC-16 (CCITT, starting from 0xFFFF) of outlet profiles 0..n-1, worked out  *
+ *       the same way as the sketch does from its copy (8 little-endian DWORDs each) *
+ * ARGS: byCount  = Number of outlet profiles to include                             *
+ *       bAsSent  = TRUE  to hash the profiles as last sent to the ChargeOn module   *
+ *                  FALSE to hash the current ones                                   *
+ * RET:  The hash                                                                    *
+ *************************************************************************************/
+
+static WORD SettingsHash( BYTE byCount, BOOL bAsSent )
+{
+  WORD  wCRC = 0xFFFF;
+  BYTE  byIdx;
+  DWORD i;
+  int   nBit;
+
+  for( byIdx = 0; byIdx < byCount; byIdx++ ) {
+    const BYTE *pByte = bAsSent ? (const BYTE *)&ModuleOutlets[byIdx] : (const BYTE *)GetOutlet( byIdx );
+
+    for( i = 0; i < sizeof(OUTLET); i++ ) {
+      wCRC ^= (WORD)(pByte[i] << 8);
+      for( nBit = 0; nBit < 8; nBit++ ) {
+        wCRC = (wCRC & 0x8000) ? (WORD)((wCRC << 1) ^ 0x1021) : (WORD)(wCRC << 1);
+      }
+    }
+  }
+  return wCRC;
+} // SettingsHash()
+
+
+/*************************************************************************************
+ * FUNC: Serial_CheckSettingsHash                                                    *
+ * DESC: Send HASH signal to microcontroller ("<CO_HASH>[N:n][]"), and compare the   *
+ *       hash of its outlet settings with a hash of ours                             *
+ * ARGS: pSerial = Address of PORTINFO struct for serial connection                  *
+ *       byCount = Number of outlet profiles in use                                  *
+ * RET:  HASH_MATCHES  = The ChargeOn module has the current settings                *
+ *       HASH_DIFFERS  = It doesn't (send them again)                                *
+ *       HASH_NO_REPLY = No (good) response; the port may have gone away, or the     *
+ *                       sketch is too old to know about <CO_HASH>                   *
+ * NOTE: A few dozen bytes each way, so it's cheap enough to use after every resume. *
+ *       If the module still has the settings we last sent it, later SETTINGS        *
+ *       signals only carry the fields that have changed since.                      *
+ *************************************************************************************/
+
+BYTE Serial_CheckSettingsHash( PORTINFO *pSerial, BYTE byCount )
+{
+  char  OutBuffer[25];
+  char  InBuffer[RESPONSE_LEN];                            // Store response from ChargeOn module (Arduino) here
+  WORD  wHash;
+  BYTE  byIdx;
+
+  sprintf( OutBuffer, "%s[N:%u][]", HASH_SIGNAL, byCount );
+  if(    !Exchange(pSerial, OutBuffer, HASH_OK_SIGNAL, InBuffer, sizeof(InBuffer), 0)
+      || !strstr(InBuffer, "[Hash:") ) {                   // Able to send the signal and get the *expected* response?
+    bDeltaOK = FALSE;
+    return HASH_NO_REPLY;                                  //  No
+  }
+
+  wHash = (WORD)ResponseValue( InBuffer, "Hash", 0 );
+  if( wHash == SettingsHash(byCount, FALSE) ) {            // Module has the current settings?
+    for( byIdx = 0; byIdx < byCount; byIdx++ ) {           //  Yes, so that's what it has
+      ModuleOutlets[byIdx] = *GetOutlet( byIdx );
+    }
+    bDeltaOK = TRUE;
+    return HASH_MATCHES;
+  }
+  bDeltaOK = (wHash == SettingsHash(byCount, TRUE));       // Has it still got the ones we last sent?
+  return HASH_DIFFERS;
+} // Serial_CheckSettingsHash()
+
+
+/*************************************************************************************
+ * FUNC: Serial_SendLimits                                                           *
+ * DESC: Send LIMITS signal to microcontroller, "<CO_LIMITS>[Min:n][Max:n][Dead:s][]",*
+ *       so that it makes the MIN/MAX decisions from the samples we send it          *
+ * ARGS: pSerial    = Address of PORTINFO struct for serial connection               *
+ *       dwMin      = Turn the outlet ON when the battery gets down to this %        *
+ *       dwMax      = Turn the outlet OFF when the battery gets up to this %         *
+ *       dwDeadSecs = Turn the outlet ON if no sample arrives for this long          *
+ *                    (0 = hand the decisions back to us)                            *
+ * RET:  LIMITS_OK       = Successfully wrote to port and received expected response *
+ *       LIMITS_UNKNOWN  = The sketch answered with an ERR_UNKNOWN_SIGNAL event      *
+ *                         (it's too old to know about <CO_LIMITS>)                  *
+ *       LIMITS_NO_REPLY = Error while writing/reading, or no (or the wrong) reply   *
+ * NOTE: The ERR_UNKNOWN_SIGNAL event is left queued, so HandleModuleEvents() still  *
+ *       tells the user the sketch is out of date.                                   *
+ *************************************************************************************/
+
+BYTE Serial_SendLimits( PORTINFO *pSerial, DWORD dwMin, DWORD dwMax, DWORD dwDeadSecs )
+{
+  char OutBuffer[50];
+  char InBuffer[RESPONSE_LEN];                             // Store response from ChargeOn module (Arduino) here
+  BYTE byQueued = byEventCount;                            // Events queued before this exchange
+  BYTE byIdx;
+
+  sprintf( OutBuffer, "%s[Min:%lu][Max:%lu][Dead:%lu][]",
+                      LIMITS_SIGNAL,
+                      (unsigned long)dwMin,
+                      (unsigned long)dwMax,
+                      (unsigned long)dwDeadSecs );
+  if( Exchange(pSerial, OutBuffer, LIMITS_OK_SIGNAL, InBuffer, sizeof(InBuffer), 0) ) {
+    return LIMITS_OK;
+  }
+
+  if( byEventCount == EVENT_QUEUE_LEN ) {                  // (Queue overflowed? Then older events have moved down)
+    byQueued = 0;
+  }
+  for( byIdx = byQueued; byIdx < byEventCount; byIdx++ ) { // Did the module answer with an error event instead?
+    if(    (EventQueue[byIdx].byType == EVT_ERROR)
+        && (Serial_EventValue(&EventQueue[byIdx], "Err", 0) == ERR_UNKNOWN_SIGNAL) ) {
+      return LIMITS_UNKNOWN;                               //  Yes, it doesn't know <CO_LIMITS>
+    }
+  }
+  return LIMITS_NO_REPLY;
+} // Serial_SendLimits()
+
+
+/*************************************************************************************
+ * FUNC: Serial_SendSample                                                           *
+ * DESC: Send SAMPLE signal to microcontroller, "<CO_SAMPLE>[P:pct][L:line][]", and  *
+ *       find out what it did about it                                               *
+ * ARGS: pSerial  = Address of PORTINFO struct for serial connection                 *
+ *       byPct    = Battery percentage (UNKNOWN_PERCENT if not known)                *
+ *       byLine   = AC line status (UNKNOWN_STATUS if not known)                     *
+ *       pbyAct   = Receives SAMPLE_ACT_NONE, SAMPLE_ACT_ON or SAMPLE_ACT_OFF        *
+ *       pbArmed  = Receives FALSE if the ChargeOn module isn't making the decisions *
+ *                  (it has restarted since Serial_SendLimits(), say)                *
+ *       pdwTrips = Receives the number of times its dead-man timer has gone off     *
+ * RET:  TRUE  = Successfully wrote to port and received expected response           *
+ *       FALSE = Error while writing/reading, or received unexpected response        *
+ *************************************************************************************/
+
+BOOL Serial_SendSample( PORTINFO *pSerial, BYTE byPct, BYTE byLine, BYTE *pbyAct, BOOL *pbArmed, DWORD *pdwTrips )
+{
+  char OutBuffer[30];
+  char InBuffer[RESPONSE_LEN];                             // Store response from ChargeOn module (Arduino) here
+
+  sprintf( OutBuffer, "%s[P:%u][L:%u][]", SAMPLE_SIGNAL, byPct, byLine );
+  if(    !Exchange(pSerial, OutBuffer, SAMPLE_OK_SIGNAL, InBuffer, sizeof(InBuffer), 0)
+      || !strstr(InBuffer, "[Arm:") ) {                    // Able to send the signal and get the *expected* response?
+    return FALSE;                                          //  No
+  }
+  *pbyAct   = (BYTE) ResponseValue( InBuffer, "Act",  SAMPLE_ACT_NONE );
+  *pbArmed  = (BOOL) ResponseValue( InBuffer, "Arm",  0 );
+  *pdwTrips = (DWORD)ResponseValue( InBuffer, "Trip", 0 );
+  return TRUE;
+} // Serial_SendSample()
+
+
+/*************************************************************************************
+ * FUNC: Serial_PollEvents                                                           *
+ * DESC: Collect any event frames the ChargeOn module has sent on its own            *
+ * ARGS: pSerial = Address of PORTINFO struct for serial connection                  *
+ * RET:  TRUE  = There are events waiting (collect them with Serial_NextEvent())     *
+ *       FALSE = None                                                                *
+ * NOTE: Cheap enough to call several times a second: the port is only read if the  *
+ *       driver has received something, and nothing is sent to the module.           *
+ *       Events that arrive in the middle of another exchange are queued by it.      *
+ *************************************************************************************/
+
+BOOL Serial_PollEvents( PORTINFO *pSerial )
+{
+  COMSTAT comStat;
+  DWORD   dwErrors;
+
+  if( bDoingTX_RX || bInitializingPort ) {                 // Port in use?
+    return byEventCount > 0;                               //  Yes, the exchange will queue any events
+  }
+  if( !ClearCommError(pSerial->hComPort, &dwErrors, &comStat) ) {
+    bLinkSuspect = TRUE;                                   // Port has gone (e.g. USB cable pulled)? Check at the next battery check
+  }
+  else if( comStat.cbInQue ) {                             // Has the module sent something?
+    bDoingTX_RX = TRUE;                                    //  Yes, read it
+    ReadEvents( pSerial->hComPort );
+    bDoingTX_RX = FALSE;
+  }
+  return byEventCount > 0;
+} // Serial_PollEvents()
+
+
+/*************************************************************************************
+ * FUNC: Serial_HeardWithin                                                          *
+ * DESC: Has the ChargeOn module answered recently (with no failures since)?         *
+ * ARGS: dwIdleMs = How recently                                                     *
+ * RET:  TRUE  = Yes; no need for a heartbeat                                        *
+ *       FALSE = No; send one                                                        *
+ * NOTE: Any successful exchange (or event) counts, so a <CO_BEAT> is only needed    *
+ *       when the link has been quiet.                                               *
+ *************************************************************************************/
+
+BOOL Serial_HeardWithin( DWORD dwIdleMs )
+{
+  return !bLinkSuspect && (GetTickCount() - dwLastHeardTick < dwIdleMs);
+} // Serial_HeardWithin()
+
+
+/*************************************************************************************
+ * FUNC: Serial_LinkSuspect                                                          *
+ * DESC: Note that something sent to the ChargeOn module didn't get through          *
+ * ARGS: [None]                                                                      *
+ * RET:  [None]                                                                      *
+ * NOTE: Serial_HeardWithin() then says no until the module answers again, so the    *
+ *       next battery check sends a heartbeat (and reconnects if that fails).        *
+ *************************************************************************************/
+
+void Serial_LinkSuspect( void )
+{
+  bLinkSuspect = TRUE;
+} // Serial_LinkSuspect()
+
+
+/*************************************************************************************
+ * FUNC: Serial_NextEvent                                                            *
+ * DESC: Take the oldest event off the queue                                         *
+ * ARGS: pEvent = Address of MODULE_EVENT to receive it                              *
+ * RET:  TRUE  = Got one                                                             *
+ *       FALSE = The queue is empty                                                  *
+ *************************************************************************************/
+
+BOOL Serial_NextEvent( MODULE_EVENT *pEvent )
+{
+  return TakeEvent( 0, pEvent );
+} // Serial_NextEvent()
+
+
+/*************************************************************************************
+ * FUNC: Serial_EventValue                                                           *
+ * DESC: Find "[Name:value]" in an event                                             *
+ * ARGS: pEvent   = The event                                                        *
+ *       szName   = Name of the value                                                *
+ *       lDefault = What to return if it isn't there                                 *
+ * RET:  The value                                                                   *
+ *************************************************************************************/
+
+long Serial_EventValue( const MODULE_EVENT *pEvent, const char *szName, long lDefault )
+{
+  return ResponseValue( pEvent->szFields, szName, lDefault );
+} // Serial_EventValue()
+
+
+/*************************************************************************************
+ * FUNC: FormatLogEntry                                                              *
+ * DESC: Turn one entry from the ChargeOn module's log into a line of text           *
+ * ARGS: szLine = Buffer (at least 160 bytes) to receive the line (with its "\n")    *
+ *       pHex   = The entry: LOG_ENTRY_LEN hex digits (time, code, byArg, lArg)      *
+ * RET:  [None]                                                                      *
+ * NOTE: Codes from a newer sketch than this program are shown as numbers.           *
+ *************************************************************************************/
+
+static void FormatLogEntry( char *szLine, const char *pHex )
+{
+  char          szEntry[LOG_ENTRY_LEN + 1];
+  unsigned long ulMs   = 0;
+  unsigned int  uCode  = 0;
+  unsigned int  uArg   = 0;
+  unsigned long ulArg  = 0;
+  const char   *pText;
+
+  memcpy( szEntry, pHex, LOG_ENTRY_LEN );
+  szEntry[LOG_ENTRY_LEN] = '\0';
+  sscanf( szEntry, "%8lx%2x%2x%8lx", &ulMs, &uCode, &uArg, &ulArg );
+  szLine += sprintf( szLine, "%7lu.%03lu  ", ulMs / 1000, ulMs % 1000 );
+
+  if( uCode >= sizeof(LogTexts) / sizeof(LogTexts[0]) ) {  // Know what it means?
+    sprintf( szLine, "Event %u: %u, %lu\n", uCode, uArg, ulArg );
+    return;                                                //  No, just show the numbers
+  }
+  for( pText = LogTexts[uCode].szText; *pText; pText++ ) {
+    if( !strncmp(pText, "{b}", 3) ) {
+      szLine += sprintf( szLine, "%u", uArg );
+      pText  += 2;
+    }
+    else if( !strncmp(pText, "{l}", 3) ) {
+      switch( LogTexts[uCode].byHow ) {
+        case LA_TEXT4:                                     // Up to 4 characters, first one in the top byte
+          for( int nShift = 24; nShift >= 0; nShift -= 8 ) {
+            if( (ulArg >> nShift) & 0xFF ) {
+              *szLine++ = (char)((ulArg >> nShift) & 0xFF);
+            }
+          }
+          break;
+        case LA_BYTES4:
+          szLine += sprintf( szLine, "%lu/%lu/%lu/%lu",
+                                     (ulArg >> 24) & 0xFF, (ulArg >> 16) & 0xFF,
+                                     (ulArg >>  8) & 0xFF,  ulArg        & 0xFF );
+          break;
+        default:
+          szLine += sprintf( szLine, "%ld", (long)ulArg );
+          break;
+      }
+      pText += 2;
+    }
+    else {
+      *szLine++ = *pText;
+    }
+  }
+  strcpy( szLine, "\n" );
+} // FormatLogEntry()
+
+
+/*************************************************************************************
+ * FUNC: Serial_FetchLog                                                             *
+ * DESC: Fetch the ChargeOn module's log (what it has been doing), as text           *
+ * ARGS: pSerial  = Address of PORTINFO struct for serial connection                 *
+ *       szText   = Buffer to receive the text (one line per event, oldest first)    *
+ *       dwSize   = Size of szText                                                   *
+ *       pdwLost  = Receives the number of events the module had to throw away       *
+ *                  before anyone fetched them                                       *
+ * RET:  TRUE  = Got it (all of it, unless szText filled up)                         *
+ *       FALSE = Error while writing/reading, or unexpected response (e.g. from a    *
+ *               sketch too old to know about <CO_LOG>)                              *
+ * NOTE: The module sends a few events per <CO_LOG>, so this asks until it says      *
+ *       there are no more ("[More:0]"). Entries are removed from the module as      *
+ *       they are sent, so each event is only ever fetched once.                     *
+ *************************************************************************************/
+
+BOOL Serial_FetchLog( PORTINFO *pSerial, char *szText, DWORD dwSize, DWORD *pdwLost )
+{
+  char        InBuffer[RESPONSE_LEN];                      // Store response from ChargeOn module (Arduino) here
+  char        szLine[160];
+  const char *pHex;
+  DWORD       dwLen = 0;
+
+  szText[0] = '\0';
+  *pdwLost  = 0;
+  for( int nReply = 0; nReply < LOG_MAX_REPLIES; nReply++ ) {
+    if(    !Exchange(pSerial, LOG_SIGNAL, LOG_OK_SIGNAL, InBuffer, sizeof(InBuffer), 0)
+        || !(pHex = strstr(InBuffer, "[D:")) ) {           // Able to send the signal and get the *expected* response?
+      return FALSE;                                        //  No
+    }
+    *pdwLost = (DWORD)ResponseValue( InBuffer, "Lost", 0 );
+
+    for( pHex += 3; strspn(pHex, "0123456789ABCDEFabcdef") >= LOG_ENTRY_LEN; pHex += LOG_ENTRY_LEN ) {
+      FormatLogEntry( szLine, pHex );
+      if( dwLen + strlen(szLine) < dwSize ) {              // Room for it?
+        strcpy( szText + dwLen, szLine );                  //  Yes
+        dwLen += strlen( szLine );
+      }
+    }
+    if( ResponseValue(InBuffer, "More", 0) == 0 ) {        // Anything left?
+      break;                                               //  No, that's the lot
+    }
+  }
+  return TRUE;
+} // Serial_FetchLog()
+
+
+/*************************************************************************************
+ * FUNC: Serial_GetStats                                                             *
+ * DESC: Ask the ChargeOn module how it has been performing                          *
+ * ARGS: pSerial = Address of PORTINFO struct for serial connection                  *
+ *       pStats  = Receives the statistics                                           *
+ * RET:  TRUE  = Got them                                                            *
+ *       FALSE = Error while writing/reading, or unexpected response (e.g. from a    *
+ *               sketch too old to know about <CO_STATS>)                            *
+ * NOTE: Three short exchanges ("[P:0]" to "[P:2]"), as all of it won't fit in one   *
+ *       response.                                                                   *
+ *************************************************************************************/
+
+BOOL Serial_GetStats( PORTINFO *pSerial, MODULE_STATS *pStats )
+{
+  char        OutBuffer[30];
+  char        InBuffer[RESPONSE_LEN];                      // Store response from ChargeOn module (Arduino) here
+  const char *pValue;
+
+  memset( pStats, 0, sizeof(*pStats) );
+  for( int nPage = 0; nPage < 3; nPage++ ) {
+    sprintf( OutBuffer, "%s[P:%d][]", STATS_SIGNAL, nPage );
+    if( !Exchange(pSerial, OutBuffer, STATS_OK_SIGNAL, InBuffer, sizeof(InBuffer), 0) ) {
+      return FALSE;
+    }
+    switch( nPage ) {
+      case 0:
+        pStats->dwUpSecs       = (DWORD)ResponseValue( InBuffer, "Up",    0 );
+        pStats->dwLoopHz       = (DWORD)ResponseValue( InBuffer, "Hz",    0 );
+        pStats->dwIdlePermille = (DWORD)ResponseValue( InBuffer, "Idle",  0 );
+        pStats->dwWorstSliceUs = (DWORD)ResponseValue( InBuffer, "Slice", 0 );
+        pStats->dwLearnTries   = (DWORD)ResponseValue( InBuffer, "Lrn",   0 );
+        pStats->dwEEPROMWrites = (DWORD)ResponseValue( InBuffer, "EE",    0 );
+        break;
+
+      case 1:
+        pStats->dwOverruns     = (DWORD)ResponseValue( InBuffer, "Ovr",   0 );
+        pStats->dwBytesIn      = (DWORD)ResponseValue( InBuffer, "In",    0 );
+        pStats->dwBytesOut     = (DWORD)ResponseValue( InBuffer, "Out",   0 );
+        pStats->dwRFFrames     = (DWORD)ResponseValue( InBuffer, "RF",    0 );
+        break;
+
+      default:                                             // "[Cmd:us,us,...]"
+        if( (pValue = strstr(InBuffer, "[Cmd:")) != NULL ) {
+          pValue += 4;
+          while( (*pValue == ':' || *pValue == ',') && (pStats->byCommands < STATS_MAX_COMMANDS) ) {
+            pStats->dwCmdWorstUs[pStats->byCommands++] = strtoul( pValue + 1, (char **)&pValue, 10 );
+          }
+        }
+        break;
+    }
+  }
+  return TRUE;
+} // Serial_GetStats()
+
+
+/*************************************************************************************
+ * FUNC: Serial_FormatStats                                                          *
+ * DESC: Describe the ChargeOn module's statistics (for a message box)               *
+ * ARGS: pStats   = The statistics (from Serial_GetStats())                          *
+ *       szBuffer = Buffer (at least 1024 bytes) to receive the text                 *
+ * RET:  [None]                                                                      *
+ *************************************************************************************/
+
+void Serial_FormatStats( const MODULE_STATS *pStats, char *szBuffer )
+{
+  szBuffer += sprintf( szBuffer,
+                       "Running for:\t\t%lu s\n"
+                       "Main loop:\t\t%lu passes/s\n"
+                       "Asleep:\t\t\t%lu.%lu %%\n"
+                       "Longest task:\t\t%lu us\n"
+                       "Learn attempts:\t\t%lu\n"
+                       "EEPROM writes:\t\t%lu\n\n"
+                       "Bytes received:\t\t%lu\n"
+                       "Bytes sent:\t\t%lu\n"
+                       "Bytes lost (overrun):\t%lu\n"
+                       "RF frames sent:\t\t%lu\n\n"
+                       "Longest handling time (us):",
+                       (unsigned long)pStats->dwUpSecs,
+                       (unsigned long)pStats->dwLoopHz,
+                       (unsigned long)pStats->dwIdlePermille / 10,
+                       (unsigned long)pStats->dwIdlePermille % 10,
+                       (unsigned long)pStats->dwWorstSliceUs,
+                       (unsigned long)pStats->dwLearnTries,
+                       (unsigned long)pStats->dwEEPROMWrites,
+                       (unsigned long)pStats->dwBytesIn,
+                       (unsigned long)pStats->dwBytesOut,
+                       (unsigned long)pStats->dwOverruns,
+                       (unsigned long)pStats->dwRFFrames );
+  for( int i = 0; i < pStats->byCommands; i++ ) {
+    if( i < (int)(sizeof(StatsCommands) / sizeof(StatsCommands[0])) ) {
+      szBuffer += sprintf( szBuffer, "\n   %s:\t\t%lu", StatsCommands[i], (unsigned long)pStats->dwCmdWorstUs[i] );
+    }
+    else {
+      szBuffer += sprintf( szBuffer, "\n   Signal %d:\t\t%lu", i, (unsigned long)pStats->dwCmdWorstUs[i] );
+    }
+  }
+} // Serial_FormatStats()
+
+
+/*************************************************************************************
+ * FUNC: Serial_FormatStatsCSV                                                       *
+ * DESC: Turn the ChargeOn module's statistics into a line for a CSV file            *
+ * ARGS: pStats   = The statistics (from Serial_GetStats())                          *
+ *       szBuffer = Buffer (at least 600 bytes) to receive the line (with its "\n")  *
+ *       bHeader  = TRUE for the column names instead                                *
+ * RET:  [None]                                                                      *
+ * NOTE: There is a column for each signal this program knows about; a newer         *
+ *       sketch's extra signals are left out, and an older one's missing ones are    *
+ *       left blank.                                                                 *
+ *************************************************************************************/
+
+void Serial_FormatStatsCSV( const MODULE_STATS *pStats, char *szBuffer, BOOL bHeader )
+{
+  SYSTEMTIME stNow;
+
+  if( bHeader ) {
+    szBuffer += sprintf( szBuffer, "Time,UpSecs,LoopHz,IdlePermille,WorstSliceUs,LearnTries,EEPROMWrites,"
+                                   "Overruns,BytesIn,BytesOut,RFFrames" );
+    for( int i = 0; i < (int)(sizeof(StatsCommands) / sizeof(StatsCommands[0])); i++ ) {
+      szBuffer += sprintf( szBuffer, ",%sUs", StatsCommands[i] );
+    }
+    strcpy( szBuffer, "\n" );
+    return;
+  }
+
+  GetLocalTime( &stNow );
+  szBuffer += sprintf( szBuffer, "%04u-%02u-%02u %02u:%02u:%02u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+                                 stNow.wYear, stNow.wMonth, stNow.wDay,
+                                 stNow.wHour, stNow.wMinute, stNow.wSecond,
+                                 (unsigned long)pStats->dwUpSecs,
+                                 (unsigned long)pStats->dwLoopHz,
+                                 (unsigned long)pStats->dwIdlePermille,
+                                 (unsigned long)pStats->dwWorstSliceUs,
+                                 (unsigned long)pStats->dwLearnTries,
+                                 (unsigned long)pStats->dwEEPROMWrites,
+                                 (unsigned long)pStats->dwOverruns,
+                                 (unsigned long)pStats->dwBytesIn,
+                                 (unsigned long)pStats->dwBytesOut,
+                                 (unsigned long)pStats->dwRFFrames );
+  for( int i = 0; i < (int)(sizeof(StatsCommands) / sizeof(StatsCommands[0])); i++ ) {
+    if( i < pStats->byCommands ) {
+      szBuffer += sprintf( szBuffer, ",%lu", (unsigned long)pStats->dwCmdWorstUs[i] );
+    }
+    else {
+      *szBuffer++ = ',';
+    }
+  }
+  strcpy( szBuffer, "\n" );
+} // Serial_FormatStatsCSV()
@@ -21,6 +21,40 @@
 # define MAX_PORT_NUM (256)                      // Highest COM port number we will check for an available ChargeOn module
 # define MAX_NAME_LEN (256)                      // Generous size for name strings
 
+# define RF_ECHO_MISSED   0                      // byRFEcho: ChargeOn module didn't hear its own ON/OFF code
+# define RF_ECHO_SEEN     1                      //           ChargeOn module heard its own ON/OFF code
+# define RF_ECHO_UNKNOWN  255                    //           Not known (Outlet.Loopback is off, sketch has no Timer1, or older sketch)
+
+# define HASH_MATCHES     0                      // Serial_CheckSettingsHash(): ChargeOn module has our outlet settings
+# define HASH_DIFFERS     1                      //                             It has different ones
+# define HASH_NO_REPLY    2                      //                             Can't tell (no module, or older sketch)
+
+# define LIMITS_OK        0                      // Serial_SendLimits(): ChargeOn module is making the decisions
+# define LIMITS_UNKNOWN   1                      //                      It said it doesn't know <CO_LIMITS> (older sketch)
+# define LIMITS_NO_REPLY  2                      //                      No (or the wrong) answer; try again later
+
+# define SAMPLE_ACT_NONE  0                      // Serial_SendSample(): ChargeOn module left the outlet alone
+# define SAMPLE_ACT_ON    1                      //                      It sent the ON code (battery at MIN)
+# define SAMPLE_ACT_OFF   2                      //                      It sent the OFF code (battery at MAX)
+
+# define EVT_BOOT         1                      // MODULE_EVENT.byType: ChargeOn module has just (re)started
+# define EVT_SENT         2                      //                      It finished sending an ON/OFF code ("[On:n]")
+# define EVT_LEARNED      3                      //                      It heard a remote control ("[Code:n]...")
+# define EVT_ERROR        4                      //                      Something went wrong ("[Err:n]")
+# define EVT_DEADMAN      5                      //                      Its dead-man timer turned the outlet ON ("[Trip:n]")
+
+# define ERR_LEARN_TIMEOUT  1                    // EVT_ERROR "[Err:n]": No remote control heard while learning
+# define ERR_UNKNOWN_SIGNAL 2                    //                      Signal the sketch doesn't recognize (it's older than us)
+# define ERR_SAVE_FAILED    3                    //                      Outlet settings couldn't be written to its EEPROM
+
+# define EVENT_QUEUE_LEN  8                      // Events kept until Serial_NextEvent() collects them (oldest dropped first)
+# define EVENT_POLL_MS    250                    // How often to look for events (IDT_TIMER3)
+
+# define HEARTBEAT_IDLE_MS 60000                 // Only send <CO_BEAT> if nothing has been heard from the module for this long
+
+# define STATS_MAX_COMMANDS 24                   // Signals whose handling time MODULE_STATS can hold
+# define STATS_POLL_MS     60000                 // How often to log the ChargeOn module's statistics, once asked to (IDT_TIMER4)
+
     /* Typedefs */
   typedef TCHAR NAMESTRING[MAX_NAME_LEN];
 
@@ -40,9 +74,38 @@
                  LEARN,                          // 6
                  VERSION,                        // 7
                  EEPROM,                         // 8
-                 MAX_EXCHANGE_TYPE               // 9
+                 BATCH,                          // 9
+                 MAX_EXCHANGE_TYPE               // 10
                } SerialExchangeType;
 
+  typedef struct {                               // Unsolicited "<CO_EVT>[E:n]...[]" frame from the ChargeOn module
+    BYTE byType;                                 // EVT_xxx
+    char szFields[60];                           // "[E:n][Name:value]..." (read with Serial_EventValue())
+  } MODULE_EVENT;
+
+  typedef struct {                               // What the ChargeOn module last said about itself ("[Up:secs][Gen:n]")
+    BOOL  bKnown;                                // Has it told us? (Older sketches don't)
+    DWORD dwUpSecs;                              // How long it had been running
+    DWORD dwGen;                                 // How many times its outlet settings had been changed since it started
+    BOOL  bRestarted;                            // Uptime went backwards since the previous report (caller clears this)
+  } MODULE_STATUS;
+
+  typedef struct {                               // What the ChargeOn module says about its own performance (<CO_STATS>)
+    DWORD dwUpSecs;                              // How long it has been running (everything below is since then)
+    DWORD dwLoopHz;                              // Passes through its main loop a second
+    DWORD dwIdlePermille;                        // Thousandths of that second it spent asleep (0 = older sketch, or busy)
+    DWORD dwWorstSliceUs;                        // Longest any one task has kept the loop busy
+    DWORD dwLearnTries;                          // LEARN/LEARN_START signals received
+    DWORD dwEEPROMWrites;                        // Outlet settings records written to EEPROM
+    DWORD dwOverruns;                            // Bytes lost because its receive buffer was full
+    DWORD dwBytesIn;                             // Bytes received from us
+    DWORD dwBytesOut;                            // Bytes sent to us
+    DWORD dwRFFrames;                            // ON/OFF code frames sent over the air
+    BYTE  byCommands;                            // Entries in dwCmdWorstUs[]
+    DWORD dwCmdWorstUs[STATS_MAX_COMMANDS];      // Longest it has taken to handle each signal (in the sketch's
+                                                 //  COMMANDS order; 65535 = that or longer)
+  } MODULE_STATS;
+
   typedef struct { const char *signal;
                    const char *expectedResponse;
                    const char *errorMessage;
@@ -51,15 +114,40 @@
     /* Global variables */
 extern BOOL bInitializingPort;                             // Flags to prevent certain processes while serial port is being initialized
 extern BOOL bDoingTX_RX;                                   // In the process of communicating with the serial port?
+extern BYTE byRFEcho;                                      // Did the ChargeOn module hear the last ON/OFF code it sent?
+extern MODULE_STATUS ModuleStatus;                         // What the ChargeOn module last said about itself
 
 
     /* Global function prototypes */
   BOOL InitSerial(              PORTINFO           *phSerialPort );
+  BOOL Serial_Reopen(           PORTINFO           *phSerialPort );
   BOOL SendSignal_GetResponse(  PORTINFO           *phSerialPort,  SerialExchangeType talkType );
   BOOL Serial_GetOutletInfo(    HWND               hParentWnd,     PORTINFO           *pSerial,
                                 SerialExchangeType requestType,    void               *pOutlet );
   BOOL GetArduinoSketchVersion( HWND               hParentWnd,     PORTINFO           *pSerial,
                                 char               *szArduinoSketchVersion );
+  BOOL Serial_SendOutletProfiles( PORTINFO         *pSerial,       BYTE               byCount );
+  BOOL Serial_SendBatch(        PORTINFO           *pSerial,       DWORD              dwOnMask,
+                                DWORD              dwOffMask,      DWORD              *pdwSent,
+                                DWORD              *pdwSeen );
+  BYTE Serial_CheckSettingsHash( PORTINFO          *pSerial,       BYTE               byCount );
+  BYTE Serial_SendLimits(       PORTINFO           *pSerial,       DWORD              dwMin,
+                                DWORD              dwMax,          DWORD              dwDeadSecs );
+  BOOL Serial_SendSample(       PORTINFO           *pSerial,       BYTE               byPct,
+                                BYTE               byLine,         BYTE               *pbyAct,
+                                BOOL               *pbArmed,       DWORD              *pdwTrips );
+  BOOL Serial_PollEvents(       PORTINFO           *pSerial );
+  BOOL Serial_HeardWithin(      DWORD              dwIdleMs );
+  void Serial_LinkSuspect(      void );
+  BOOL Serial_NextEvent(        MODULE_EVENT       *pEvent );
+  long Serial_EventValue(       const MODULE_EVENT *pEvent,        const char         *szName,
+                                long               lDefault );
+  BOOL Serial_FetchLog(         PORTINFO           *pSerial,       char               *szText,
+                                DWORD              dwSize,         DWORD              *pdwLost );
+  BOOL Serial_GetStats(         PORTINFO           *pSerial,       MODULE_STATS       *pStats );
+  void Serial_FormatStats(      const MODULE_STATS *pStats,        char               *szBuffer );
+  void Serial_FormatStatsCSV(   const MODULE_STATS *pStats,        char               *szBuffer,
+                                BOOL               bHeader );
 
 
 #endif
@@ -212,7 +212,8 @@ BOOL CALLBACK OutletDlgProc( HWND hOutletDlg, UINT message, WPARAM wParam, LPARA
 			switch( ((NMHDR *)lParam)->code ) {
 			  case PSN_APPLY:       				                     // User clicked OK or APPLY; it is this page's turn to validate/save values
         {
-          BOOL bTranslatedOK;
+          BOOL  bTranslatedOK;
+          DWORD dwOldRepeats = Outlet.PulseRepeats;
 
           Outlet.OnCode           = GetDlgItemInt( hOutletDlg, IDC_OUTLET_ON_CODE,      &bTranslatedOK, FALSE );
           Outlet.OffCode          = GetDlgItemInt( hOutletDlg, IDC_OUTLET_OFF_CODE,     &bTranslatedOK, FALSE );
@@ -221,6 +222,9 @@ BOOL CALLBACK OutletDlgProc( HWND hOutletDlg, UINT message, WPARAM wParam, LPARA
           Outlet.PulseRepeats     = GetDlgItemInt( hOutletDlg, IDC_OUTLET_PULSEREPEATS, &bTranslatedOK, FALSE );
           Outlet.TurnOnBeforeQuit = IsDlgButtonChecked( hOutletDlg, IDC_TURNON_BEFOREQUIT ) ? 1 : 0;
           Outlet.ValueLength      = GetDlgItemInt( hOutletDlg, IDC_OUTLET_CODELENGTH,   &bTranslatedOK, FALSE );
+          if( Outlet.PulseRepeats != dwOldRepeats ) {      // User entered a new PulseRepeats?
+            Repeats_Init( &RepeatTuner, Outlet.PulseRepeats );//  Yes, start tuning over from it
+          }
 
           SetWindowLongPtr( hOutletDlg, DWLP_MSGRESULT, PSNRET_NOERROR );
                                                            // This page has no data validation issues
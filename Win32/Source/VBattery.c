@@ -0,0 +1,273 @@
+/*****************************************************************************
+ * FILE: VBattery.c                                                          *
+ * DESC: Virtual (simulated) laptop battery                                  *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: A simple physical model of a lithium-ion laptop battery, its        *
+ *       charger and the laptop's load, used for closed-loop testing without *
+ *       waiting hours for a real battery to charge and discharge.           *
+ *                                                                           *
+ *       Charging follows the usual CC/CV curve: full power up to the CV     *
+ *       threshold, then tapering off in proportion to the remaining charge  *
+ *       until the charger cuts off. The laptop's load is supplied by the AC *
+ *       adapter first (so a heavy load slows charging down), or by the      *
+ *       battery when the outlet is OFF. What "Windows" reports is quantized *
+ *       and refreshed only every so often, just like BatteryLifePercent.    *
+ *                                                                           *
+ *       Like Policy.c, this module makes no Windows API calls, so it can    *
+ *       run many thousands of times faster than real time in the tools.    *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <string.h>                    // For memset()
+#include "VBattery.h"
+
+  /* Defines */
+#define RECHARGE_PCT   3.0             // Charger restarts once a "full" battery drops this far
+
+  /* Typedefs */
+
+  /* Static variables */
+static const VBATTERY_LOAD DefaultLoad[] = { { 20*60,  8.0f },   // Reading / typing
+                                             { 10*60, 25.0f },   // Browsing / video
+                                             {  5*60, 45.0f },   // Compiling
+                                             { 25*60, 12.0f } }; // Light use
+
+  /* Function prototypes */
+static double ChargePower(  const VBATTERY *pBatt );
+static void   UpdateReport( VBATTERY *pBatt );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: ChargePower                                                         *
+ * DESC: Work out how much power is flowing into (or out of) the battery     *
+ * ARGS: pBatt = Address of VBATTERY structure                               *
+ * RET:  Power in watts (positive = charging, negative = discharging)        *
+ *****************************************************************************/
+static double ChargePower( const VBATTERY *pBatt )
+{
+  const VBATTERY_CONFIG *pCfg = &pBatt->Config;
+  double                 dPct = VBattery_Percent( pBatt );
+  double                 dPower;
+
+  if( !pBatt->bOutletOn ) {                                // Running on battery?
+    return -pBatt->dLoadW;                                 //  Yes, battery supplies the whole load
+  }
+
+  dPower = pCfg->dAdapterW - pBatt->dLoadW;                // What's left over from the adapter after the load
+  if( dPower < 0 ) {                                       // Adapter can't keep up with the load?
+    return dPower;                                         //  Yes, battery makes up the difference
+  }
+  if( pBatt->bFull ) {                                     // Charger has terminated?
+    return 0;
+  }
+
+  if( dPower > pCfg->dMaxChargeW ) {                       // Constant-current phase
+    dPower = pCfg->dMaxChargeW;
+  }
+  if( dPct > pCfg->dCvStartPct ) {                         // Constant-voltage phase: taper off towards 100%
+    double dTaper = pCfg->dMaxChargeW * (100.0 - dPct) / (100.0 - pCfg->dCvStartPct);
+
+    if( dTaper < dPower ) {
+      dPower = dTaper;
+    }
+  }
+  return dPower * pCfg->dEfficiency;
+}
+
+
+/*****************************************************************************
+ * FUNC: UpdateReport                                                        *
+ * DESC: Refresh what "Windows" reports about the battery, if it's time to   *
+ * ARGS: pBatt = Address of VBATTERY structure                               *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void UpdateReport( VBATTERY *pBatt )
+{
+  if( (LONG)(pBatt->dwNowMs - pBatt->dwNextReportMs) >= 0 ) {
+    DWORD dwStep = pBatt->Config.dwReportStepPct ? pBatt->Config.dwReportStepPct : 1;
+    DWORD dwPct  = (DWORD)VBattery_Percent( pBatt );
+
+    pBatt->byReportedPct   = (BYTE)(pBatt->bFull ? 100 : (dwPct / dwStep) * dwStep);
+    pBatt->dwNextReportMs += pBatt->Config.dwReportMs ? pBatt->Config.dwReportMs : 1;
+  }
+  if( (LONG)(pBatt->dwNowMs - pBatt->dwLineAtMs) >= 0 ) {
+    pBatt->byReportedLine = (BYTE)(pBatt->bOutletOn ? 1 : 0);
+  }
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: VBattery_InitConfig                                                 *
+ * DESC: Populate a VBATTERY_CONFIG structure for a typical 14" laptop       *
+ * ARGS: pConfig = Address of VBATTERY_CONFIG structure to populate          *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void VBattery_InitConfig( VBATTERY_CONFIG *pConfig )
+{
+  pConfig->dCapacityWh     = 50.0;
+  pConfig->dAdapterW       = 65.0;
+  pConfig->dMaxChargeW     = 45.0;
+  pConfig->dCvStartPct     = 80.0;
+  pConfig->dCutoffW        = 2.5;                          // (About C/20)
+  pConfig->dEfficiency     = 0.92;
+  pConfig->dIdleW          = 10.0;
+  pConfig->pLoad           = DefaultLoad;
+  pConfig->dwLoadSteps     = sizeof(DefaultLoad) / sizeof(DefaultLoad[0]);
+  pConfig->dwReportStepPct = 1;
+  pConfig->dwReportMs      = 30000;
+  pConfig->dwLineLagMs     = 1000;
+}
+
+
+/*****************************************************************************
+ * FUNC: VBattery_Init                                                       *
+ * DESC: Start a new simulated battery                                       *
+ * ARGS: pBatt      = Address of VBATTERY structure to initialize            *
+ *       pConfig    = Address of the battery's characteristics               *
+ *       byStartPct = Initial charge level                                   *
+ *       bOutletOn  = Is the outlet ON to begin with?                        *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void VBattery_Init( VBATTERY *pBatt, const VBATTERY_CONFIG *pConfig, BYTE byStartPct, BOOL bOutletOn )
+{
+  memset( pBatt, 0, sizeof(*pBatt) );
+  pBatt->Config    = *pConfig;
+  pBatt->dEnergyWh = pConfig->dCapacityWh * (byStartPct > 100 ? 100 : byStartPct) / 100.0;
+  pBatt->dLoadW    = pConfig->dIdleW;
+  pBatt->bOutletOn = bOutletOn;
+  if( pConfig->pLoad && pConfig->dwLoadSteps ) {           // Following a load profile?
+    pBatt->dLoadW       = pConfig->pLoad[0].fWatts;        //  Yes, start at the beginning
+    pBatt->dwLoadLeftMs = pConfig->pLoad[0].dwSecs * 1000;
+  }
+  UpdateReport( pBatt );                                   // (Both reports are due at time 0)
+}
+
+
+/*****************************************************************************
+ * FUNC: VBattery_SetOutlet                                                  *
+ * DESC: Turn the simulated outlet ON or OFF                                 *
+ * ARGS: pBatt = Address of VBATTERY structure                               *
+ *       bOn   = TRUE to turn the outlet ON, FALSE to turn it OFF            *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void VBattery_SetOutlet( VBATTERY *pBatt, BOOL bOn )
+{
+  bOn = bOn ? TRUE : FALSE;
+  if( bOn != pBatt->bOutletOn ) {                          // Outlet actually changing state?
+    pBatt->bOutletOn  = bOn;                               //  Yes, Windows will notice shortly
+    pBatt->bFull      = FALSE;                             //  (Plugging in again restarts the charger)
+    pBatt->dwLineAtMs = pBatt->dwNowMs + pBatt->Config.dwLineLagMs;
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: VBattery_SetLoad                                                    *
+ * DESC: Set the laptop's load (when not following a load profile)          *
+ * ARGS: pBatt  = Address of VBATTERY structure                              *
+ *       dWatts = Power drawn by the laptop                                  *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void VBattery_SetLoad( VBATTERY *pBatt, double dWatts )
+{
+  pBatt->dLoadW = (dWatts < 0) ? 0 : dWatts;
+}
+
+
+/*****************************************************************************
+ * FUNC: VBattery_Advance                                                    *
+ * DESC: Let simulated time pass                                             *
+ * ARGS: pBatt = Address of VBATTERY structure                               *
+ *       dwMs  = Amount of time to simulate (milliseconds)                   *
+ * RET:  [None]                                                              *
+ * NOTE: Time is simulated in steps of at most VBATTERY_STEP_MS, broken at   *
+ *       every load profile change and every report refresh, so the result   *
+ *       doesn't depend on how often this is called.                         *
+ *****************************************************************************/
+void VBattery_Advance( VBATTERY *pBatt, DWORD dwMs )
+{
+  const VBATTERY_CONFIG *pCfg      = &pBatt->Config;
+  BOOL                   bProfile  = (pCfg->pLoad != NULL) && (pCfg->dwLoadSteps != 0);
+
+  while( dwMs > 0 ) {
+    DWORD  dwStep = (dwMs < VBATTERY_STEP_MS) ? dwMs : VBATTERY_STEP_MS;
+    DWORD  dwToReport = pBatt->dwNextReportMs - pBatt->dwNowMs;
+    double dPower;
+
+    if( bProfile && (pBatt->dwLoadLeftMs < dwStep) ) {     // Stop at the next load change
+      dwStep = pBatt->dwLoadLeftMs;
+    }
+    if( (dwToReport > 0) && (dwToReport < dwStep) ) {      // Stop at the next report refresh
+      dwStep = dwToReport;
+    }
+
+    if( dwStep > 0 ) {
+      dPower            = ChargePower( pBatt );
+      pBatt->dEnergyWh += dPower * dwStep / 3600000.0;
+      if( pBatt->dEnergyWh >= pCfg->dCapacityWh ) {
+        pBatt->dEnergyWh = pCfg->dCapacityWh;
+        pBatt->bFull     = TRUE;
+      }
+      else if( pBatt->dEnergyWh < 0 ) {
+        pBatt->dEnergyWh = 0;
+      }
+
+      if( pBatt->bOutletOn && !pBatt->bFull && (dPower > 0) && (dPower < pCfg->dCutoffW * pCfg->dEfficiency)
+          && (VBattery_Percent(pBatt) > pCfg->dCvStartPct) ) {
+        pBatt->bFull = TRUE;                               // Charger terminates once the CV current is small enough
+      }
+      else if( pBatt->bFull && (VBattery_Percent(pBatt) < 100.0 - RECHARGE_PCT) ) {
+        pBatt->bFull = FALSE;                              // Top the battery up again
+      }
+
+      pBatt->dwNowMs += dwStep;
+      dwMs           -= dwStep;
+    }
+
+    if( bProfile ) {
+      pBatt->dwLoadLeftMs -= dwStep;
+      if( pBatt->dwLoadLeftMs == 0 ) {                     // Time for the next load in the profile?
+        pBatt->dwLoadStep   = (pBatt->dwLoadStep + 1) % pCfg->dwLoadSteps;
+        pBatt->dLoadW       = pCfg->pLoad[pBatt->dwLoadStep].fWatts;
+        pBatt->dwLoadLeftMs = pCfg->pLoad[pBatt->dwLoadStep].dwSecs * 1000;
+        if( pBatt->dwLoadLeftMs == 0 ) {
+          pBatt->dwLoadLeftMs = 1000;                      //  (Don't get stuck on a zero-length step)
+        }
+      }
+    }
+    UpdateReport( pBatt );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: VBattery_Percent                                                    *
+ * DESC: Get the battery's actual charge level                               *
+ * ARGS: pBatt = Address of VBATTERY structure                               *
+ * RET:  Charge level (0.0-100.0)                                            *
+ *****************************************************************************/
+double VBattery_Percent( const VBATTERY *pBatt )
+{
+  return (pBatt->Config.dCapacityWh > 0) ? 100.0 * pBatt->dEnergyWh / pBatt->Config.dCapacityWh : 0;
+}
+
+
+/*****************************************************************************
+ * FUNC: VBattery_Status                                                     *
+ * DESC: Get the battery status as Windows would currently report it         *
+ * ARGS: pBatt   = Address of VBATTERY structure                             *
+ *       pbyPct  = Address of BYTE to receive BatteryLifePercent             *
+ *       pbyLine = Address of BYTE to receive ACLineStatus                   *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void VBattery_Status( const VBATTERY *pBatt, BYTE *pbyPct, BYTE *pbyLine )
+{
+  *pbyPct  = pBatt->byReportedPct;
+  *pbyLine = pBatt->byReportedLine;
+}
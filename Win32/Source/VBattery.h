@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * FILE: VBattery.h                                                          *
+ * DESC: Definitions for the virtual (simulated) laptop battery              *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef VBATTERY_H
+# define VBATTERY_H                              // Prevent items below from being processed more than once
+
+    /* Defines */
+# define VBATTERY_STEP_MS       5000             // Largest simulation time step (milliseconds)
+# define VBATTERY_SIM_SPEEDUP   60               // Default speed-up when ChargeOn is started with /sim
+
+    /* Typedefs */
+  typedef struct {                               // One step of a (repeating) load profile
+    DWORD dwSecs;                                // How long the load lasts
+    float fWatts;                                // Power drawn by the laptop during that time
+  } VBATTERY_LOAD;
+
+  typedef struct {                               // Battery / charger / laptop characteristics
+    double dCapacityWh;                          // Battery capacity (watt-hours)
+    double dAdapterW;                            // AC adapter rating (watts)
+    double dMaxChargeW;                          // Constant-current (CC) phase charging power (watts)
+    double dCvStartPct;                          // Charge level where constant-voltage (CV) phase begins
+    double dCutoffW;                             // Charger stops (battery is "full") when CV power drops below this
+    double dEfficiency;                          // Fraction of the charging power that ends up in the battery
+    double dIdleW;                               // Load when no profile is given (and VBattery_SetLoad() isn't called)
+    const VBATTERY_LOAD *pLoad;                  // Repeating load profile (or NULL)
+    DWORD  dwLoadSteps;                          // Number of steps in the load profile
+    DWORD  dwReportStepPct;                      // BatteryLifePercent granularity (percentage points)
+    DWORD  dwReportMs;                           // How often BatteryLifePercent is refreshed
+    DWORD  dwLineLagMs;                          // Delay before ACLineStatus reflects the outlet's state
+  } VBATTERY_CONFIG;
+
+  typedef struct {                               // State of one simulated battery
+    VBATTERY_CONFIG Config;
+    double          dEnergyWh;                   // Energy currently stored in the battery
+    double          dLoadW;                      // Current load
+    BOOL            bOutletOn;                   // Is the (simulated) outlet providing power?
+    BOOL            bFull;                       // Has the charger terminated (until the outlet is next turned ON)?
+    DWORD           dwNowMs;                     // Simulated time since VBattery_Init()
+    DWORD           dwLoadStep;                  // Current step of the load profile
+    DWORD           dwLoadLeftMs;                //  and how much longer it lasts
+    DWORD           dwNextReportMs;              // When BatteryLifePercent will next be refreshed
+    DWORD           dwLineAtMs;                  // When ACLineStatus will next catch up with the outlet
+    BYTE            byReportedPct;               // BatteryLifePercent, as Windows would report it
+    BYTE            byReportedLine;              // ACLineStatus, as Windows would report it
+  } VBATTERY;
+
+    /* Global function prototypes */
+  void   VBattery_InitConfig( VBATTERY_CONFIG *pConfig );
+  void   VBattery_Init(       VBATTERY *pBatt, const VBATTERY_CONFIG *pConfig, BYTE byStartPct, BOOL bOutletOn );
+  void   VBattery_SetOutlet(  VBATTERY *pBatt, BOOL bOn );
+  void   VBattery_SetLoad(    VBATTERY *pBatt, double dWatts );
+  void   VBattery_Advance(    VBATTERY *pBatt, DWORD dwMs );
+  double VBattery_Percent(    const VBATTERY *pBatt );
+  void   VBattery_Status(     const VBATTERY *pBatt, BYTE *pbyPct, BYTE *pbyLine );
+
+#endif
@@ -57,6 +57,9 @@
 //#define IDD_HELPABOUTDIALOG           2301
 
 #define IDT_TIMER1                    9001
+#define IDT_TIMER2                    9002
+#define IDT_TIMER3                    9003
+#define IDT_TIMER4                    9004
 
 #define ICON_256                      9101
 #define ICON_48                       9102
@@ -0,0 +1,169 @@
+/*****************************************************************************
+ * FILE: PredictTest.c                                                       *
+ * DESC: Closed-loop test of latency-compensating switching                  *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Build as a console program, together with ReplayEngine.c, Trace.c   *
+ *       and ..\Source\Policy.c + Predict.c + VBattery.c + Governor.c +      *
+ *       Actuate.c, with CHARGE_POLICY left at its default (HYSTERESIS).     *
+ *                                                                           *
+ *       Replays synthetic traces against a simulated battery (either the    *
+ *       trace's own charge/drain rates, or the VBattery model) over a range *
+ *       of actuation latencies and BatteryLifePercent refresh periods, and  *
+ *       checks that the predictor learns both, and that the "true" charge   *
+ *       turns round close to MAX and MIN.                                   *
+ *                                                                           *
+ *       Usage: PredictTest [-d days]    (default: 14)                       *
+ *       Exit code 0 = every case passed, 1 = something failed               *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Source/Predict.h"
+#include "../Source/Policy.h"
+#include "../Source/VBattery.h"
+#include "../Source/Governor.h"
+#include "ReplayEngine.h"
+#include "Trace.h"
+
+  /* Defines */
+#define DEFAULT_DAYS     14
+#define TEST_MIN         30                 // BatteryChargeMin / BatteryChargeMax for every case (MAX below 100,
+#define TEST_MAX         80                 //  so the battery can actually overshoot it)
+#define TEST_SEEDS       2                  // Synthetic traces per case
+#define TEST_CAPACITY_WH 60.0               // VBattery capacity
+#define LIMIT_AVERAGE    0.3                // Average true turnaround must be within this of the target (points)
+#define LIMIT_WORST      1.5                //  and no single one further past it than this (a load change
+                                            //  while the outlet is switching can't be foreseen)
+
+  /* Typedefs */
+
+  /* Static variables */
+static const DWORD Latencies[] = { 3000, 20000, 60000 };   // Outlet actuation latency (milliseconds)
+static const DWORD Refreshes[] = { 5, 30, 60 };            // BatteryLifePercent refresh period (seconds)
+
+  /* Function prototypes */
+static BOOL RunCase( const TRACE *pTrace, const REPLAY_CONFIG *pConfig );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: RunCase                                                             *
+ * DESC: Replay one trace with one configuration, and check the results      *
+ * ARGS: pTrace  = Address of the trace to replay                            *
+ *       pConfig = Address of the replay configuration                       *
+ * RET:  TRUE = Passed, FALSE = Failed (and says why)                        *
+ * NOTE: Latency and refresh period are only seen at sample times, so both   *
+ *       may be off by up to one CheckChargeInterval. A refresh period that  *
+ *       isn't at least two intervals can't be told apart from polling.      *
+ *****************************************************************************/
+static BOOL RunCase( const TRACE *pTrace, const REPLAY_CONFIG *pConfig )
+{
+  REPLAY_RESULT    Result;
+  const PREDICTOR *pPred     = &Result.State.Pred;
+  long             lSlackMs  = (long)pConfig->dwIntervalSecs * 1000;
+  long             lRefresh  = (long)pConfig->dwRefreshSecs  * 1000;
+  double           dAvgMax;
+  double           dAvgMin;
+  BOOL             bPassed   = TRUE;
+
+  Replay_Run( pTrace, pConfig, &Result );
+  dAvgMax = Result.TrueMax.dwCount ? Result.TrueMax.dTotal / Result.TrueMax.dwCount : 0.0;
+  dAvgMin = Result.TrueMin.dwCount ? Result.TrueMin.dTotal / Result.TrueMin.dwCount : 0.0;
+
+  printf( "%-6s %6lu %4lu  %6lu %6lu   %+6.2f %+6.2f   %+6.2f %+6.2f  ",
+          pConfig->pBattery ? "model" : "trace",
+          (unsigned long)pConfig->dwLatencyMs, (unsigned long)pConfig->dwRefreshSecs,
+          (unsigned long)pPred->dwLatencyMs, (unsigned long)pPred->dwRefreshMs,
+          dAvgMax, Result.TrueMax.dWorst, dAvgMin, Result.TrueMin.dWorst );
+
+  if( labs((long)pPred->dwLatencyMs - (long)pConfig->dwLatencyMs) > lSlackMs ) {
+    printf( "latency not learned " );
+    bPassed = FALSE;
+  }
+  if( (lRefresh >= 2 * lSlackMs) && (labs((long)pPred->dwRefreshMs - lRefresh) > lSlackMs) ) {
+    printf( "refresh not learned " );
+    bPassed = FALSE;
+  }
+  if( (Result.TrueMax.dwCount == 0) || (Result.TrueMin.dwCount == 0) ) {
+    printf( "no turnarounds " );
+    bPassed = FALSE;
+  }
+  if(    (dAvgMax > LIMIT_AVERAGE) || (dAvgMax < -LIMIT_AVERAGE) || (Result.TrueMax.dWorst > LIMIT_WORST)
+      || (dAvgMin > LIMIT_AVERAGE) || (dAvgMin < -LIMIT_AVERAGE) || (Result.TrueMin.dWorst > LIMIT_WORST) ) {
+    printf( "missed the target " );
+    bPassed = FALSE;
+  }
+  printf( "%s\n", bPassed ? "ok" : "FAILED" );
+  return bPassed;
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: main                                                                *
+ * DESC: Program entry point                                                 *
+ * ARGS: argc, argv = Command-line arguments                                 *
+ * RET:  0 = Every case passed, 1 = Bad arguments or a case failed,          *
+ *       2 = Couldn't generate a trace                                       *
+ *****************************************************************************/
+int main( int argc, char *argv[] )
+{
+  REPLAY_CONFIG   Config;
+  VBATTERY_CONFIG BattConfig;
+  TRACE           Trace;
+  DWORD           dwDays   = DEFAULT_DAYS;
+  DWORD           dwSeed;
+  int             nCases   = 0;
+  int             nFailed  = 0;
+  int             nModel;
+  int             l;
+  int             r;
+
+  if( (argc == 3) && !strcmp(argv[1], "-d") ) {
+    dwDays = strtoul( argv[2], NULL, 10 );
+  }
+  else if( argc != 1 ) {
+    fprintf( stderr, "Usage: PredictTest [-d days]\n" );
+    return 1;
+  }
+
+  Replay_InitConfig( &Config );
+  VBattery_InitConfig( &BattConfig );
+  BattConfig.dCapacityWh = TEST_CAPACITY_WH;
+  Config.dwMin           = TEST_MIN;
+  Config.dwMax           = TEST_MAX;
+
+  printf( "Policy: %s, band %d%% - %d%%, %lu-day traces\n\n", Policy_Name(), TEST_MIN, TEST_MAX, (unsigned long)dwDays );
+  printf( "                     Learned         True at MAX     True at MIN\n" );
+  printf( "Batt   Lat.ms Ref.s  Lat.ms Ref.ms  Average  Worst  Average  Worst\n" );
+
+  for( dwSeed = 1; dwSeed <= TEST_SEEDS; dwSeed++ ) {
+    if( !Trace_Synthetic(dwSeed, dwDays, &Trace) ) {
+      fprintf( stderr, "Unable to generate a trace\n" );
+      return 2;
+    }
+    for( nModel = 0; nModel < 2; nModel++ ) {
+      Config.pBattery = nModel ? &BattConfig : NULL;
+      for( l = 0; l < (int)(sizeof(Latencies)/sizeof(Latencies[0])); l++ ) {
+        for( r = 0; r < (int)(sizeof(Refreshes)/sizeof(Refreshes[0])); r++ ) {
+          Config.dwLatencyMs   = Latencies[l];
+          Config.dwRefreshSecs = Refreshes[r];
+          nCases++;
+          if( !RunCase(&Trace, &Config) ) {
+            nFailed++;
+          }
+        }
+      }
+    }
+    Trace_Free( &Trace );
+  }
+
+  printf( "\n%d of %d cases passed\n", nCases - nFailed, nCases );
+  return nFailed ? 1 : 0;
+}
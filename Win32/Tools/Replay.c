@@ -0,0 +1,250 @@
+/*****************************************************************************
+ * FILE: Replay.c                                                            *
+ * DESC: Command-line tool to replay battery traces through the charge policy*
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Build as a console program, together with ReplayEngine.c, Trace.c   *
+ *       and ..\Source\Policy.c + Predict.c + VBattery.c + Governor.c +      *
+ *       Actuate.c.                                                          *
+ *       Define CHARGE_POLICY the same way as for ChargeOn.exe to replay a   *
+ *       different policy.                                                   *
+ *                                                                           *
+ *       Usage: Replay [options]                                             *
+ *         -t file     Replay a recorded trace (may be repeated)             *
+ *         -s seed     Replay a synthetic trace (default: seed 1)            *
+ *         -d days     Length of synthetic traces (default: 7)               *
+ *         -m min      BatteryChargeMin (default: 20)                        *
+ *         -M max      BatteryChargeMax (default: 100)                       *
+ *         -i secs     CheckChargeInterval (default: 2)                      *
+ *         -l ms       Outlet actuation latency (default: 3000)              *
+ *         -r secs     BatteryLifePercent refresh interval (default: 30)     *
+ *         -v wh       Use the VBattery model, with this capacity (watt-hrs) *
+ *         -g 1        Put the outlet governor between the policy and the    *
+ *                     outlet (and show how many commands it saved)          *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../Source/Predict.h"
+#include "../Source/Policy.h"
+#include "../Source/VBattery.h"
+#include "../Source/Governor.h"
+#include "ReplayEngine.h"
+#include "Trace.h"
+
+  /* Defines */
+#define DEFAULT_SEED     1
+#define DEFAULT_DAYS     7
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+static void PrintResult( const TRACE *pTrace, const REPLAY_CONFIG *pConfig, const REPLAY_RESULT *pResult, double dSecs );
+static void ReplayTrace( const TRACE *pTrace, const REPLAY_CONFIG *pConfig );
+static void Usage(       void );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: PrintResult                                                         *
+ * DESC: Report what happened during one replay                              *
+ * ARGS: pTrace  = Address of the trace that was replayed                    *
+ *       pConfig = Address of the replay configuration                       *
+ *       pResult = Address of the replay results                             *
+ *       dSecs   = CPU time the replay took                                  *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void PrintResult( const TRACE *pTrace, const REPLAY_CONFIG *pConfig, const REPLAY_RESULT *pResult, double dSecs )
+{
+  char szStats[512];
+
+  printf( "=== %s ===\n", pTrace->szName );
+  printf( "Duration:\t\t%.1f hours (%lu segments)\n",
+          pTrace->dwDurationSecs / 3600.0, (unsigned long)pTrace->dwSegCount );
+  printf( "Band:\t\t\t%lu%% - %lu%%\n", (unsigned long)pConfig->dwMin, (unsigned long)pConfig->dwMax );
+  printf( "Commands sent:\t\t%lu (%lu resent)\n", (unsigned long)pResult->dwCommands, (unsigned long)pResult->dwResends );
+  printf( "Outlet switches:\t%lu\n", (unsigned long)pResult->dwSwitches );
+  printf( "Time above MAX:\t\t%.1f minutes\n", pResult->dwSecsAbove / 60.0 );
+  printf( "Time below MIN:\t\t%.1f minutes\n", pResult->dwSecsBelow / 60.0 );
+  printf( "Discharge cycles:\t%lu (average depth %.1f%%, deepest %.1f%%)\n",
+          (unsigned long)pResult->dwCycles,
+          pResult->dwCycles ? pResult->dTotalDepth / pResult->dwCycles : 0.0,
+          pResult->dMaxDepth );
+  printf( "Battery stress:\t\t%.2f\n", pResult->dStress );
+
+  Predict_FormatStats( &pResult->State.Pred, szStats );
+  printf( "%s\n", szStats );
+  printf( "True charge at MAX:\t%+.2f %% average, %+.2f %% worst (%lu turnarounds)\n",
+          pResult->TrueMax.dwCount ? pResult->TrueMax.dTotal / pResult->TrueMax.dwCount : 0.0,
+          pResult->TrueMax.dWorst, (unsigned long)pResult->TrueMax.dwCount );
+  printf( "True charge at MIN:\t%+.2f %% average, %+.2f %% worst (%lu turnarounds)\n",
+          pResult->TrueMin.dwCount ? pResult->TrueMin.dTotal / pResult->TrueMin.dwCount : 0.0,
+          pResult->TrueMin.dWorst, (unsigned long)pResult->TrueMin.dwCount );
+
+  if( dSecs > 0 ) {
+    printf( "Replay speed:\t\t%.0f samples/sec (%lu samples in %.3f sec)\n\n",
+            pResult->dwSamples / dSecs, (unsigned long)pResult->dwSamples, dSecs );
+  }
+  else {
+    printf( "Replay speed:\t\t(too fast to measure; %lu samples)\n\n", (unsigned long)pResult->dwSamples );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: ReplayTrace                                                         *
+ * DESC: Replay one trace and report the results                             *
+ * ARGS: pTrace  = Address of the trace to replay                            *
+ *       pConfig = Address of the replay configuration                       *
+ * RET:  [None]                                                              *
+ * NOTE: With the governor, the trace is first replayed without it, so the   *
+ *       number of commands saved can be shown.                              *
+ *****************************************************************************/
+static void ReplayTrace( const TRACE *pTrace, const REPLAY_CONFIG *pConfig )
+{
+  REPLAY_RESULT Result;
+  clock_t       tStart = clock();
+  char          szStats[400];
+
+  Replay_Run( pTrace, pConfig, &Result );
+  PrintResult( pTrace, pConfig, &Result, (double)(clock() - tStart) / CLOCKS_PER_SEC );
+
+  if( pConfig->bGovern ) {                                 // Using the governor?
+    REPLAY_CONFIG Ungoverned = *pConfig;                   //  Yes, compare with what would have happened without it
+    REPLAY_RESULT Before;
+
+    Ungoverned.bGovern = FALSE;
+    Replay_Run( pTrace, &Ungoverned, &Before );
+    Governor_FormatStats( &Result.Gov, szStats );
+    printf( "%s\n", szStats );
+    printf( "Without the governor:\t%lu commands, %lu outlet switches\n",
+            (unsigned long)Before.dwCommands, (unsigned long)Before.dwSwitches );
+    printf( "With the governor:\t%lu commands, %lu outlet switches (%.0f%% fewer commands)\n\n",
+            (unsigned long)Result.dwCommands, (unsigned long)Result.dwSwitches,
+            Before.dwCommands ? 100.0 * ((double)Before.dwCommands - Result.dwCommands) / Before.dwCommands : 0.0 );
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: Usage                                                               *
+ * DESC: Display the command-line options                                    *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void Usage( void )
+{
+  fprintf( stderr,
+           "Usage: Replay [options]\n"
+           "  -t file   Replay a recorded trace (seconds,percent,acline per line)\n"
+           "  -s seed   Replay a synthetic trace (default: seed %d)\n"
+           "  -d days   Length of synthetic traces (default: %d)\n"
+           "  -m min    BatteryChargeMin (default: 20)\n"
+           "  -M max    BatteryChargeMax (default: 100)\n"
+           "  -i secs   CheckChargeInterval (default: %d)\n"
+           "  -l ms     Outlet actuation latency (default: %d)\n"
+           "  -r secs   BatteryLifePercent refresh interval (default: %d)\n"
+           "  -v wh     Use the VBattery model, with this capacity (watt-hours)\n"
+           "  -g 1      Use the outlet governor (and show how many commands it saved)\n",
+           DEFAULT_SEED, DEFAULT_DAYS,
+           REPLAY_DEFAULT_INTERVAL, REPLAY_DEFAULT_LATENCY, REPLAY_DEFAULT_REFRESH );
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: main                                                                *
+ * DESC: Program entry point                                                 *
+ * ARGS: argc, argv = Command-line arguments                                 *
+ * RET:  0 = Success, 1 = Bad arguments, 2 = Couldn't load a trace           *
+ *****************************************************************************/
+int main( int argc, char *argv[] )
+{
+  REPLAY_CONFIG   Config;
+  VBATTERY_CONFIG BattConfig;
+  TRACE           Trace;
+  DWORD           dwDays   = DEFAULT_DAYS;
+  int             nTraces  = 0;
+  int             nPass;
+  int             i;
+
+  Replay_InitConfig( &Config );
+  VBattery_InitConfig( &BattConfig );
+
+  for( nPass = 0; nPass < 2; nPass++ ) {                   // 1st pass: collect the settings, 2nd pass: replay the traces
+    for( i = 1; i < argc; i++ ) {
+      const char *szOpt = argv[i];
+      const char *szArg = (i+1 < argc) ? argv[i+1] : NULL;
+
+      if( ((szOpt[0] != '-') && (szOpt[0] != '/')) || (szOpt[1] == '\0') || (szOpt[2] != '\0') || (szArg == NULL) ) {
+        Usage();
+        return 1;
+      }
+      i++;
+
+      switch( szOpt[1] ) {
+        case 'm': Config.dwMin          = strtoul( szArg, NULL, 10 ); break;
+        case 'M': Config.dwMax          = strtoul( szArg, NULL, 10 ); break;
+        case 'i': Config.dwIntervalSecs = strtoul( szArg, NULL, 10 ); break;
+        case 'l': Config.dwLatencyMs    = strtoul( szArg, NULL, 10 ); break;
+        case 'r': Config.dwRefreshSecs  = strtoul( szArg, NULL, 10 ); break;
+        case 'd': dwDays                = strtoul( szArg, NULL, 10 ); break;
+        case 'g': Config.bGovern        = (atoi(szArg) != 0);         break;
+        case 'v': BattConfig.dCapacityWh = atof( szArg );
+                  Config.pBattery       = (BattConfig.dCapacityWh > 0) ? &BattConfig : NULL;
+                  break;
+
+        case 't':
+        case 's':
+          if( nPass == 1 ) {
+            BOOL bLoaded = (szOpt[1] == 't')
+                         ? Trace_LoadCSV( szArg, &Trace )
+                         : Trace_Synthetic( strtoul(szArg, NULL, 10), dwDays, &Trace );
+
+            if( !bLoaded ) {
+              fprintf( stderr, "Unable to load trace \"%s\"\n", szArg );
+              return 2;
+            }
+            ReplayTrace( &Trace, &Config );
+            Trace_Free( &Trace );
+          }
+          nTraces++;
+          break;
+
+        default:
+          Usage();
+          return 1;
+      }
+    }
+
+    if( nPass == 0 ) {
+      if( (Config.dwMin > Config.dwMax) || (Config.dwMax > 100) ) {
+        fprintf( stderr, "BatteryChargeMin must not be more than BatteryChargeMax (max. 100)\n" );
+        return 1;
+      }
+      printf( "Policy: %s\n", Policy_Name() );
+      if( Config.pBattery ) {
+        printf( "Battery: VBattery model, %.0f Wh\n", BattConfig.dCapacityWh );
+      }
+      printf( "\n" );
+    }
+  }
+
+  if( nTraces == 0 ) {                                     // No traces on the command line?
+    if( !Trace_Synthetic(DEFAULT_SEED, dwDays, &Trace) ) { //  No, replay the default synthetic one
+      return 2;
+    }
+    ReplayTrace( &Trace, &Config );
+    Trace_Free( &Trace );
+  }
+
+  return 0;
+}
@@ -0,0 +1,243 @@
+/*****************************************************************************
+ * FILE: ReplayEngine.c                                                      *
+ * DESC: Trace replay engine                                                 *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Runs the charge policy (the same Policy_Decide() call used by       *
+ *       ProcessBatteryInfo()) against a battery trace, in simulated time.   *
+ *       The outlet, the RF/relay latency and Windows' slow refresh of       *
+ *       BatteryLifePercent are all simulated, so the battery responds to    *
+ *       the policy's ON/OFF decisions just like the real thing.             *
+ *       The battery either follows the trace's charge/drain rates, or (when *
+ *       a VBATTERY_CONFIG is given) the VBattery model, with the trace's    *
+ *       drain rates used as the laptop's load.                              *
+ *       Commands go through the same actuator (and, optionally, governor)   *
+ *       as in ChargeOn.exe, so a command for a change that's already on its *
+ *       way isn't sent again, and an outlet slower than the retransmit      *
+ *       window gets the command resent.                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <string.h>                    // For memset()
+#include "../Source/Predict.h"
+#include "../Source/Policy.h"
+#include "../Source/VBattery.h"
+#include "../Source/Governor.h"
+#include "../Source/Actuate.h"
+#include "ReplayEngine.h"
+
+  /* Defines */
+
+  /* Typedefs */
+
+  /* Static variables */
+
+  /* Function prototypes */
+static void RecordTurnaround( OVERSHOOT_TRUE *pStats, double dOvershoot );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: RecordTurnaround                                                    *
+ * DESC: Add one turnaround of the "true" charge to the statistics           *
+ * ARGS: pStats     = Address of the statistics (at MAX or at MIN)           *
+ *       dOvershoot = How far past the target it went (percentage points)    *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void RecordTurnaround( OVERSHOOT_TRUE *pStats, double dOvershoot )
+{
+  if( (pStats->dwCount == 0) || (dOvershoot > pStats->dWorst) ) {
+    pStats->dWorst = dOvershoot;
+  }
+  pStats->dTotal += dOvershoot;
+  pStats->dwCount++;
+}
+
+
+/*****************************************************************************
+ * FUNC: Replay_InitConfig                                                   *
+ * DESC: Populate a REPLAY_CONFIG structure with the ChargeOn defaults       *
+ * ARGS: pConfig = Address of REPLAY_CONFIG structure to populate            *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Replay_InitConfig( REPLAY_CONFIG *pConfig )
+{
+  pConfig->dwMin          = 20;
+  pConfig->dwMax          = 100;
+  pConfig->dwIntervalSecs = REPLAY_DEFAULT_INTERVAL;
+  pConfig->dwLatencyMs    = REPLAY_DEFAULT_LATENCY;
+  pConfig->dwRefreshSecs  = REPLAY_DEFAULT_REFRESH;
+  pConfig->pBattery       = NULL;
+  pConfig->bGovern        = FALSE;
+}
+
+
+/*****************************************************************************
+ * FUNC: Replay_Run                                                          *
+ * DESC: Replay one trace through the charge policy                          *
+ * ARGS: pTrace  = Address of the trace to replay                            *
+ *       pConfig = Address of REPLAY_CONFIG structure                        *
+ *       pResult = Address of REPLAY_RESULT structure to be populated        *
+ * RET:  [None]                                                              *
+ * NOTE: Battery stress is a simple wear score used to compare settings, not *
+ *       a real aging model. Lithium-ion cells age faster when held at a     *
+ *       high charge and when cycled deeply, so every hour adds (charge/100) *
+ *       squared, and every discharge cycle adds (depth/100) squared times   *
+ *       REPLAY_CYCLE_STRESS.                                                *
+ *****************************************************************************/
+void Replay_Run( const TRACE *pTrace, const REPLAY_CONFIG *pConfig, REPLAY_RESULT *pResult )
+{
+  POLICY_CONFIG PolicyConfig;
+  CHARGE_SAMPLE Sample;
+  DWORD         dwSeg          = 0;                        // Index of the trace segment currently in effect
+  DWORD         dwSecs;                                    // Simulated time (seconds since the start of the trace)
+  DWORD         dwInterval     = pConfig->dwIntervalSecs ? pConfig->dwIntervalSecs : 1;
+  DWORD         dwLastRefresh  = 0;
+  double        dCharge        = pTrace->byStartPct;       // The battery's "true" charge (percent)
+  double        dCycleTop      = -1;                       // Peak charge at the start of the current discharge cycle
+  BYTE          byReportedPct  = pTrace->byStartPct;       // What Windows would currently report as BatteryLifePercent
+  BYTE          byLine         = pTrace->byStartLine;      // Actual AC line status
+  BYTE          byOutlet       = pTrace->byStartLine;      // State the outlet has been told to go to
+  BOOL          bFlipPending   = FALSE;                    // Is the AC line about to change state?
+  BOOL          bFlipAimed     = FALSE;                    //  Was it aimed at MIN/MAX with a learned lead?
+  DWORD         dwFlipAtMs     = 0;                        //  Yes, when
+  VBATTERY      Batt;                                      // Battery model (if pConfig->pBattery is given)
+  BYTE          byModelLine;
+  ACTUATOR      Act;                                       // Watches each command until the AC line confirms it
+
+  memset( pResult, 0, sizeof(*pResult) );
+  Policy_InitState( &pResult->State );
+  Governor_Init( &pResult->Gov, 0 );
+  Actuate_Init( &Act );
+  Policy_InitConfig( &PolicyConfig, pConfig->dwMin, pConfig->dwMax );
+  Sample.bInfoIsGood = TRUE;
+  if( pConfig->pBattery ) {                                // Using the battery model?
+    VBATTERY_CONFIG BattConfig = *pConfig->pBattery;       //  Yes, the trace provides the load,
+
+    BattConfig.pLoad       = NULL;
+    BattConfig.dwLoadSteps = 0;
+    BattConfig.dwLineLagMs = 0;                            //   and the latency is simulated here
+    BattConfig.dwReportMs  = pConfig->dwRefreshSecs * 1000;
+    VBattery_Init( &Batt, &BattConfig, pTrace->byStartPct, pTrace->byStartLine );
+  }
+
+  for( dwSecs = 0; dwSecs < pTrace->dwDurationSecs; dwSecs += dwInterval ) {
+    const TRACE_SEGMENT *pSeg;
+    CHARGE_ACTION       action;
+    DWORD               dwNowMs = dwSecs * 1000;
+
+    while( (dwSeg+1 < pTrace->dwSegCount) && (pTrace->pSegs[dwSeg+1].dwSecs <= dwSecs) ) {
+      dwSeg++;                                             // Move on to the segment that covers the current time
+    }
+    pSeg = &pTrace->pSegs[dwSeg];
+
+    if( bFlipPending && (dwNowMs >= dwFlipAtMs) ) {        // Has the outlet (finally) switched?
+      bFlipPending = FALSE;                                //  Yes...
+      byLine       = byOutlet;
+      pResult->dwSwitches++;
+      if( pConfig->pBattery ) {
+        VBattery_SetOutlet( &Batt, byLine );
+      }
+      if( bFlipAimed ) {
+        RecordTurnaround( byLine ? &pResult->TrueMin : &pResult->TrueMax,
+                          byLine ? (double)pConfig->dwMin + 1 - dCharge : dCharge - (double)pConfig->dwMax );
+      }
+      if( byLine == 0 ) {                                  //   Started discharging?
+        dCycleTop = dCharge;                               //    Yes, a new cycle starts at the current peak
+      }
+      else if( dCycleTop >= 0 ) {                          //   No, started charging at the end of a cycle?
+        double dDepth = dCycleTop - dCharge;               //    Yes, record how deep it was
+
+        pResult->dwCycles++;
+        pResult->dTotalDepth += dDepth;
+        pResult->dStress     += REPLAY_CYCLE_STRESS * (dDepth/100) * (dDepth/100);
+        if( dDepth > pResult->dMaxDepth ) {
+          pResult->dMaxDepth = dDepth;
+        }
+      }
+    }
+
+    if(    (Actuate_Poll(&Act, byLine, dwNowMs) == ACTUATE_RESEND)
+        && (!pConfig->bGovern || Governor_AllowRetry(&pResult->Gov, dwNowMs)) ) {
+      pResult->dwCommands++;                               // Outlet slower than the actuator's window? Resend, as
+      pResult->dwResends++;                                //  CheckActuation() does (the outlet is already switching)
+      Actuate_Resent( &Act, dwNowMs );
+    }
+
+    if( pConfig->pBattery ) {                              // Battery model does its own reporting
+      VBattery_Status( &Batt, &byReportedPct, &byModelLine );
+    }
+    else if( dwSecs - dwLastRefresh >= pConfig->dwRefreshSecs ) {
+      dwLastRefresh = dwSecs;                              // Time for Windows to refresh its battery percentage
+      byReportedPct = (BYTE)dCharge;
+    }
+
+    Sample.dwTick       = dwNowMs;                         // Battery check, exactly as ProcessBatteryInfo() does it
+    Sample.wMinuteOfDay = (WORD)((dwSecs / 60) % 1440);
+    Sample.byPct        = byReportedPct;
+    Sample.byLine       = byLine;
+    action = Policy_Decide( &PolicyConfig, &pResult->State, &Sample );
+    pResult->dwSamples++;
+
+    if( action != ACTION_NONE ) {                          // Policy wants the outlet switched?
+      BYTE byWanted = (action == ACTION_TURN_ON) ? 1 : 0;  //  Yes, "send" the command (if the governor agrees)
+
+      if( pConfig->bGovern ) {
+        if( Governor_Request(&pResult->Gov, byWanted, byLine, Actuate_Busy(&Act, byWanted),
+                             pResult->State.bFailSafe ? GOV_SOURCE_SAFETY : GOV_SOURCE_POLICY, dwNowMs) != GOV_SEND ) {
+          action = ACTION_NONE;
+        }
+      }
+      else if( Actuate_Busy(&Act, byWanted) ) {            //   (Without it, ProcessBatteryInfo() still leaves a command
+        action = ACTION_NONE;                              //    the actuator is already working on alone)
+      }
+    }
+
+    if( action != ACTION_NONE ) {
+      BYTE byWanted = (action == ACTION_TURN_ON) ? 1 : 0;
+      BOOL bAimed   =    (pResult->State.nDecisionTarget != PREDICT_NO_TARGET)
+                      && pResult->State.Pred.bSlopeKnown && (pResult->State.Pred.dwLatencySamples > 0);
+
+      pResult->dwCommands++;
+      Policy_CommandSent( &pResult->State, action, dwNowMs );
+      Actuate_Start( &Act, byWanted, Predict_Latency(&pResult->State.Pred), dwNowMs );
+      if( byWanted != byOutlet ) {                         //   Does the outlet have to change state?
+        byOutlet = byWanted;                               //    Yes, it will take a while to show up
+        if( byWanted != byLine ) {
+          bFlipPending = TRUE;
+          dwFlipAtMs   = dwNowMs + pConfig->dwLatencyMs;
+          bFlipAimed   = bAimed;
+        }
+        else {
+          bFlipPending = FALSE;                            //    (Cancelled a change that hadn't happened yet)
+        }
+      }
+    }
+
+    if( pConfig->pBattery ) {                              // Let the battery charge/discharge until the next check
+      VBattery_SetLoad( &Batt, pSeg->fDrainPerHour * Batt.Config.dCapacityWh / 100.0 );
+      VBattery_Advance( &Batt, dwInterval * 1000 );
+      dCharge = VBattery_Percent( &Batt );
+    }
+    else {
+      dCharge += (byLine ? pSeg->fChargePerHour : -pSeg->fDrainPerHour) * (double)dwInterval / 3600.0;
+      if( dCharge > 100 ) {
+        dCharge = 100;
+      }
+      else if( dCharge < 0 ) {
+        dCharge = 0;
+      }
+    }
+
+    pResult->dStress += (dCharge/100) * (dCharge/100) * (double)dwInterval / 3600.0;
+
+    if( dCharge > (double)pConfig->dwMax ) {               // Outside the MIN/MAX band?
+      pResult->dwSecsAbove += dwInterval;
+    }
+    else if( dCharge < (double)pConfig->dwMin ) {
+      pResult->dwSecsBelow += dwInterval;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/*****************************************************************************
+ * FILE: ReplayEngine.h                                                      *
+ * DESC: Definitions for the trace replay engine                             *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef REPLAYENGINE_H
+# define REPLAYENGINE_H                          // Prevent items below from being processed more than once
+
+    /* Defines */
+# define REPLAY_DEFAULT_INTERVAL   2             // Same default as CheckChargeInterval (seconds)
+# define REPLAY_DEFAULT_LATENCY    3000          // RF + outlet relay + Windows power status refresh (milliseconds)
+# define REPLAY_DEFAULT_REFRESH    30            // How often Windows updates BatteryLifePercent (seconds)
+# define REPLAY_CYCLE_STRESS       10.0          // Stress added by one full (100% -> 0%) discharge cycle
+
+    /* Typedefs */
+  typedef struct {                               // Battery behavior from one point in time onward
+    DWORD dwSecs;                                // Start of this segment (seconds since the start of the trace)
+    float fChargePerHour;                        // Percentage points gained per hour while the outlet is ON
+    float fDrainPerHour;                         // Percentage points lost per hour while the outlet is OFF
+  } TRACE_SEGMENT;
+
+  typedef struct {                               // A recorded or synthetic battery trace
+    char          szName[MAX_PATH];              // File name, or description of the synthetic trace
+    TRACE_SEGMENT *pSegs;                        // Segments, in time order (first one starts at 0)
+    DWORD         dwSegCount;
+    DWORD         dwDurationSecs;                // Length of the trace
+    BYTE          byStartPct;                    // Battery percentage at the start of the trace
+    BYTE          byStartLine;                   // AC line status at the start of the trace
+  } TRACE;
+
+  typedef struct {                               // How the trace should be replayed
+    DWORD dwMin;                                 // BatteryChargeMin
+    DWORD dwMax;                                 // BatteryChargeMax
+    DWORD dwIntervalSecs;                        // CheckChargeInterval
+    DWORD dwLatencyMs;                           // Time from command sent to AC line change
+    DWORD dwRefreshSecs;                         // How often the reported battery percentage is refreshed
+    const VBATTERY_CONFIG *pBattery;             // Battery model to use (NULL = follow the trace's charge/drain rates)
+    BOOL  bGovern;                               // Pass the policy's commands through the outlet governor?
+  } REPLAY_CONFIG;
+
+  typedef struct {                               // Turnarounds measured on the "true" charge, not the reported one
+    DWORD  dwCount;                              // Number of turnarounds
+    double dTotal;                               // Sum of all overshoots (percentage points; negative = stopped short)
+    double dWorst;                               // Largest single overshoot
+  } OVERSHOOT_TRUE;
+
+  typedef struct {                               // What happened during the replay
+    DWORD        dwSamples;                      // Number of battery checks (calls to Policy_Decide())
+    DWORD        dwCommands;                     // Number of ON/OFF commands sent to the (simulated) ChargeOn module
+    DWORD        dwResends;                      //  Of those, retransmissions by the actuator
+    DWORD        dwSwitches;                     // Number of times the AC line actually changed state
+    DWORD        dwSecsAbove;                    // Time spent above BatteryChargeMax
+    DWORD        dwSecsBelow;                    // Time spent below BatteryChargeMin
+    DWORD        dwCycles;                       // Number of complete discharge cycles (peak -> trough)
+    double       dTotalDepth;                    // Sum of all cycle depths (percentage points)
+    double       dMaxDepth;                      // Deepest cycle (percentage points)
+    double       dStress;                        // Battery stress (see Replay_Run() for how it is scored)
+    OVERSHOOT_TRUE TrueMax;                      // How far the "true" charge went past MAX when the outlet turned OFF
+    OVERSHOOT_TRUE TrueMin;                      //  and below MIN+1 when it turned ON (reported percentages are
+                                                 //  rounded down, so that's where Windows starts to report MIN).
+                                                 //  Only turnarounds the policy aimed at MIN/MAX, after the
+                                                 //  latency and slope were learned, are counted
+    POLICY_STATE State;                          // Policy state at the end of the replay (includes overshoot stats)
+    GOVERNOR     Gov;                            // Governor state / statistics (if REPLAY_CONFIG.bGovern)
+  } REPLAY_RESULT;
+
+    /* Global function prototypes */
+  void Replay_InitConfig( REPLAY_CONFIG *pConfig );
+  void Replay_Run(        const TRACE *pTrace, const REPLAY_CONFIG *pConfig, REPLAY_RESULT *pResult );
+
+#endif
@@ -0,0 +1,510 @@
+/*****************************************************************************
+ * FILE: Sweep.c                                                             *
+ * DESC: Command-line tool to find the best MIN/MAX/interval settings        *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: Replays every allowed combination of BatteryChargeMin (20-95),      *
+ *       BatteryChargeMax (25-100, at least MIN+2) and CheckChargeInterval   *
+ *       (1-9) against a library of traces, and lists the combinations that  *
+ *       can't be beaten on BOTH outlet switches AND battery stress (the     *
+ *       "Pareto front").                                                    *
+ *                                                                           *
+ *       Each (settings, trace) pair is one job. The jobs are divided evenly *
+ *       between the worker threads, and a worker that runs out of jobs      *
+ *       steals half of the remaining jobs from another worker, so all the   *
+ *       cores stay busy even though short intervals take much longer to     *
+ *       replay than long ones.                                              *
+ *                                                                           *
+ *       Build as a console program (C11, for <threads.h>/<stdatomic.h>),    *
+ *       together with ReplayEngine.c, Trace.c and ..\Source\Policy.c +      *
+ *       Predict.c + VBattery.c + Governor.c + Actuate.c.                    *
+ *                                                                           *
+ *       Usage: Sweep [options]                                              *
+ *         -t file     Add a recorded trace to the library (may be repeated) *
+ *         -s count    Add this many synthetic traces (default: 4 if no -t)  *
+ *         -d days     Length of synthetic traces (default: 7)               *
+ *         -S step     MIN/MAX step size (default: 5, 1 = every value)       *
+ *         -I secs     Largest CheckChargeInterval to try (default: 9)       *
+ *         -j threads  Number of worker threads (default: number of CPUs)    *
+ *         -l ms       Outlet actuation latency (default: 3000)              *
+ *         -r secs     BatteryLifePercent refresh interval (default: 30)     *
+ *         -v wh       Use the VBattery model, with this capacity (watt-hrs) *
+ *         -b 1        Measure scaling efficiency with 1..threads workers    *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include "../Source/Predict.h"
+#include "../Source/Policy.h"
+#include "../Source/VBattery.h"
+#include "../Source/Governor.h"
+#include "ReplayEngine.h"
+#include "Trace.h"
+
+  /* Defines */
+#define MINMIN             20                // Same limits as the MainDlg.c spinner controls
+#define MINMAX             95
+#define MAXMIN             25
+#define MAXMAX            100
+#define MIN_GAP             2                // MAX must be at least this much above MIN (see MainDlg.c)
+#define INTERVAL_MAX        9                // CheckChargeInterval is a single digit
+#define MAX_TRACES         32
+#define MAX_WORKERS        64
+#define DEFAULT_SYNTHETIC   4
+#define DEFAULT_DAYS        7
+#define DEFAULT_STEP        5
+
+#define RANGE(next,end)   (((unsigned long long)(end) << 32) | (unsigned long long)(next))
+#define RANGE_NEXT(r)     ((DWORD)((r) & 0xFFFFFFFFUL))
+#define RANGE_END(r)      ((DWORD)((r) >> 32))
+
+  /* Typedefs */
+  typedef struct {                           // One combination of settings, and how it did over all the traces
+    DWORD  dwMin;
+    DWORD  dwMax;
+    DWORD  dwInterval;
+    double dSwitchesPerDay;
+    double dStressPerDay;
+    double dOutsidePct;                      // Percentage of the time spent outside MIN/MAX
+    BOOL   bPareto;                          // On the Pareto front?
+  } SWEEP_POINT;
+
+  typedef struct {                           // One job's result
+    DWORD  dwSwitches;
+    DWORD  dwSecsOutside;
+    double dStress;
+  } JOB_RESULT;
+
+  typedef struct {                           // A worker thread's queue of jobs
+    atomic_ullong Range;                     // Jobs [next, end) still to be done, packed by RANGE()
+    DWORD         dwJobsDone;
+    DWORD         dwSteals;
+    char          Pad[48];                   // (Keep each queue on its own cache line)
+  } WORKER;
+
+  /* Static variables */
+static TRACE         Traces[MAX_TRACES];
+static int           nTraceCount;
+static SWEEP_POINT  *pPoints;
+static DWORD         dwPointCount;
+static JOB_RESULT   *pJobs;
+static DWORD         dwJobCount;
+static WORKER        Workers[MAX_WORKERS];
+static int           nWorkerCount;
+static REPLAY_CONFIG BaseConfig;
+static VBATTERY_CONFIG BattConfig;
+
+  /* Function prototypes */
+static BOOL   TakeJob(       WORKER *pWorker, DWORD *pdwJob );
+static BOOL   StealJobs(     int nThief );
+static void   RunJob(        DWORD dwJob );
+static int    WorkerThread(  void *pArg );
+static double RunSweep(      int nThreads );
+static void   FindPareto(    void );
+static double WallClock(     void );
+static void   Usage(         void );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: TakeJob                                                             *
+ * DESC: Take the next job from the front of a worker's own queue            *
+ * ARGS: pWorker = Address of the worker's queue                             *
+ *       pdwJob  = Address of DWORD to receive the job number                *
+ * RET:  TRUE = Got a job, FALSE = Queue is empty                            *
+ *****************************************************************************/
+static BOOL TakeJob( WORKER *pWorker, DWORD *pdwJob )
+{
+  unsigned long long r = atomic_load( &pWorker->Range );
+
+  while( RANGE_NEXT(r) < RANGE_END(r) ) {                  // Anything left?
+    if( atomic_compare_exchange_weak(&pWorker->Range, &r, RANGE(RANGE_NEXT(r)+1, RANGE_END(r))) ) {
+      *pdwJob = RANGE_NEXT( r );                           //  Yes, and nobody stole it first
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+
+/*****************************************************************************
+ * FUNC: StealJobs                                                           *
+ * DESC: Move half of another worker's remaining jobs into an (empty) queue  *
+ * ARGS: nThief = Index of the worker whose queue is empty                   *
+ * RET:  TRUE = Stole some jobs, FALSE = Every queue is empty (all done)     *
+ * NOTE: Jobs are taken from the END of the victim's range, while the victim *
+ *       takes from the front. Both ends live in one 64-bit value, so a      *
+ *       single compare-and-swap settles any race between the two.           *
+ *****************************************************************************/
+static BOOL StealJobs( int nThief )
+{
+  int i;
+
+  for( i = 1; i < nWorkerCount; i++ ) {
+    WORKER             *pVictim = &Workers[(nThief + i) % nWorkerCount];
+    unsigned long long  r       = atomic_load( &pVictim->Range );
+
+    while( RANGE_NEXT(r) < RANGE_END(r) ) {
+      DWORD dwLeft  = RANGE_END(r) - RANGE_NEXT(r);
+      DWORD dwSteal = (dwLeft + 1) / 2;                    // (Take the odd one if there is only one left)
+      DWORD dwSplit = RANGE_END(r) - dwSteal;
+
+      if( atomic_compare_exchange_weak(&pVictim->Range, &r, RANGE(RANGE_NEXT(r), dwSplit)) ) {
+        atomic_store( &Workers[nThief].Range, RANGE(dwSplit, dwSplit + dwSteal) );
+        Workers[nThief].dwSteals++;
+        return TRUE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+
+/*****************************************************************************
+ * FUNC: RunJob                                                              *
+ * DESC: Replay one trace with one combination of settings                   *
+ * ARGS: dwJob = Job number (settings index * number of traces + trace index)*
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void RunJob( DWORD dwJob )
+{
+  const SWEEP_POINT *pPoint = &pPoints[dwJob / nTraceCount];
+  REPLAY_CONFIG      Config = BaseConfig;
+  REPLAY_RESULT      Result;
+
+  Config.dwMin          = pPoint->dwMin;
+  Config.dwMax          = pPoint->dwMax;
+  Config.dwIntervalSecs = pPoint->dwInterval;
+  Replay_Run( &Traces[dwJob % nTraceCount], &Config, &Result );
+
+  pJobs[dwJob].dwSwitches    = Result.dwSwitches;
+  pJobs[dwJob].dwSecsOutside = Result.dwSecsAbove + Result.dwSecsBelow;
+  pJobs[dwJob].dStress       = Result.dStress;
+}
+
+
+/*****************************************************************************
+ * FUNC: WorkerThread                                                        *
+ * DESC: Run jobs until there are none left anywhere                         *
+ * ARGS: pArg = Address of the worker's index                                *
+ * RET:  0                                                                   *
+ *****************************************************************************/
+static int WorkerThread( void *pArg )
+{
+  int   nWorker = *(int *)pArg;
+  DWORD dwJob;
+
+  do {
+    while( TakeJob(&Workers[nWorker], &dwJob) ) {
+      RunJob( dwJob );
+      Workers[nWorker].dwJobsDone++;
+    }
+  } while( StealJobs(nWorker) );                           // (No new jobs are ever created, so "nothing to steal" means done)
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ * FUNC: RunSweep                                                            *
+ * DESC: Run all the jobs on a given number of worker threads                *
+ * ARGS: nThreads = Number of worker threads                                 *
+ * RET:  Elapsed (wall clock) time, in seconds                               *
+ *****************************************************************************/
+static double RunSweep( int nThreads )
+{
+  thrd_t Threads[MAX_WORKERS];
+  int    nIndex[MAX_WORKERS];
+  double dStart;
+  int    i;
+
+  nWorkerCount = nThreads;
+  for( i = 0; i < nThreads; i++ ) {                        // Deal the jobs out evenly to begin with
+    DWORD dwFirst = (DWORD)((unsigned long long)dwJobCount *  i    / nThreads);
+    DWORD dwEnd   = (DWORD)((unsigned long long)dwJobCount * (i+1) / nThreads);
+
+    atomic_init( &Workers[i].Range, RANGE(dwFirst, dwEnd) );
+    Workers[i].dwJobsDone = Workers[i].dwSteals = 0;
+    nIndex[i] = i;
+  }
+
+  dStart = WallClock();
+  for( i = 1; i < nThreads; i++ ) {
+    if( thrd_create(&Threads[i], WorkerThread, &nIndex[i]) != thrd_success ) {
+      fprintf( stderr, "Unable to start worker thread %d\n", i );
+      exit( 3 );
+    }
+  }
+  WorkerThread( &nIndex[0] );                              // (This thread is worker 0)
+  for( i = 1; i < nThreads; i++ ) {
+    thrd_join( Threads[i], NULL );
+  }
+  return WallClock() - dStart;
+}
+
+
+/*****************************************************************************
+ * FUNC: FindPareto                                                          *
+ * DESC: Total up each combination's results and mark the Pareto front       *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void FindPareto( void )
+{
+  double dDays = 0;
+  DWORD  dwSecs = 0;
+  DWORD  p, q;
+  int    t;
+
+  for( t = 0; t < nTraceCount; t++ ) {
+    dwSecs += Traces[t].dwDurationSecs;
+  }
+  dDays = dwSecs / 86400.0;
+
+  for( p = 0; p < dwPointCount; p++ ) {                    // Total up the results for each combination
+    DWORD  dwSwitches = 0;
+    DWORD  dwOutside  = 0;
+    double dStress    = 0;
+
+    for( t = 0; t < nTraceCount; t++ ) {
+      const JOB_RESULT *pJob = &pJobs[p * nTraceCount + t];
+
+      dwSwitches += pJob->dwSwitches;
+      dwOutside  += pJob->dwSecsOutside;
+      dStress    += pJob->dStress;
+    }
+    pPoints[p].dSwitchesPerDay = dwSwitches / dDays;
+    pPoints[p].dStressPerDay   = dStress / dDays;
+    pPoints[p].dOutsidePct     = dwSecs ? 100.0 * dwOutside / dwSecs : 0;
+  }
+
+  for( p = 0; p < dwPointCount; p++ ) {                    // Mark the combinations nothing else beats on both counts
+    pPoints[p].bPareto = TRUE;
+    for( q = 0; pPoints[p].bPareto && (q < dwPointCount); q++ ) {
+      if(    (pPoints[q].dSwitchesPerDay <= pPoints[p].dSwitchesPerDay)
+          && (pPoints[q].dStressPerDay   <= pPoints[p].dStressPerDay)
+          && (   (pPoints[q].dSwitchesPerDay < pPoints[p].dSwitchesPerDay)
+              || (pPoints[q].dStressPerDay   < pPoints[p].dStressPerDay)) ) {
+        pPoints[p].bPareto = FALSE;                        // (q is at least as good on both, and better on one)
+      }
+    }
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: WallClock                                                           *
+ * DESC: Get the current (wall clock) time                                   *
+ * ARGS: [None]                                                              *
+ * RET:  Time, in seconds                                                    *
+ *****************************************************************************/
+static double WallClock( void )
+{
+  struct timespec ts;
+
+  timespec_get( &ts, TIME_UTC );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*****************************************************************************
+ * FUNC: Usage                                                               *
+ * DESC: Display the command-line options                                    *
+ * ARGS: [None]                                                              *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void Usage( void )
+{
+  fprintf( stderr,
+           "Usage: Sweep [options]\n"
+           "  -t file     Add a recorded trace to the library (may be repeated)\n"
+           "  -s count    Add this many synthetic traces (default: %d if no -t)\n"
+           "  -d days     Length of synthetic traces (default: %d)\n"
+           "  -S step     MIN/MAX step size (default: %d, 1 = every value)\n"
+           "  -I secs     Largest CheckChargeInterval to try (default: %d)\n"
+           "  -j threads  Number of worker threads (default: number of CPUs)\n"
+           "  -l ms       Outlet actuation latency (default: %d)\n"
+           "  -r secs     BatteryLifePercent refresh interval (default: %d)\n"
+           "  -v wh       Use the VBattery model, with this capacity (watt-hours)\n"
+           "  -b 1        Measure scaling efficiency with 1..threads workers\n",
+           DEFAULT_SYNTHETIC, DEFAULT_DAYS, DEFAULT_STEP, INTERVAL_MAX,
+           REPLAY_DEFAULT_LATENCY, REPLAY_DEFAULT_REFRESH );
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: main                                                                *
+ * DESC: Program entry point                                                 *
+ * ARGS: argc, argv = Command-line arguments                                 *
+ * RET:  0 = Success, 1 = Bad arguments, 2 = Couldn't load a trace           *
+ *****************************************************************************/
+int main( int argc, char *argv[] )
+{
+  SYSTEM_INFO SysInfo;
+  DWORD       dwSynthetic = 0;
+  DWORD       dwDays      = DEFAULT_DAYS;
+  DWORD       dwStep      = DEFAULT_STEP;
+  DWORD       dwMaxInterval = INTERVAL_MAX;
+  DWORD       dwMin, dwInterval;
+  int         nMax;                        // (Counts down from 100, so it must be able to go negative)
+  DWORD       p;
+  BOOL        bBenchmark  = FALSE;
+  int         nThreads;
+  int         i;
+
+  GetSystemInfo( &SysInfo );
+  nThreads = (int)SysInfo.dwNumberOfProcessors;
+  Replay_InitConfig( &BaseConfig );
+  VBattery_InitConfig( &BattConfig );
+
+  for( i = 1; i < argc; i++ ) {
+    const char *szOpt = argv[i];
+    const char *szArg = (i+1 < argc) ? argv[i+1] : NULL;
+
+    if( ((szOpt[0] != '-') && (szOpt[0] != '/')) || (szOpt[1] == '\0') || (szOpt[2] != '\0') || (szArg == NULL) ) {
+      Usage();
+      return 1;
+    }
+    i++;
+
+    switch( szOpt[1] ) {
+      case 's': dwSynthetic            = strtoul( szArg, NULL, 10 ); break;
+      case 'd': dwDays                 = strtoul( szArg, NULL, 10 ); break;
+      case 'S': dwStep                 = strtoul( szArg, NULL, 10 ); break;
+      case 'I': dwMaxInterval          = strtoul( szArg, NULL, 10 ); break;
+      case 'j': nThreads               = atoi( szArg );              break;
+      case 'l': BaseConfig.dwLatencyMs = strtoul( szArg, NULL, 10 ); break;
+      case 'r': BaseConfig.dwRefreshSecs = strtoul( szArg, NULL, 10 ); break;
+      case 'v': BattConfig.dCapacityWh = atof( szArg );
+                BaseConfig.pBattery    = (BattConfig.dCapacityWh > 0) ? &BattConfig : NULL;
+                break;
+      case 'b': bBenchmark             = (atoi(szArg) != 0);         break;
+
+      case 't':
+        if( nTraceCount == MAX_TRACES ) {
+          fprintf( stderr, "Too many traces (max. %d)\n", MAX_TRACES );
+          return 1;
+        }
+        if( !Trace_LoadCSV(szArg, &Traces[nTraceCount]) ) {
+          fprintf( stderr, "Unable to load trace \"%s\"\n", szArg );
+          return 2;
+        }
+        nTraceCount++;
+        break;
+
+      default:
+        Usage();
+        return 1;
+    }
+  }
+
+  if( (nTraceCount == 0) && (dwSynthetic == 0) ) {         // No traces given?
+    dwSynthetic = DEFAULT_SYNTHETIC;                       //  No, use the default synthetic library
+  }
+  for( p = 1; (p <= dwSynthetic) && (nTraceCount < MAX_TRACES); p++ ) {
+    if( !Trace_Synthetic(p, dwDays, &Traces[nTraceCount]) ) {
+      return 2;
+    }
+    nTraceCount++;
+  }
+  if( dwStep == 0 ) {
+    dwStep = 1;
+  }
+  if( (dwMaxInterval == 0) || (dwMaxInterval > INTERVAL_MAX) ) {
+    dwMaxInterval = INTERVAL_MAX;
+  }
+  if( nThreads < 1 ) {
+    nThreads = 1;
+  }
+  else if( nThreads > MAX_WORKERS ) {
+    nThreads = MAX_WORKERS;
+  }
+
+  for( dwMin = MINMIN; dwMin <= MINMAX; dwMin += dwStep ) {   // Count the combinations...
+    for( nMax = MAXMAX; (nMax >= MAXMIN) && (nMax >= (int)dwMin + MIN_GAP); nMax -= (int)dwStep ) {
+      dwPointCount += dwMaxInterval;
+    }
+  }
+  pPoints    = calloc( dwPointCount, sizeof(SWEEP_POINT) );
+  dwJobCount = dwPointCount * nTraceCount;
+  pJobs      = calloc( dwJobCount, sizeof(JOB_RESULT) );
+  if( (pPoints == NULL) || (pJobs == NULL) ) {
+    fprintf( stderr, "Out of memory\n" );
+    return 3;
+  }
+  p = 0;
+  for( dwMin = MINMIN; dwMin <= MINMAX; dwMin += dwStep ) {   // ... and list them
+    for( nMax = MAXMAX; (nMax >= MAXMIN) && (nMax >= (int)dwMin + MIN_GAP); nMax -= (int)dwStep ) {
+      for( dwInterval = 1; dwInterval <= dwMaxInterval; dwInterval++ ) {
+        pPoints[p].dwMin      = dwMin;
+        pPoints[p].dwMax      = (DWORD)nMax;
+        pPoints[p].dwInterval = dwInterval;
+        p++;
+      }
+    }
+  }
+
+  printf( "Policy: %s\n", Policy_Name() );
+  printf( "%lu combinations x %d traces = %lu replays\n\n",
+          (unsigned long)dwPointCount, nTraceCount, (unsigned long)dwJobCount );
+
+  if( bBenchmark ) {                                       // Measure how well the sweep scales?
+    double dOneThread = 0;
+    int    n;
+
+    printf( "Threads   Seconds   Speedup   Efficiency   Steals\n" );
+    for( n = 1; n <= nThreads; n++ ) {
+      double dSecs   = RunSweep( n );
+      DWORD  dwSteals = 0;
+
+      for( i = 0; i < n; i++ ) {
+        dwSteals += Workers[i].dwSteals;
+      }
+      if( n == 1 ) {
+        dOneThread = dSecs;
+      }
+      printf( "%7d   %7.2f   %7.2f   %9.0f%%   %6lu\n",
+              n, dSecs, dOneThread / dSecs, 100.0 * dOneThread / (dSecs * n), (unsigned long)dwSteals );
+    }
+    printf( "\n" );
+  }
+  else {
+    printf( "Sweep took %.2f seconds on %d thread%s\n\n", RunSweep(nThreads), nThreads, (nThreads == 1) ? "" : "s" );
+  }
+
+  FindPareto();
+  printf( "Pareto-optimal settings (fewest switches -> least battery stress):\n" );
+  printf( "  Min   Max   Interval   Switches/day   Stress/day   Outside band\n" );
+  for( ;; ) {                                              // List the front in order of switches per day
+    SWEEP_POINT *pBest = NULL;
+
+    for( p = 0; p < dwPointCount; p++ ) {
+      if( pPoints[p].bPareto && ((pBest == NULL) || (pPoints[p].dSwitchesPerDay < pBest->dSwitchesPerDay)) ) {
+        pBest = &pPoints[p];
+      }
+    }
+    if( pBest == NULL ) {
+      break;
+    }
+    printf( "  %3lu   %3lu   %8lu   %12.2f   %10.3f   %11.2f%%\n",
+            (unsigned long)pBest->dwMin, (unsigned long)pBest->dwMax, (unsigned long)pBest->dwInterval,
+            pBest->dSwitchesPerDay, pBest->dStressPerDay, pBest->dOutsidePct );
+    pBest->bPareto = FALSE;
+  }
+
+  for( i = 0; i < nTraceCount; i++ ) {
+    Trace_Free( &Traces[i] );
+  }
+  free( pJobs );
+  free( pPoints );
+  return 0;
+}
@@ -0,0 +1,301 @@
+/*****************************************************************************
+ * FILE: Trace.c                                                             *
+ * DESC: Battery trace loading / generation                                  *
+ * AUTH: Kerry Burton                                                        *
+ * INFO: A trace file is plain text, one battery check per line:             *
+ *         seconds,percent,acline                                            *
+ *       where "seconds" counts from any starting point, "percent" is        *
+ *       BatteryLifePercent and "acline" is ACLineStatus (0 or 1). Blank     *
+ *       lines and lines starting with '#' are ignored.                      *
+ *                                                                           *
+ *       The recorded percentages only tell us how fast the battery charged  *
+ *       or drained with the outlet in the state it happened to be in, so    *
+ *       the trace is turned into a list of charge/drain RATES that can be   *
+ *       replayed no matter what the policy decides to do with the outlet.   *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+  /* Includes */
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Source/Predict.h"
+#include "../Source/Policy.h"
+#include "../Source/VBattery.h"
+#include "../Source/Governor.h"
+#include "ReplayEngine.h"
+#include "Trace.h"
+
+  /* Defines */
+#define GROW_BY          256                   // Number of array entries to add when an array fills up
+#define RATE_UNKNOWN     -1.0f                 // Rate hasn't been seen (yet)
+
+  /* Typedefs */
+  typedef struct {                             // One line from a trace file
+    DWORD dwSecs;
+    BYTE  byPct;
+    BYTE  byLine;
+  } TRACE_ROW;
+
+  /* Static variables */
+
+  /* Function prototypes */
+static BOOL AddSegment(   TRACE *pTrace, DWORD *pdwAlloc, DWORD dwSecs, float fCharge, float fDrain );
+static void FillUnknown(  TRACE *pTrace );
+static DWORD NextRandom(  DWORD *pdwSeed );
+
+/* === LOCAL FUNCTIONS ===================================================== */
+
+/*****************************************************************************
+ * FUNC: AddSegment                                                          *
+ * DESC: Append a segment to a trace, growing the segment array as needed    *
+ * ARGS: pTrace   = Address of the trace                                     *
+ *       pdwAlloc = Address of the number of segments currently allocated    *
+ *       dwSecs   = Start of the segment                                     *
+ *       fCharge  = Charge rate (percent per hour)                           *
+ *       fDrain   = Drain rate (percent per hour)                            *
+ * RET:  TRUE = Success, FALSE = Out of memory                               *
+ *****************************************************************************/
+static BOOL AddSegment( TRACE *pTrace, DWORD *pdwAlloc, DWORD dwSecs, float fCharge, float fDrain )
+{
+  TRACE_SEGMENT *pSeg;
+
+  if( pTrace->dwSegCount == *pdwAlloc ) {
+    pSeg = realloc( pTrace->pSegs, (*pdwAlloc + GROW_BY) * sizeof(TRACE_SEGMENT) );
+    if( pSeg == NULL ) {
+      return FALSE;
+    }
+    pTrace->pSegs = pSeg;
+    *pdwAlloc    += GROW_BY;
+  }
+
+  pSeg = &pTrace->pSegs[pTrace->dwSegCount++];
+  pSeg->dwSecs         = dwSecs;
+  pSeg->fChargePerHour = fCharge;
+  pSeg->fDrainPerHour  = fDrain;
+  return TRUE;
+}
+
+
+/*****************************************************************************
+ * FUNC: FillUnknown                                                         *
+ * DESC: Replace rates that weren't known yet with the first one seen later  *
+ *       on (or the default, if the trace never showed one)                  *
+ * ARGS: pTrace = Address of the trace                                       *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+static void FillUnknown( TRACE *pTrace )
+{
+  float fFirstCharge = TRACE_DEFAULT_CHARGE;
+  float fFirstDrain  = TRACE_DEFAULT_DRAIN;
+  DWORD dwSeg;
+
+  for( dwSeg = pTrace->dwSegCount; dwSeg-- > 0; ) {      // Find the first known rates (working backward)
+    if( pTrace->pSegs[dwSeg].fChargePerHour != RATE_UNKNOWN ) {
+      fFirstCharge = pTrace->pSegs[dwSeg].fChargePerHour;
+    }
+    if( pTrace->pSegs[dwSeg].fDrainPerHour != RATE_UNKNOWN ) {
+      fFirstDrain = pTrace->pSegs[dwSeg].fDrainPerHour;
+    }
+  }
+
+  for( dwSeg = 0; dwSeg < pTrace->dwSegCount; dwSeg++ ) {  // Backfill
+    if( pTrace->pSegs[dwSeg].fChargePerHour == RATE_UNKNOWN ) {
+      pTrace->pSegs[dwSeg].fChargePerHour = fFirstCharge;
+    }
+    if( pTrace->pSegs[dwSeg].fDrainPerHour == RATE_UNKNOWN ) {
+      pTrace->pSegs[dwSeg].fDrainPerHour = fFirstDrain;
+    }
+  }
+}
+
+
+/*****************************************************************************
+ * FUNC: NextRandom                                                          *
+ * DESC: Simple linear congruential generator, so that synthetic traces are  *
+ *       identical on every compiler / C library                             *
+ * ARGS: pdwSeed = Address of the generator's state                          *
+ * RET:  Pseudo-random number (0-32767)                                      *
+ *****************************************************************************/
+static DWORD NextRandom( DWORD *pdwSeed )
+{
+  *pdwSeed = (*pdwSeed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+  return (*pdwSeed >> 16) & 0x7FFF;
+}
+
+
+/* === GLOBAL FUNCTIONS ==================================================== */
+
+/*****************************************************************************
+ * FUNC: Trace_LoadCSV                                                       *
+ * DESC: Load a recorded battery trace                                       *
+ * ARGS: szFileName = Name of the trace file                                 *
+ *       pTrace     = Address of TRACE structure to be populated             *
+ * RET:  TRUE = Success, FALSE = Couldn't read the file / no usable lines    *
+ * NOTE: The rate is measured between the points where the percentage        *
+ *       changes, since BatteryLifePercent only moves in whole steps. Each   *
+ *       rate is carried forward until the trace shows a new one.            *
+ *****************************************************************************/
+BOOL Trace_LoadCSV( const char *szFileName, TRACE *pTrace )
+{
+  FILE      *fp;
+  char      szLine[128];
+  TRACE_ROW *pRows   = NULL;
+  DWORD     dwRows   = 0;
+  DWORD     dwAlloc  = 0;
+  DWORD     dwSegAlloc = 0;
+  DWORD     dwRow;
+  DWORD     dwAnchor = 0;                                  // Row where the current percentage/line state started
+  float     fCharge  = RATE_UNKNOWN;
+  float     fDrain   = RATE_UNKNOWN;
+  BOOL      bOK      = TRUE;
+
+  memset( pTrace, 0, sizeof(*pTrace) );
+  strncpy( pTrace->szName, szFileName, sizeof(pTrace->szName) - 1 );
+
+  fp = fopen( szFileName, "r" );
+  if( fp == NULL ) {
+    return FALSE;
+  }
+
+  while( bOK && fgets(szLine, sizeof(szLine), fp) ) {      // Read in all the battery checks
+    unsigned long ulSecs, ulPct, ulLine;
+
+    if( (szLine[0] == '#') || (sscanf(szLine, "%lu,%lu,%lu", &ulSecs, &ulPct, &ulLine) != 3) ) {
+      continue;                                            // (Comment, blank line or heading)
+    }
+    if( dwRows == dwAlloc ) {
+      TRACE_ROW *pNew = realloc( pRows, (dwAlloc + GROW_BY) * sizeof(TRACE_ROW) );
+
+      if( pNew == NULL ) {
+        bOK = FALSE;
+        break;
+      }
+      pRows    = pNew;
+      dwAlloc += GROW_BY;
+    }
+    pRows[dwRows].dwSecs = (DWORD)ulSecs;
+    pRows[dwRows].byPct  = (BYTE)(ulPct > 100 ? 100 : ulPct);
+    pRows[dwRows].byLine = (BYTE)(ulLine ? 1 : 0);
+    dwRows++;
+  }
+  fclose( fp );
+
+  if( !bOK || (dwRows < 2) ) {
+    free( pRows );
+    return FALSE;
+  }
+
+  for( dwRow = 1; bOK && (dwRow < dwRows); dwRow++ ) {
+    const TRACE_ROW *pAnchor = &pRows[dwAnchor];
+    const TRACE_ROW *pRow    = &pRows[dwRow];
+
+    if( pRow->dwSecs < pAnchor->dwSecs ) {                 // Time went backward?
+      bOK = FALSE;                                         //  Yes, can't make sense of this file
+    }
+    else if( pRow->byLine != pAnchor->byLine ) {           // AC line changed?
+      dwAnchor = dwRow;                                    //  Yes, start measuring again from here
+    }
+    else if( (pRow->byPct != pAnchor->byPct) && (pRow->dwSecs > pAnchor->dwSecs) ) {
+      float fRate = (float)abs( (int)pRow->byPct - (int)pAnchor->byPct ) * 3600.0f
+                  / (float)(pRow->dwSecs - pAnchor->dwSecs);
+
+      if( pRow->byLine ) {                                 // Percentage changed, record the new rate
+        fCharge = fRate;
+      }
+      else {
+        fDrain  = fRate;
+      }
+      bOK      = AddSegment( pTrace, &dwSegAlloc, pAnchor->dwSecs - pRows[0].dwSecs, fCharge, fDrain );
+      dwAnchor = dwRow;
+    }
+  }
+
+  if( bOK && (pTrace->dwSegCount == 0) ) {                 // Percentage never changed?
+    bOK = AddSegment( pTrace, &dwSegAlloc, 0, RATE_UNKNOWN, RATE_UNKNOWN );
+  }
+
+  if( bOK ) {
+    pTrace->pSegs[0].dwSecs = 0;                           // (First segment must cover the start of the trace)
+    FillUnknown( pTrace );
+    pTrace->dwDurationSecs = pRows[dwRows-1].dwSecs - pRows[0].dwSecs;
+    pTrace->byStartPct     = pRows[0].byPct;
+    pTrace->byStartLine    = pRows[0].byLine;
+  }
+  else {
+    Trace_Free( pTrace );
+  }
+
+  free( pRows );
+  return bOK;
+}
+
+
+/*****************************************************************************
+ * FUNC: Trace_Synthetic                                                     *
+ * DESC: Generate a battery trace with a varying load                        *
+ * ARGS: dwSeed  = Seed for the random number generator                      *
+ *       dwDays  = Length of the trace                                       *
+ *       pTrace  = Address of TRACE structure to be populated                *
+ * RET:  TRUE = Success, FALSE = Out of memory                               *
+ * NOTE: The same seed always produces the same trace. Nights are mostly     *
+ *       idle, days alternate between light and heavy use.                   *
+ *****************************************************************************/
+BOOL Trace_Synthetic( DWORD dwSeed, DWORD dwDays, TRACE *pTrace )
+{
+  DWORD dwAlloc = 0;
+  DWORD dwSecs  = 0;
+  DWORD dwState = dwSeed ? dwSeed : 1;
+
+  memset( pTrace, 0, sizeof(*pTrace) );
+  sprintf( pTrace->szName, "synthetic (seed %lu, %lu day%s)",
+           (unsigned long)dwSeed, (unsigned long)dwDays, (dwDays == 1) ? "" : "s" );
+  pTrace->dwDurationSecs = (dwDays ? dwDays : 1) * 24UL * 60 * 60;
+  pTrace->byStartPct     = 80;
+  pTrace->byStartLine    = 1;
+
+  while( dwSecs < pTrace->dwDurationSecs ) {
+    DWORD dwHour = (dwSecs / 3600) % 24;
+    DWORD dwLoad = NextRandom( &dwState ) % 100;
+    float fDrain;
+    float fCharge;
+
+    if( (dwHour < 7) || (dwHour >= 23) ) {                 // Night: mostly idle
+      fDrain = (dwLoad < 80) ? 3.0f : 8.0f;
+    }
+    else if( dwLoad < 50 ) {                               // Day: light use
+      fDrain = 8.0f + (float)(NextRandom(&dwState) % 8);
+    }
+    else if( dwLoad < 85 ) {                               //      moderate use
+      fDrain = 15.0f + (float)(NextRandom(&dwState) % 10);
+    }
+    else {                                                 //      heavy use (e.g. compiling, gaming)
+      fDrain = 25.0f + (float)(NextRandom(&dwState) % 20);
+    }
+    fCharge = 55.0f - fDrain / 2;                          // The load slows charging down as well
+
+    if( !AddSegment(pTrace, &dwAlloc, dwSecs, fCharge, fDrain) ) {
+      Trace_Free( pTrace );
+      return FALSE;
+    }
+    dwSecs += (10 + NextRandom(&dwState) % 80) * 60;       // Keep this load for 10-90 minutes
+  }
+
+  return TRUE;
+}
+
+
+/*****************************************************************************
+ * FUNC: Trace_Free                                                          *
+ * DESC: Release the memory used by a trace                                  *
+ * ARGS: pTrace = Address of the trace                                       *
+ * RET:  [None]                                                              *
+ *****************************************************************************/
+void Trace_Free( TRACE *pTrace )
+{
+  free( pTrace->pSegs );
+  pTrace->pSegs      = NULL;
+  pTrace->dwSegCount = 0;
+}
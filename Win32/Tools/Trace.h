@@ -0,0 +1,22 @@
+/*****************************************************************************
+ * FILE: Trace.h                                                             *
+ * DESC: Definitions for loading / generating battery traces                 *
+ * AUTH: Kerry Burton                                                        *
+ * INFO:                                                                     *
+ *****************************************************************************
+ * COPYRIGHT 2020 Kerry Burton. ALL RIGHTS RESERVED.                         *
+ *****************************************************************************/
+
+#ifndef TRACE_H
+# define TRACE_H                                 // Prevent items below from being processed more than once
+
+    /* Defines */
+# define TRACE_DEFAULT_CHARGE  40.0f             // Charge rate to assume until a trace shows one (percent per hour)
+# define TRACE_DEFAULT_DRAIN   12.0f             // Drain rate to assume until a trace shows one (percent per hour)
+
+    /* Global function prototypes */
+  BOOL Trace_LoadCSV(    const char *szFileName, TRACE *pTrace );
+  BOOL Trace_Synthetic(  DWORD dwSeed, DWORD dwDays, TRACE *pTrace );
+  void Trace_Free(       TRACE *pTrace );
+
+#endif